@@ -0,0 +1,157 @@
+#include "taco/base/binary_format.h"
+
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <utility>
+
+#include "taco/base/exception.h"
+
+namespace taco {
+namespace binary_format {
+
+namespace {
+
+const boost::uint32_t kMaxCount = 0xfffffffe;
+
+// The average number of keys per bucket and the number of slots per key.
+// More slots make the search for each bucket's seed faster at the cost of a
+// larger table.
+const std::size_t kKeysPerBucket = 4;
+const double kSlotsPerKey = 1.25;
+
+}  // namespace
+
+const boost::uint32_t PerfectHash::kEmptySlot;
+
+void CheckSection(boost::uint64_t offset, boost::uint64_t length,
+                  std::size_t size, const char *name) {
+  if (offset % 4 != 0 || offset > size || length > size - offset) {
+    std::ostringstream msg;
+    msg << "invalid " << name << " section";
+    throw Exception(msg.str());
+  }
+}
+
+void CheckCount(std::size_t n, const char *name) {
+  if (n > kMaxCount) {
+    std::ostringstream msg;
+    msg << "too many " << name << " for 32-bit offsets";
+    throw Exception(msg.str());
+  }
+}
+
+void AppendStringPool(const Vocabulary &vocab, std::string &buffer) {
+  std::vector<boost::uint32_t> offsets;
+  offsets.reserve(vocab.Size() + 2);
+  offsets.push_back(vocab.Size());
+  std::string chars;
+  for (Vocabulary::const_iterator p = vocab.begin(); p != vocab.end(); ++p) {
+    offsets.push_back(chars.size());
+    chars += **p;
+    CheckCount(chars.size(), "characters");
+  }
+  offsets.push_back(chars.size());
+  Append(offsets, buffer);
+  buffer += chars;
+}
+
+void StringPool::Init(const char *data, std::size_t size,
+                      std::size_t offset) {
+  CheckSection(offset, sizeof(boost::uint32_t), size, "string pool");
+  const boost::uint32_t *p =
+      reinterpret_cast<const boost::uint32_t *>(data + offset);
+  size_ = p[0];
+  CheckSection(offset, (size_ + 2) * sizeof(boost::uint32_t), size,
+               "string pool");
+  offsets_ = p + 1;
+  chars_ = reinterpret_cast<const char *>(offsets_ + size_ + 1);
+  CheckSection(chars_ - data, offsets_[size_], size, "string pool");
+}
+
+void StringPool::ReadVocabulary(Vocabulary &vocab) const {
+  for (std::size_t i = 0; i < size_; ++i) {
+    std::string s = Get(i).as_string();
+    if (vocab.Insert(s) != i) {
+      std::ostringstream msg;
+      msg << "vocabulary ID of `" << s << "' does not match binary file";
+      throw Exception(msg.str());
+    }
+  }
+}
+
+// FNV-1a, seeded, followed by a finalizer to mix the high bits into the low
+// bits that the modulus keeps.
+boost::uint64_t PerfectHash::Hash(const StringPiece &s, boost::uint32_t seed) {
+  boost::uint64_t hash = 14695981039346656037ULL ^
+                         (seed * 0x9e3779b97f4a7c15ULL);
+  for (std::size_t i = 0; i < s.size(); ++i) {
+    hash ^= static_cast<unsigned char>(s[i]);
+    hash *= 1099511628211ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+void PerfectHash::Build(const std::vector<StringPiece> &keys,
+                        std::vector<boost::uint32_t> &buckets,
+                        std::vector<boost::uint32_t> &slots) {
+  CheckCount(keys.size(), "keys");
+  const std::size_t num_keys = keys.size();
+  const std::size_t num_buckets = num_keys / kKeysPerBucket + 1;
+  const std::size_t num_slots =
+      static_cast<std::size_t>(num_keys * kSlotsPerKey) + 1;
+
+  std::vector<std::vector<boost::uint32_t> > members(num_buckets);
+  for (std::size_t i = 0; i < num_keys; ++i) {
+    members[Hash(keys[i], 0) % num_buckets].push_back(i);
+  }
+  std::vector<std::pair<std::size_t, std::size_t> > order;
+  order.reserve(num_buckets);
+  for (std::size_t i = 0; i < num_buckets; ++i) {
+    order.push_back(std::make_pair(members[i].size(), i));
+  }
+  std::sort(order.begin(), order.end(),
+            std::greater<std::pair<std::size_t, std::size_t> >());
+
+  buckets.assign(num_buckets, 0);
+  slots.assign(num_slots, kEmptySlot);
+  std::vector<std::size_t> candidates;
+  for (std::size_t i = 0; i < order.size() && order[i].first > 0; ++i) {
+    const std::vector<boost::uint32_t> &bucket = members[order[i].second];
+    for (boost::uint32_t seed = 1; ; ++seed) {
+      if (seed == 0) {
+        throw Exception("failed to build perfect hash index");
+      }
+      candidates.clear();
+      bool ok = true;
+      for (std::size_t j = 0; ok && j < bucket.size(); ++j) {
+        std::size_t slot = Hash(keys[bucket[j]], seed) % num_slots;
+        ok = slots[slot] == kEmptySlot &&
+             std::find(candidates.begin(), candidates.end(), slot) ==
+                 candidates.end();
+        candidates.push_back(slot);
+      }
+      if (ok) {
+        for (std::size_t j = 0; j < bucket.size(); ++j) {
+          slots[candidates[j]] = bucket[j];
+        }
+        buckets[order[i].second] = seed;
+        break;
+      }
+    }
+  }
+}
+
+boost::uint32_t PerfectHash::Find(const StringPiece &key) const {
+  boost::uint32_t seed = buckets_[Hash(key, 0) % num_buckets_];
+  if (seed == 0) {
+    return kEmptySlot;
+  }
+  return slots_[Hash(key, seed) % num_slots_];
+}
+
+}  // namespace binary_format
+}  // namespace taco
@@ -0,0 +1,121 @@
+#ifndef TACO_SRC_TACO_BASE_BINARY_FORMAT_H_
+#define TACO_SRC_TACO_BASE_BINARY_FORMAT_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+#include "taco/base/string_piece.h"
+#include "taco/base/vocabulary.h"
+
+namespace taco {
+namespace binary_format {
+
+// Building blocks for read-only binary files that are used in place (for
+// example, after memory-mapping) rather than parsed.  A file is a header
+// followed by sections, each starting at a multiple of 8 bytes from the
+// start of the file.  Integers are stored in the byte order of the writer.
+
+// Returns the offset rounded up to the next section boundary.
+inline std::size_t Align(std::size_t offset) {
+  return (offset + 7) & ~static_cast<std::size_t>(7);
+}
+
+// Pads the buffer to the next section boundary.
+inline void AlignBuffer(std::string &buffer) {
+  buffer.resize(Align(buffer.size()));
+}
+
+// Appends a vector's elements to a buffer.
+template<typename T>
+void Append(const std::vector<T> &v, std::string &buffer) {
+  if (!v.empty()) {
+    buffer.append(reinterpret_cast<const char *>(&v[0]), v.size() * sizeof(T));
+  }
+}
+
+// Throws Exception unless the section [offset, offset+length) lies within a
+// file of the given size and is aligned for 32-bit access.  The name is used
+// in the message.
+void CheckSection(boost::uint64_t offset, boost::uint64_t length,
+                  std::size_t size, const char *name);
+
+// Throws Exception if a count is too large to be stored in 32 bits.  The
+// name is used in the message.
+void CheckCount(std::size_t, const char *name);
+
+// Appends a string pool section containing the vocabulary's strings in ID
+// order: a count n, n+1 offsets into the characters, then the characters.
+void AppendStringPool(const Vocabulary &, std::string &buffer);
+
+// A read-only view of a string pool section.
+class StringPool {
+ public:
+  StringPool() : size_(0), offsets_(0), chars_(0) {}
+
+  // Sets the view to the section at the given offset of the file data.
+  // Throws Exception if the section does not fit in the file.
+  void Init(const char *data, std::size_t size, std::size_t offset);
+
+  std::size_t Size() const { return size_; }
+
+  StringPiece Get(std::size_t i) const {
+    return StringPiece(chars_ + offsets_[i], offsets_[i+1] - offsets_[i]);
+  }
+
+  // Inserts the strings into the vocabulary in order.  Throws Exception if
+  // the vocabulary assigns a string an ID other than its index in the pool.
+  void ReadVocabulary(Vocabulary &) const;
+
+ private:
+  std::size_t size_;
+  const boost::uint32_t *offsets_;
+  const char *chars_;
+};
+
+// A perfect hash index over byte string keys, built by the "hash and
+// displace" method: the keys are hashed into buckets of about four keys
+// and, largest bucket first, each bucket is given the first seed that
+// hashes its keys into empty slots of a table with 1.25 slots per key.  A
+// lookup costs two hashes.  Since the table records which key occupies each
+// slot, a key that was not indexed maps to some other key (or to no key)
+// and the caller must compare the keys.
+class PerfectHash {
+ public:
+  static const boost::uint32_t kEmptySlot = 0xffffffff;
+
+  // Builds the index.  On return, buckets holds each bucket's seed (0 if it
+  // is empty) and slots holds the index of the key that occupies each slot
+  // (or kEmptySlot).
+  static void Build(const std::vector<StringPiece> &keys,
+                    std::vector<boost::uint32_t> &buckets,
+                    std::vector<boost::uint32_t> &slots);
+
+  PerfectHash() : buckets_(0), num_buckets_(0), slots_(0), num_slots_(0) {}
+
+  PerfectHash(const boost::uint32_t *buckets, std::size_t num_buckets,
+              const boost::uint32_t *slots, std::size_t num_slots)
+      : buckets_(buckets)
+      , num_buckets_(num_buckets)
+      , slots_(slots)
+      , num_slots_(num_slots) {}
+
+  // Returns the index of the only key that the given key could be, or
+  // kEmptySlot.
+  boost::uint32_t Find(const StringPiece &) const;
+
+ private:
+  static boost::uint64_t Hash(const StringPiece &, boost::uint32_t);
+
+  const boost::uint32_t *buckets_;
+  std::size_t num_buckets_;
+  const boost::uint32_t *slots_;
+  std::size_t num_slots_;
+};
+
+}  // namespace binary_format
+}  // namespace taco
+
+#endif
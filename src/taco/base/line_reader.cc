@@ -0,0 +1,72 @@
+#include "taco/base/line_reader.h"
+
+#include <cstring>
+#include <streambuf>
+
+namespace taco {
+
+const std::size_t LineReader::kDefaultBlockSize;
+
+LineReader::LineReader(std::istream &input, std::size_t block_size)
+    : input_(input)
+    , buffer_(block_size > 0 ? block_size : 1)
+    , begin_(0)
+    , end_(0)
+    , scan_(0)
+    , eof_(false) {
+}
+
+bool LineReader::Next(StringPiece &line) {
+  while (true) {
+    if (scan_ < end_) {
+      const char *data = &buffer_[0];
+      const void *newline = std::memchr(data + scan_, '\n', end_ - scan_);
+      if (newline) {
+        std::size_t pos = static_cast<const char *>(newline) - data;
+        line.set(data + begin_, pos - begin_);
+        begin_ = scan_ = pos + 1;
+        return true;
+      }
+      scan_ = end_;
+    }
+    if (!Fill()) {
+      break;
+    }
+  }
+  if (begin_ == end_) {
+    return false;
+  }
+  line.set(&buffer_[0] + begin_, end_ - begin_);
+  begin_ = scan_ = end_;
+  return true;
+}
+
+bool LineReader::Fill() {
+  if (eof_) {
+    return false;
+  }
+  const std::size_t unread = end_ - begin_;
+  if (begin_ > 0) {
+    std::memmove(&buffer_[0], &buffer_[0] + begin_, unread);
+    scan_ -= begin_;
+    begin_ = 0;
+    end_ = unread;
+  }
+  if (end_ == buffer_.size()) {
+    buffer_.resize(buffer_.size() * 2);
+  }
+  // Read through the stream buffer, which bypasses the sentry and
+  // formatting machinery of std::istream.
+  std::streambuf *buf = input_.rdbuf();
+  std::streamsize n = buf ? buf->sgetn(&buffer_[0] + end_,
+                                       buffer_.size() - end_) : 0;
+  if (n <= 0) {
+    eof_ = true;
+    input_.setstate(std::ios_base::eofbit);
+    return false;
+  }
+  end_ += n;
+  return true;
+}
+
+}  // namespace taco
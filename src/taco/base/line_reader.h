@@ -0,0 +1,53 @@
+#ifndef TACO_SRC_TACO_BASE_LINE_READER_H_
+#define TACO_SRC_TACO_BASE_LINE_READER_H_
+
+#include <cstddef>
+#include <istream>
+#include <vector>
+
+#include "taco/base/string_piece.h"
+
+namespace taco {
+
+// Reads lines from a stream in large blocks and hands them out as
+// StringPieces that point into the block buffer, so reading a line involves
+// no per-line stream calls and no copying.  Lines are split on '\n', which is
+// not included in the line; as with std::getline, a final line without a
+// newline is returned and a '\r' is left in place.
+//
+// The reader takes all of its input from the stream's buffer, which it
+// reads ahead of the current line, so the stream should not be used by
+// anything else while the reader is.
+class LineReader {
+ public:
+  static const std::size_t kDefaultBlockSize = 1 << 20;
+
+  // The buffer starts at block_size bytes and grows to fit the longest line.
+  explicit LineReader(std::istream &,
+                      std::size_t block_size = kDefaultBlockSize);
+
+  // Sets line to the next line and returns true, or returns false if there
+  // are no more lines.  The line remains valid until the next call.
+  bool Next(StringPiece &line);
+
+ private:
+  // Copying is not allowed
+  LineReader(const LineReader &);
+  LineReader &operator=(const LineReader &);
+
+  // Moves the unread data to the start of the buffer, growing the buffer if
+  // the data fills it, and reads from the stream into the rest.  Returns
+  // false if no more data could be read.
+  bool Fill();
+
+  std::istream &input_;
+  std::vector<char> buffer_;
+  std::size_t begin_;  // Start of the unread data.
+  std::size_t end_;    // End of the unread data.
+  std::size_t scan_;   // Start of the unread data not yet searched for '\n'.
+  bool eof_;
+};
+
+}  // namespace taco
+
+#endif
@@ -1,12 +1,94 @@
 #include "taco/base/string_util.h"
 
 #include <cassert>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace taco {
 
+namespace {
+
+#if defined(__SSE2__)
+
+// Returns the index of the lowest set bit of a non-zero mask.
+inline int LowestBit(unsigned int mask) {
+#if defined(__GNUC__)
+  return __builtin_ctz(mask);
+#else
+  int i = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    ++i;
+  }
+  return i;
+#endif
+}
+
+// Returns a mask with bit i set if p[i] is a space or tab, for i < 16.
+inline unsigned int WhitespaceMask(const char *p) {
+  __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  __m128i spaces = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+  __m128i tabs = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t'));
+  return _mm_movemask_epi8(_mm_or_si128(spaces, tabs));
+}
+
+#endif
+
+// Tokenize() for the default delimiters.  Tokens are found by scanning for
+// the boundaries between runs of whitespace and runs of non-whitespace.
+void TokenizeWhitespace(std::vector<StringPiece> &output,
+                        const StringPiece &str) {
+  const char *data = str.data();
+  const std::size_t size = str.size();
+  std::size_t i = 0;
+  bool in_token = false;
+  std::size_t start = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= size; i += 16) {
+    const unsigned int whitespace = WhitespaceMask(data + i);
+    // The positions at which the current run could end.
+    unsigned int pending = in_token ? whitespace : (~whitespace & 0xffff);
+    while (pending) {
+      const int k = LowestBit(pending);
+      if (in_token) {
+        output.push_back(StringPiece(data + start, i + k - start));
+        pending = ~whitespace & (0xffffu << k) & 0xffff;
+      } else {
+        start = i + k;
+        pending = whitespace & (0xffffu << k);
+      }
+      in_token = !in_token;
+    }
+  }
+#endif
+  for (; i < size; ++i) {
+    const bool is_whitespace = (data[i] == ' ' || data[i] == '\t');
+    if (in_token && is_whitespace) {
+      output.push_back(StringPiece(data + start, i - start));
+      in_token = false;
+    } else if (!in_token && !is_whitespace) {
+      start = i;
+      in_token = true;
+    }
+  }
+  if (in_token) {
+    output.push_back(StringPiece(data + start, size - start));
+  }
+}
+
+}  // namespace
+
 void Tokenize(std::vector<StringPiece> &output, StringPiece str,
               const std::string &delimiters)
 {
+  if (delimiters == " \t") {
+    TokenizeWhitespace(output, str);
+    return;
+  }
+
   // Skip delimiters at beginning.
   std::string::size_type lastPos = str.find_first_not_of(delimiters, 0);
   // Find first "non-delimiter".
@@ -25,6 +107,11 @@ void Tokenize(std::vector<StringPiece> &output, StringPiece str,
 void TokenizeMultiCharSeparator(std::vector<StringPiece> &output,
                                 StringPiece str,
                                 const std::string &separator) {
+  if (separator == "|||") {
+    SplitFields(output, str);
+    return;
+  }
+
   std::size_t pos = 0;
   // Find first "non-delimiter".
   std::string::size_type nextPos = str.find(separator, pos);
@@ -42,8 +129,74 @@ void TokenizeMultiCharSeparator(std::vector<StringPiece> &output,
   Trim(output.back());
 }
 
+std::size_t FindFieldSeparator(const StringPiece &str, std::size_t pos) {
+  const char *data = str.data();
+  const std::size_t size = str.size();
+  if (pos >= size) {
+    return std::string::npos;
+  }
+#if defined(__SSE2__)
+  // A separator starts at i if bytes i, i+1 and i+2 are all '|', so compare
+  // the block and the block shifted by one and two bytes.
+  const __m128i bars = _mm_set1_epi8('|');
+  for (; pos + 18 <= size; pos += 16) {
+    const char *p = data + pos;
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 2));
+    __m128i match = _mm_and_si128(_mm_cmpeq_epi8(a, bars),
+                                  _mm_and_si128(_mm_cmpeq_epi8(b, bars),
+                                                _mm_cmpeq_epi8(c, bars)));
+    unsigned int mask = _mm_movemask_epi8(match);
+    if (mask) {
+      return pos + LowestBit(mask);
+    }
+  }
+#endif
+  while (pos + 3 <= size) {
+    const void *bar = std::memchr(data + pos, '|', size - pos - 2);
+    if (!bar) {
+      break;
+    }
+    pos = static_cast<const char *>(bar) - data;
+    if (data[pos+1] == '|' && data[pos+2] == '|') {
+      return pos;
+    }
+    ++pos;
+  }
+  return std::string::npos;
+}
+
+void SplitFields(std::vector<StringPiece> &output, const StringPiece &str) {
+  std::size_t begin = 0;
+  while (true) {
+    std::size_t pos = FindFieldSeparator(str, begin);
+    if (pos == std::string::npos) {
+      break;
+    }
+    output.push_back(str.substr(begin, pos - begin));
+    Trim(output.back());
+    begin = pos + 3;
+  }
+  output.push_back(str.substr(begin));
+  Trim(output.back());
+}
+
 void Trim(StringPiece &str, const std::string &chars)
 {
+  if (chars == " \t") {
+    // Avoid the cost of building find_first_not_of()'s lookup table.
+    const char *begin = str.data();
+    const char *end = begin + str.size();
+    while (begin != end && (*begin == ' ' || *begin == '\t')) {
+      ++begin;
+    }
+    while (end != begin && (end[-1] == ' ' || end[-1] == '\t')) {
+      --end;
+    }
+    str.set(begin, end - begin);
+    return;
+  }
   std::string::size_type first = str.find_first_not_of(chars);
   if (first == std::string::npos) {
     str.clear();
@@ -1,6 +1,7 @@
 #ifndef TACO_SRC_TACO_BASE_STRING_UTIL_H_
 #define TACO_SRC_TACO_BASE_STRING_UTIL_H_
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -8,15 +9,28 @@
 
 namespace taco {
 
-// Variant of Moses' Tokenize() that uses StringPiece.
+// Variant of Moses' Tokenize() that uses StringPiece.  The default
+// delimiters (space and tab) are matched 16 bytes at a time where SSE2 is
+// available.
 void Tokenize(std::vector<StringPiece> &output, StringPiece str,
               const std::string &delimiters = " \t");
 
 // Variant of Moses' TokenizeMultiCharSeparator() that uses StringPiece.
+// The fields are trimmed.
 void TokenizeMultiCharSeparator(std::vector<StringPiece> &output,
                                 StringPiece str,
                                 const std::string &separator = "|||");
 
+// Returns the position of the first Moses field separator ("|||") in str at
+// or after pos, or std::string::npos.  Equivalent to str.find("|||", pos),
+// but where SSE2 is available it tests 16 positions at a time.
+std::size_t FindFieldSeparator(const StringPiece &str, std::size_t pos = 0);
+
+// Splits a Moses-style line into its trimmed fields, which are appended to
+// output: a line with n separators has n+1 fields.  Equivalent to
+// TokenizeMultiCharSeparator(output, str, "|||").
+void SplitFields(std::vector<StringPiece> &output, const StringPiece &str);
+
 void Trim(StringPiece &str, const std::string &chars =" \t");
 
 }  // namespace taco
@@ -0,0 +1,117 @@
+#include "taco/base/thread_pool.h"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+namespace taco {
+
+ThreadPool::ThreadPool(std::size_t num_threads)
+    : job_(0)
+    , num_items_(0)
+    , chunk_size_(1)
+    , next_(0)
+    , generation_(0)
+    , active_(0)
+    , stop_(false) {
+  for (std::size_t i = 1; i < num_threads; ++i) {
+    threads_.create_thread(boost::bind(&ThreadPool::WorkerLoop, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  work_ready_.notify_all();
+  threads_.join_all();
+}
+
+void ThreadPool::Execute(Job &job, std::size_t num_items,
+                         std::size_t chunk_size) {
+  if (chunk_size == 0) {
+    chunk_size = 1;
+  }
+  // Don't wake the workers for a single chunk.
+  if (threads_.size() == 0 || num_items <= chunk_size) {
+    if (num_items > 0) {
+      job.Run(0, num_items, 0);
+    }
+    return;
+  }
+
+  boost::mutex::scoped_lock execute_lock(execute_mutex_);
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    job_ = &job;
+    num_items_ = num_items;
+    chunk_size_ = chunk_size;
+    next_ = 0;
+    active_ = threads_.size();
+    error_ = boost::exception_ptr();
+    ++generation_;
+  }
+  work_ready_.notify_all();
+
+  Work(0);
+
+  boost::exception_ptr error;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (active_ > 0) {
+      work_done_.wait(lock);
+    }
+    job_ = 0;
+    error = error_;
+    error_ = boost::exception_ptr();
+  }
+  if (error) {
+    boost::rethrow_exception(error);
+  }
+}
+
+void ThreadPool::WorkerLoop(std::size_t worker) {
+  std::size_t seen = 0;
+  boost::mutex::scoped_lock lock(mutex_);
+  while (true) {
+    while (!stop_ && generation_ == seen) {
+      work_ready_.wait(lock);
+    }
+    if (stop_) {
+      return;
+    }
+    seen = generation_;
+    lock.unlock();
+    Work(worker);
+    lock.lock();
+    if (--active_ == 0) {
+      work_done_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::Work(std::size_t worker) {
+  while (true) {
+    std::size_t begin, end;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (next_ >= num_items_ || error_) {
+        return;
+      }
+      begin = next_;
+      end = std::min(begin + chunk_size_, num_items_);
+      next_ = end;
+    }
+    try {
+      job_->Run(begin, end, worker);
+    } catch (...) {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (!error_) {
+        error_ = boost::current_exception();
+      }
+    }
+  }
+}
+
+}  // namespace taco
@@ -0,0 +1,76 @@
+#ifndef TACO_SRC_TACO_BASE_THREAD_POOL_H_
+#define TACO_SRC_TACO_BASE_THREAD_POOL_H_
+
+#include <cstddef>
+
+#include <boost/exception_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace taco {
+
+// A fixed set of worker threads for data-parallel loops.  Execute() divides a
+// range of items into chunks of consecutive items and the workers (including
+// the calling thread) repeatedly claim the next unclaimed chunk until none
+// remain.  Since chunks are claimed on demand rather than assigned up front,
+// a worker that draws cheap items goes on to take work that would otherwise
+// have waited behind an expensive item, so skewed workloads stay balanced
+// provided there are several chunks per worker.
+class ThreadPool {
+ public:
+  // A loop body.  Run() may be called concurrently for disjoint ranges.
+  class Job {
+   public:
+    virtual ~Job() {}
+
+    // Processes the items in [begin, end).  The worker number is less than
+    // the pool's Size() and no two concurrent calls have the same number, so
+    // it can be used to select per-thread scratch space.
+    virtual void Run(std::size_t begin, std::size_t end,
+                     std::size_t worker) = 0;
+  };
+
+  // Creates a pool in which the calling thread plus num_threads-1 new
+  // threads share the work.  A pool of size 0 or 1 runs every job in the
+  // calling thread.
+  explicit ThreadPool(std::size_t num_threads);
+
+  ~ThreadPool();
+
+  // Returns the number of threads that share the work.
+  std::size_t Size() const { return threads_.size() + 1; }
+
+  // Runs the job over items [0, num_items) in chunks of chunk_size items
+  // (the last chunk may be smaller) and returns when every chunk has been
+  // processed.  If Run() throws then the remaining chunks are abandoned and
+  // the exception is rethrown here.  Calls from different threads are
+  // serialized.  A job must not call Execute() on its own pool.
+  void Execute(Job &, std::size_t num_items, std::size_t chunk_size);
+
+ private:
+  // Copying is not allowed
+  ThreadPool(const ThreadPool &);
+  ThreadPool &operator=(const ThreadPool &);
+
+  void WorkerLoop(std::size_t);
+  void Work(std::size_t);
+
+  boost::thread_group threads_;
+  boost::mutex execute_mutex_;
+  boost::mutex mutex_;
+  boost::condition_variable work_ready_;
+  boost::condition_variable work_done_;
+  Job *job_;
+  std::size_t num_items_;
+  std::size_t chunk_size_;
+  std::size_t next_;
+  std::size_t generation_;
+  std::size_t active_;
+  bool stop_;
+  boost::exception_ptr error_;
+};
+
+}  // namespace taco
+
+#endif
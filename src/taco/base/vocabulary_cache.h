@@ -0,0 +1,50 @@
+#ifndef TACO_SRC_TACO_BASE_VOCABULARY_CACHE_H_
+#define TACO_SRC_TACO_BASE_VOCABULARY_CACHE_H_
+
+#include <cstddef>
+#include <utility>
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "taco/base/string_piece.h"
+#include "taco/base/vocabulary.h"
+
+namespace taco {
+
+// Front end to a Vocabulary for parsers that hold their input as StringPieces.
+// Insert() hashes the piece in place and only constructs a std::string the
+// first time it sees a new string.  The cache's keys point into the strings
+// owned by the vocabulary, so the vocabulary must not be cleared while the
+// cache is in use.
+class VocabularyCache {
+ public:
+  explicit VocabularyCache(Vocabulary &vocab) : vocab_(&vocab) {}
+
+  // As Vocabulary::Insert().
+  Vocabulary::IdType Insert(const StringPiece &s) {
+    Map::const_iterator p = map_.find(s);
+    if (p != map_.end()) {
+      return p->second;
+    }
+    Vocabulary::IdType id = vocab_->Insert(s.as_string());
+    map_.insert(std::make_pair(StringPiece(vocab_->Lookup(id)), id));
+    return id;
+  }
+
+ private:
+  struct Hasher {
+    std::size_t operator()(const StringPiece &s) const {
+      return boost::hash_range(s.begin(), s.end());
+    }
+  };
+
+  typedef boost::unordered_map<StringPiece, Vocabulary::IdType, Hasher> Map;
+
+  Vocabulary *vocab_;
+  Map map_;
+};
+
+}  // namespace taco
+
+#endif
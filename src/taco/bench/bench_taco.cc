@@ -0,0 +1,541 @@
+// Benchmarks the core operations of libtaco over synthetic German noun phrase
+// agreement workloads and writes the timings to standard output as JSON, so
+// that runs of different versions can be compared.
+//
+// Each option is the analysis of a word in a noun phrase (determiner,
+// adjectives, noun) with an AGR value giving case, number and gender, plus
+// values that the constraints never look at.  A word is ambiguous between a
+// number of randomly chosen agreement cells.  The constraint sets require
+// every word to agree with the first and give the noun phrase's case and a
+// distribution over its number.
+//
+// Usage: bench-taco [SCALE [SEED [REPEAT]]]
+//
+// SCALE multiplies the number of iterations of every benchmark (default 1),
+// SEED seeds the generators (default 1) and each benchmark is timed REPEAT
+// times (default 3), of which the fastest run is reported.  Timings are
+// processor times measured with std::clock.  Each result has a checksum
+// (such as the number of successful unifications) that should only change
+// if behaviour changes.
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "taco/base/string_piece.h"
+#include "taco/base/string_util.h"
+#include "taco/base/vocabulary.h"
+#include "taco/compiled_constraint_set.h"
+#include "taco/constraint_evaluator.h"
+#include "taco/constraint_set.h"
+#include "taco/feature_structure.h"
+#include "taco/interpretation.h"
+#include "taco/option_table.h"
+#include "taco/text-formats/constraint_set_parser.h"
+#include "taco/text-formats/feature_structure_parser.h"
+
+namespace {
+
+typedef boost::shared_ptr<taco::FeatureStructure> SPFS;
+
+const char *const kCases[] = {"nom", "acc", "dat", "gen"};
+const char *const kNumbers[] = {"sg", "pl"};
+const char *const kGenders[] = {"m", "f", "n"};
+const char *const kDecls[] = {"weak", "strong", "mixed"};
+const int kNumCases = 4;
+const int kNumNumbers = 2;
+const int kNumGenders = 3;
+const int kNumDecls = 3;
+const int kNumCells = kNumCases * kNumNumbers * kNumGenders;
+const int kNumLemmas = 50;
+
+// The parameters of a benchmark, as (name, value) pairs.
+typedef std::vector<std::pair<std::string, int> > Params;
+
+struct Result {
+  std::string name;
+  Params params;
+  std::size_t num_ops;
+  double seconds;
+  std::size_t checksum;
+};
+
+// A benchmark body.  Run() performs one timed run and returns its checksum.
+class Benchmark {
+ public:
+  virtual ~Benchmark() {}
+  virtual std::size_t Run() = 0;
+};
+
+double Seconds(std::clock_t start) {
+  return static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+}
+
+int Random(int n) {
+  return std::rand() % n;
+}
+
+// Returns the text of an analysis of a word with the given lemma, in the
+// given agreement cell.
+std::string GenerateOption(const char *cat, int lemma, int cell) {
+  std::ostringstream out;
+  out << "[CAT:" << cat
+      << ";AGR:[CASE:" << kCases[cell % kNumCases]
+      << ";NUM:" << kNumbers[(cell / kNumCases) % kNumNumbers]
+      << ";GEN:" << kGenders[cell / (kNumCases * kNumNumbers)]
+      << "];DECL:" << kDecls[lemma % kNumDecls]
+      << ";LEMMA:l" << lemma << "]";
+  return out.str();
+}
+
+// Returns the text of a random analysis of a random word.
+std::string GenerateOption(const char *cat) {
+  return GenerateOption(cat, Random(kNumLemmas), Random(kNumCells));
+}
+
+// Returns the text of a column's options: the given number of readings for
+// each of the given number of lemmas.
+void GenerateColumn(const char *cat, int num_lemmas, int ambiguity,
+                    std::vector<std::string> &options) {
+  for (int i = 0; i < num_lemmas; ++i) {
+    int lemma = Random(kNumLemmas);
+    for (int j = 0; j < ambiguity; ++j) {
+      options.push_back(GenerateOption(cat, lemma, Random(kNumCells)));
+    }
+  }
+}
+
+// Returns the text of the agreement constraints for a noun phrase of the
+// given width.
+std::string GenerateConstraintSet(int width) {
+  std::ostringstream out;
+  const char *features[] = {"CASE", "NUM", "GEN"};
+  for (int i = 1; i < width; ++i) {
+    for (int f = 0; f < 3; ++f) {
+      out << "<0\"AGR\"\"" << features[f] << "\"> = <" << i << "\"AGR\"\""
+          << features[f] << "\"> ";
+    }
+  }
+  out << "<" << (width - 1) << "\"AGR\"\"CASE\"> = \""
+      << kCases[Random(kNumCases)] << "\" ";
+  out << "<0\"AGR\"\"NUM\"> = {\"sg\":0.7,\"pl\":0.3}";
+  return out.str();
+}
+
+// Returns a rule table line in the Moses format for a rule with a random
+// number of terminals.
+std::string GenerateRule() {
+  std::ostringstream out;
+  int n = 1 + Random(5);
+  out << "[X][NP]";
+  for (int i = 0; i < n; ++i) {
+    out << " w" << Random(1000);
+  }
+  out << " [X] ||| [X][NP]";
+  for (int i = 0; i < n; ++i) {
+    out << " t" << Random(1000);
+  }
+  out << " [NP] ||| 0.25 0.0625 0.5 0.125 ||| ";
+  for (int i = 0; i < n; ++i) {
+    out << i << "-" << i << " ";
+  }
+  out << "||| " << Random(100) << " " << Random(100) << " 1 ||| |||";
+  return out.str();
+}
+
+// Builds an option table for a noun phrase of the given width: a
+// determiner, width-2 adjectives and a noun.
+void GenerateTable(taco::FeatureStructureParser &parser, int width,
+                   int num_lemmas, int ambiguity, taco::OptionTable &table) {
+  for (int i = 0; i < width; ++i) {
+    const char *cat = (i == 0) ? "det" : (i == width-1) ? "nn" : "adj";
+    std::vector<std::string> options;
+    GenerateColumn(cat, num_lemmas, ambiguity, options);
+    taco::OptionColumn col;
+    for (std::vector<std::string>::const_iterator p = options.begin();
+         p != options.end(); ++p) {
+      col.Add(parser.Parse(*p));
+    }
+    table.AddColumn(i, col);
+  }
+}
+
+class ParseFSBenchmark : public Benchmark {
+ public:
+  ParseFSBenchmark(const std::vector<std::string> &strings, int repeat)
+      : strings_(strings), repeat_(repeat) {}
+  std::size_t Run() {
+    taco::Vocabulary feature_set;
+    taco::Vocabulary value_set;
+    taco::FeatureStructureParser parser(feature_set, value_set);
+    std::size_t checksum = 0;
+    for (int i = 0; i < repeat_; ++i) {
+      for (std::vector<std::string>::const_iterator p = strings_.begin();
+           p != strings_.end(); ++p) {
+        checksum += parser.Parse(*p)->IsComplex();
+      }
+    }
+    return checksum;
+  }
+ private:
+  const std::vector<std::string> &strings_;
+  int repeat_;
+};
+
+class ParseConstraintSetBenchmark : public Benchmark {
+ public:
+  ParseConstraintSetBenchmark(const std::vector<std::string> &strings,
+                              int repeat)
+      : strings_(strings), repeat_(repeat) {}
+  std::size_t Run() {
+    taco::Vocabulary feature_set;
+    taco::Vocabulary value_set;
+    taco::ConstraintSetParser parser(feature_set, value_set);
+    std::size_t checksum = 0;
+    for (int i = 0; i < repeat_; ++i) {
+      for (std::vector<std::string>::const_iterator p = strings_.begin();
+           p != strings_.end(); ++p) {
+        checksum += parser.Parse(*p)->Size();
+      }
+    }
+    return checksum;
+  }
+ private:
+  const std::vector<std::string> &strings_;
+  int repeat_;
+};
+
+// Splits rule table lines into fields and tokenizes each field.
+class SplitFieldsBenchmark : public Benchmark {
+ public:
+  SplitFieldsBenchmark(const std::vector<std::string> &lines, int repeat)
+      : lines_(lines), repeat_(repeat) {}
+  std::size_t Run() {
+    std::vector<taco::StringPiece> fields;
+    std::vector<taco::StringPiece> tokens;
+    std::size_t checksum = 0;
+    for (int i = 0; i < repeat_; ++i) {
+      for (std::vector<std::string>::const_iterator p = lines_.begin();
+           p != lines_.end(); ++p) {
+        fields.clear();
+        taco::SplitFields(fields, *p);
+        for (std::vector<taco::StringPiece>::const_iterator q =
+             fields.begin(); q != fields.end(); ++q) {
+          tokens.clear();
+          taco::Tokenize(tokens, *q);
+          checksum += tokens.size();
+        }
+      }
+    }
+    return checksum;
+  }
+ private:
+  const std::vector<std::string> &lines_;
+  int repeat_;
+};
+
+class CloneBenchmark : public Benchmark {
+ public:
+  CloneBenchmark(const std::vector<SPFS> &fs_vec, int repeat)
+      : fs_vec_(fs_vec), repeat_(repeat) {}
+  std::size_t Run() {
+    std::size_t checksum = 0;
+    for (int i = 0; i < repeat_; ++i) {
+      for (std::vector<SPFS>::const_iterator p = fs_vec_.begin();
+           p != fs_vec_.end(); ++p) {
+        checksum += (*p)->Clone()->IsComplex();
+      }
+    }
+    return checksum;
+  }
+ private:
+  const std::vector<SPFS> &fs_vec_;
+  int repeat_;
+};
+
+class MultiCloneBenchmark : public Benchmark {
+ public:
+  MultiCloneBenchmark(const std::vector<SPFS> &fs_vec, int repeat)
+      : fs_vec_(fs_vec), repeat_(repeat) {}
+  std::size_t Run() {
+    std::size_t checksum = 0;
+    std::vector<SPFS> clones;
+    for (int i = 0; i < repeat_; ++i) {
+      clones.clear();
+      taco::FeatureStructure::MultiClone(fs_vec_.begin(), fs_vec_.end(),
+                                         std::back_inserter(clones));
+      checksum += clones.size();
+    }
+    return checksum;
+  }
+ private:
+  const std::vector<SPFS> &fs_vec_;
+  int repeat_;
+};
+
+// Destructively unifies clones of every pair of feature structures.
+class UnifyBenchmark : public Benchmark {
+ public:
+  explicit UnifyBenchmark(const std::vector<SPFS> &fs_vec) : fs_vec_(fs_vec) {}
+  std::size_t Run() {
+    std::size_t checksum = 0;
+    for (std::vector<SPFS>::const_iterator p = fs_vec_.begin();
+         p != fs_vec_.end(); ++p) {
+      for (std::vector<SPFS>::const_iterator q = fs_vec_.begin();
+           q != fs_vec_.end(); ++q) {
+        SPFS x = (*p)->Clone();
+        SPFS y = (*q)->Clone();
+        checksum += taco::FeatureStructure::Unify(x, y);
+      }
+    }
+    return checksum;
+  }
+ private:
+  const std::vector<SPFS> &fs_vec_;
+};
+
+class PossiblyUnifiableBenchmark : public Benchmark {
+ public:
+  explicit PossiblyUnifiableBenchmark(const std::vector<SPFS> &fs_vec)
+      : fs_vec_(fs_vec) {}
+  std::size_t Run() {
+    std::size_t checksum = 0;
+    for (std::vector<SPFS>::const_iterator p = fs_vec_.begin();
+         p != fs_vec_.end(); ++p) {
+      for (std::vector<SPFS>::const_iterator q = fs_vec_.begin();
+           q != fs_vec_.end(); ++q) {
+        checksum += (*p)->PossiblyUnifiable(*q);
+      }
+    }
+    return checksum;
+  }
+ private:
+  const std::vector<SPFS> &fs_vec_;
+};
+
+// Builds an interpretation from every pair of options of the first two
+// columns and evaluates the constraints on it.  Since evaluation modifies
+// the interpretation, the time includes building it (which clones both
+// feature structures).
+class InterpretationEvalBenchmark : public Benchmark {
+ public:
+  InterpretationEvalBenchmark(const taco::OptionTable &table,
+                              const taco::CompiledConstraintSet &compiled)
+      : table_(table), compiled_(compiled) {}
+  std::size_t Run() {
+    const taco::OptionColumn &col0 = table_.begin()->second;
+    const taco::OptionColumn &col1 = (++table_.begin())->second;
+    std::size_t checksum = 0;
+    for (taco::OptionColumn::const_iterator p = col0.begin();
+         p != col0.end(); ++p) {
+      taco::Interpretation first(0, (*p)->Clone());
+      for (taco::OptionColumn::const_iterator q = col1.begin();
+           q != col1.end(); ++q) {
+        taco::PotentialInterpretation candidate(first, 1, *q);
+        taco::Interpretation interpretation(candidate);
+        checksum += !interpretation.IsEmpty() &&
+                    interpretation.Eval(compiled_);
+      }
+    }
+    return checksum;
+  }
+ private:
+  const taco::OptionTable &table_;
+  const taco::CompiledConstraintSet &compiled_;
+};
+
+class EvaluatorBenchmark : public Benchmark {
+ public:
+  EvaluatorBenchmark(const taco::OptionTable &table,
+                     const taco::CompiledConstraintSet &compiled, int repeat)
+      : table_(table), compiled_(compiled), repeat_(repeat) {}
+  std::size_t Run() {
+    taco::ConstraintEvaluator evaluator;
+    std::vector<taco::Interpretation> results;
+    std::size_t checksum = 0;
+    for (int i = 0; i < repeat_; ++i) {
+      evaluator.Eval(table_, compiled_, results);
+      checksum += results.size();
+    }
+    return checksum;
+  }
+ private:
+  const taco::OptionTable &table_;
+  const taco::CompiledConstraintSet &compiled_;
+  int repeat_;
+};
+
+// Times the benchmark the given number of times and records the fastest run.
+void Time(const std::string &name, const Params &params, std::size_t num_ops,
+          Benchmark &benchmark, int repeat, std::vector<Result> &results) {
+  Result result;
+  result.name = name;
+  result.params = params;
+  result.num_ops = num_ops;
+  result.seconds = -1.0;
+  result.checksum = 0;
+  for (int i = 0; i < repeat; ++i) {
+    std::clock_t start = std::clock();
+    result.checksum = benchmark.Run();
+    double seconds = Seconds(start);
+    if (result.seconds < 0.0 || seconds < result.seconds) {
+      result.seconds = seconds;
+    }
+  }
+  results.push_back(result);
+}
+
+Params MakeParams(const char *name1 = 0, int value1 = 0,
+                  const char *name2 = 0, int value2 = 0) {
+  Params params;
+  if (name1) {
+    params.push_back(std::make_pair(std::string(name1), value1));
+  }
+  if (name2) {
+    params.push_back(std::make_pair(std::string(name2), value2));
+  }
+  return params;
+}
+
+// The names and parameter names are plain identifiers, so no escaping is
+// needed.
+void WriteJSON(unsigned int seed, int scale, int repeat,
+               const std::vector<Result> &results, std::ostream &out) {
+  out << "{\n"
+      << "  \"seed\": " << seed << ",\n"
+      << "  \"scale\": " << scale << ",\n"
+      << "  \"repeat\": " << repeat << ",\n"
+      << "  \"results\": [\n";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const Result &r = results[i];
+    out << "    {\"name\": \"" << r.name << "\", \"params\": {";
+    for (std::size_t j = 0; j < r.params.size(); ++j) {
+      out << (j ? ", " : "") << "\"" << r.params[j].first << "\": "
+          << r.params[j].second;
+    }
+    double ns_per_op = r.num_ops ? r.seconds * 1e9 / r.num_ops : 0.0;
+    out << "}, \"ops\": " << r.num_ops
+        << ", \"seconds\": " << r.seconds
+        << ", \"ns_per_op\": " << ns_per_op
+        << ", \"checksum\": " << r.checksum << "}"
+        << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  out << "  ]\n"
+      << "}\n";
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  using namespace taco;
+
+  int scale = argc > 1 ? std::atoi(argv[1]) : 1;
+  unsigned int seed = argc > 2 ? std::atoi(argv[2]) : 1;
+  int repeat = argc > 3 ? std::atoi(argv[3]) : 3;
+  if (scale < 1 || repeat < 1) {
+    std::cerr << "Usage: " << argv[0] << " [SCALE [SEED [REPEAT]]]"
+              << std::endl;
+    return 1;
+  }
+  std::srand(seed);
+
+  std::vector<Result> results;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser fs_parser(feature_set, value_set);
+  ConstraintSetParser cs_parser(feature_set, value_set);
+
+  // Text parsers.
+  std::vector<std::string> fs_strings;
+  for (int i = 0; i < 1000; ++i) {
+    fs_strings.push_back(GenerateOption("adj"));
+  }
+  {
+    ParseFSBenchmark benchmark(fs_strings, 10 * scale);
+    Time("parse-fs", MakeParams(), fs_strings.size() * 10 * scale, benchmark,
+         repeat, results);
+  }
+  std::vector<std::string> cs_strings;
+  for (int i = 0; i < 1000; ++i) {
+    cs_strings.push_back(GenerateConstraintSet(2 + i % 4));
+  }
+  {
+    ParseConstraintSetBenchmark benchmark(cs_strings, 10 * scale);
+    Time("parse-constraint-set", MakeParams(),
+         cs_strings.size() * 10 * scale, benchmark, repeat, results);
+  }
+
+  std::vector<std::string> rule_lines;
+  for (int i = 0; i < 1000; ++i) {
+    rule_lines.push_back(GenerateRule());
+  }
+  {
+    SplitFieldsBenchmark benchmark(rule_lines, 100 * scale);
+    Time("split-fields", MakeParams(), rule_lines.size() * 100 * scale,
+         benchmark, repeat, results);
+  }
+
+  // Feature structure operations.
+  std::vector<SPFS> fs_vec;
+  for (std::vector<std::string>::const_iterator p = fs_strings.begin();
+       p != fs_strings.end(); ++p) {
+    fs_vec.push_back(fs_parser.Parse(*p));
+  }
+  {
+    CloneBenchmark benchmark(fs_vec, 10 * scale);
+    Time("clone", MakeParams(), fs_vec.size() * 10 * scale, benchmark, repeat,
+         results);
+  }
+  {
+    MultiCloneBenchmark benchmark(fs_vec, 10 * scale);
+    Time("multi-clone", MakeParams(), fs_vec.size() * 10 * scale, benchmark,
+         repeat, results);
+  }
+  {
+    std::size_t n = std::min(fs_vec.size(), std::size_t(100) * scale);
+    std::vector<SPFS> pairs_vec(fs_vec.begin(), fs_vec.begin() + n);
+    UnifyBenchmark benchmark(pairs_vec);
+    Time("clone+unify", MakeParams(), pairs_vec.size() * pairs_vec.size(),
+         benchmark, repeat, results);
+    PossiblyUnifiableBenchmark benchmark2(fs_vec);
+    Time("possibly-unifiable", MakeParams(), fs_vec.size() * fs_vec.size(),
+         benchmark2, repeat, results);
+  }
+
+  // Constraint evaluation at varying noun phrase widths and ambiguity.
+  const int widths[] = {2, 3, 4};
+  const int ambiguities[] = {1, 4, 8};
+  for (int w = 0; w < 3; ++w) {
+    for (int a = 0; a < 3; ++a) {
+      const int width = widths[w];
+      const int ambiguity = ambiguities[a];
+      OptionTable table;
+      GenerateTable(fs_parser, width, 8, ambiguity, table);
+      boost::shared_ptr<ConstraintSet> cs =
+          cs_parser.Parse(GenerateConstraintSet(width));
+      CompiledConstraintSet compiled(*cs);
+      Params params = MakeParams("width", width, "ambiguity", ambiguity);
+      if (w == 0) {
+        InterpretationEvalBenchmark benchmark(table, compiled);
+        std::size_t num_ops = table.begin()->second.Size() *
+                              (++table.begin())->second.Size();
+        Time("interpretation-eval", params, num_ops, benchmark, repeat,
+             results);
+      }
+      EvaluatorBenchmark benchmark(table, compiled, 10 * scale);
+      Time("evaluator-eval", params, 10 * scale, benchmark, repeat, results);
+    }
+  }
+
+  WriteJSON(seed, scale, repeat, results, std::cout);
+  return 0;
+}
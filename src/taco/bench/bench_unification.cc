@@ -0,0 +1,126 @@
+// Compares the cost of destructive unification (which requires the operands
+// to be cloned beforehand if they are to be preserved) with quasi-destructive
+// unification, over a set of randomly generated feature structures.
+//
+// Usage: bench-unification [NUM_FS [NUM_LEAVES [SEED]]]
+
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "taco/base/basic_types.h"
+#include "taco/feature_path.h"
+#include "taco/feature_structure.h"
+#include "taco/feature_structure_spec.h"
+
+namespace {
+
+typedef boost::shared_ptr<taco::FeatureStructure> SPFS;
+
+const int kDepth = 3;
+const int kFeaturesPerLevel = 4;
+const int kNumValues = 4;
+
+// Generates a feature structure with up to num_leaves atomic values, all at
+// depth kDepth.  Features at different levels are drawn from disjoint sets.
+SPFS GenerateFS(int num_leaves) {
+  std::map<taco::FeaturePath, taco::AtomicValue> leaves;
+  for (int i = 0; i < num_leaves; ++i) {
+    taco::FeaturePath path;
+    for (int d = 0; d < kDepth; ++d) {
+      path.push_back(d * kFeaturesPerLevel + std::rand() % kFeaturesPerLevel);
+    }
+    leaves[path] = std::rand() % kNumValues;
+  }
+  taco::FeatureStructureSpec spec;
+  spec.content_pairs.insert(leaves.begin(), leaves.end());
+  return SPFS(new taco::FeatureStructure(spec));
+}
+
+double Seconds(std::clock_t start) {
+  return static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+}
+
+void Report(const char *name, double seconds, std::size_t num_pairs,
+            std::size_t num_successes) {
+  std::cout << name << ": " << seconds << " s, "
+            << (seconds * 1e9 / num_pairs) << " ns/pair, "
+            << num_successes << " successes" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  using namespace taco;
+
+  int num_fs = argc > 1 ? std::atoi(argv[1]) : 1000;
+  int num_leaves = argc > 2 ? std::atoi(argv[2]) : 16;
+  unsigned int seed = argc > 3 ? std::atoi(argv[3]) : 1;
+  std::srand(seed);
+
+  std::vector<SPFS> fs_vec;
+  fs_vec.reserve(num_fs);
+  for (int i = 0; i < num_fs; ++i) {
+    fs_vec.push_back(GenerateFS(num_leaves));
+  }
+  const std::size_t num_pairs = fs_vec.size() * fs_vec.size();
+
+  // Destructive unification of clones.
+  {
+    std::size_t num_successes = 0;
+    std::clock_t start = std::clock();
+    for (std::vector<SPFS>::const_iterator p = fs_vec.begin();
+         p != fs_vec.end(); ++p) {
+      for (std::vector<SPFS>::const_iterator q = fs_vec.begin();
+           q != fs_vec.end(); ++q) {
+        SPFS x = (*p)->Clone();
+        SPFS y = (*q)->Clone();
+        if (FeatureStructure::Unify(x, y)) {
+          ++num_successes;
+        }
+      }
+    }
+    Report("clone+unify", Seconds(start), num_pairs, num_successes);
+  }
+
+  // Quasi-destructive unification without copying the result.
+  {
+    QuasiDestructiveUnifier unifier;
+    std::size_t num_successes = 0;
+    std::clock_t start = std::clock();
+    for (std::vector<SPFS>::const_iterator p = fs_vec.begin();
+         p != fs_vec.end(); ++p) {
+      for (std::vector<SPFS>::const_iterator q = fs_vec.begin();
+           q != fs_vec.end(); ++q) {
+        if (unifier.IsUnifiable(**p, **q)) {
+          ++num_successes;
+        }
+      }
+    }
+    Report("qd-unify", Seconds(start), num_pairs, num_successes);
+  }
+
+  // Quasi-destructive unification, copying the result on success.
+  {
+    QuasiDestructiveUnifier unifier;
+    std::size_t num_successes = 0;
+    std::clock_t start = std::clock();
+    for (std::vector<SPFS>::const_iterator p = fs_vec.begin();
+         p != fs_vec.end(); ++p) {
+      for (std::vector<SPFS>::const_iterator q = fs_vec.begin();
+           q != fs_vec.end(); ++q) {
+        if (unifier.UnifyAndCopy(**p, **q)) {
+          ++num_successes;
+        }
+      }
+    }
+    Report("qd-unify+copy", Seconds(start), num_pairs, num_successes);
+  }
+
+  return 0;
+}
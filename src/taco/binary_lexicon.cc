@@ -0,0 +1,355 @@
+#include "taco/binary_lexicon.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <utility>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "taco/base/exception.h"
+#include "taco/feature_structure_interner.h"
+
+namespace taco {
+
+using namespace binary_format;
+
+// The file begins with a header giving the number of elements in and the
+// byte offset of each of the following sections (each aligned to 8 bytes):
+//
+//   features, values, words   String pools: a count n, n+1 offsets into the
+//                             characters, then the characters.
+//   buckets, slots            The word index (see PerfectHash).
+//   word entries              For each word w, the index of its first entry;
+//                             its entries end at the first entry of w+1.
+//   entries                   The ID of the root node of each entry.
+//   nodes                     For each node, its atomic value (kNullAtom if
+//                             none) and the index of its first arc; its arcs
+//                             end at the first arc of the next node.
+//   arcs                      A feature and the ID of its value's node.
+//
+// Every node's values have lower IDs than the node itself.  All integers are
+// in the byte order of the machine that wrote the file, which is checked
+// when the file is opened.
+struct BinaryLexicon::Header {
+  char magic[8];
+  boost::uint32_t version;
+  boost::uint32_t byte_order;
+  boost::uint32_t num_words;
+  boost::uint32_t num_entries;
+  boost::uint32_t num_nodes;
+  boost::uint32_t num_arcs;
+  boost::uint32_t num_buckets;
+  boost::uint32_t num_slots;
+  boost::uint64_t features_offset;
+  boost::uint64_t values_offset;
+  boost::uint64_t words_offset;
+  boost::uint64_t buckets_offset;
+  boost::uint64_t slots_offset;
+  boost::uint64_t word_entries_offset;
+  boost::uint64_t entries_offset;
+  boost::uint64_t nodes_offset;
+  boost::uint64_t arcs_offset;
+  boost::uint64_t size;
+};
+
+struct BinaryLexicon::Node {
+  boost::uint32_t atom;
+  boost::uint32_t first_arc;
+};
+
+struct BinaryLexicon::Arc {
+  boost::uint32_t feature;
+  boost::uint32_t node;
+};
+
+namespace {
+
+const char kMagic[8] = {'T', 'A', 'C', 'O', 'B', 'L', 'X', '\0'};
+const boost::uint32_t kVersion = 1;
+const boost::uint32_t kByteOrder = 0x01020304;
+
+}  // namespace
+
+BinaryLexicon::BinaryLexicon(const std::string &path) {
+  namespace bi = boost::interprocess;
+  try {
+    bi::file_mapping file(path.c_str(), bi::read_only);
+    region_.reset(new bi::mapped_region(file, bi::read_only));
+  } catch (const bi::interprocess_exception &e) {
+    std::ostringstream msg;
+    msg << "failed to map binary lexicon `" << path << "': " << e.what();
+    throw Exception(msg.str());
+  }
+  Init(static_cast<const char *>(region_->get_address()), region_->get_size());
+}
+
+BinaryLexicon::BinaryLexicon(const char *data, std::size_t size) {
+  Init(data, size);
+}
+
+BinaryLexicon::~BinaryLexicon() {
+}
+
+void BinaryLexicon::Init(const char *data, std::size_t size) {
+  if (size < sizeof(Header)) {
+    throw Exception("binary lexicon is truncated");
+  }
+  const Header &header = *reinterpret_cast<const Header *>(data);
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    throw Exception("not a binary lexicon");
+  }
+  if (header.byte_order != kByteOrder) {
+    throw Exception("binary lexicon was written with a different byte order");
+  }
+  if (header.version != kVersion) {
+    std::ostringstream msg;
+    msg << "unsupported binary lexicon version: " << header.version;
+    throw Exception(msg.str());
+  }
+  if (header.size != size) {
+    throw Exception("binary lexicon is truncated");
+  }
+
+  num_words_ = header.num_words;
+  num_entries_ = header.num_entries;
+  num_nodes_ = header.num_nodes;
+
+  try {
+    features_.Init(data, size, header.features_offset);
+    values_.Init(data, size, header.values_offset);
+    words_.Init(data, size, header.words_offset);
+    const std::size_t n = sizeof(boost::uint32_t);
+    CheckSection(header.buckets_offset, header.num_buckets * n, size,
+                 "bucket");
+    CheckSection(header.slots_offset, header.num_slots * n, size, "slot");
+    CheckSection(header.word_entries_offset, (num_words_ + 1) * n, size,
+                 "word entry");
+    CheckSection(header.entries_offset, num_entries_ * n, size, "entry");
+    CheckSection(header.nodes_offset, (num_nodes_ + 1) * sizeof(Node), size,
+                 "node");
+    CheckSection(header.arcs_offset, header.num_arcs * sizeof(Arc), size,
+                 "arc");
+  } catch (const Exception &e) {
+    throw Exception("binary lexicon has " + e.msg());
+  }
+  if (words_.Size() != num_words_ || header.num_buckets == 0 ||
+      header.num_slots == 0) {
+    throw Exception("binary lexicon has invalid word index");
+  }
+
+  index_ = PerfectHash(
+      reinterpret_cast<const boost::uint32_t *>(data + header.buckets_offset),
+      header.num_buckets,
+      reinterpret_cast<const boost::uint32_t *>(data + header.slots_offset),
+      header.num_slots);
+  word_entries_ = reinterpret_cast<const boost::uint32_t *>(
+      data + header.word_entries_offset);
+  entries_ = reinterpret_cast<const boost::uint32_t *>(
+      data + header.entries_offset);
+  nodes_ = reinterpret_cast<const Node *>(data + header.nodes_offset);
+  arcs_ = reinterpret_cast<const Arc *>(data + header.arcs_offset);
+
+  if (word_entries_[num_words_] != num_entries_ ||
+      nodes_[num_nodes_].first_arc != header.num_arcs) {
+    throw Exception("binary lexicon is inconsistent");
+  }
+}
+
+void BinaryLexicon::ReadVocabularies(Vocabulary &feature_set,
+                                     Vocabulary &value_set) const {
+  features_.ReadVocabulary(feature_set);
+  values_.ReadVocabulary(value_set);
+}
+
+std::size_t BinaryLexicon::Find(const StringPiece &word) const {
+  boost::uint32_t index = index_.Find(word);
+  if (index >= num_words_ || words_.Get(index) != word) {
+    return kNotFound;
+  }
+  return index;
+}
+
+StringPiece BinaryLexicon::GetWord(std::size_t index) const {
+  return words_.Get(index);
+}
+
+bool BinaryLexicon::Lookup(const StringPiece &word, MappedType &values) const {
+  values.clear();
+  std::size_t index = Find(word);
+  if (index == kNotFound) {
+    return false;
+  }
+  for (std::size_t i = word_entries_[index]; i < word_entries_[index+1]; ++i) {
+    values.push_back(GetNode(entries_[i]));
+  }
+  return true;
+}
+
+boost::shared_ptr<FeatureStructure> BinaryLexicon::GetNode(
+    std::size_t id) const {
+  if (id >= num_nodes_) {
+    throw Exception("binary lexicon is inconsistent");
+  }
+  NodeCache::const_iterator p = node_cache_.find(id);
+  if (p != node_cache_.end()) {
+    return p->second;
+  }
+  boost::shared_ptr<FeatureStructure> result = FeatureStructure::NewNode();
+  result->content_.a = nodes_[id].atom;
+  const std::size_t begin = nodes_[id].first_arc;
+  const std::size_t end = nodes_[id+1].first_arc;
+  result->content_.c.reserve(end - begin);
+  for (std::size_t i = begin; i < end; ++i) {
+    // Values precede their parents, so this cannot recurse indefinitely.
+    if (arcs_[i].node >= id) {
+      throw Exception("binary lexicon is inconsistent");
+    }
+    result->content_.c.insert(result->content_.c.end(),
+                              std::make_pair(arcs_[i].feature,
+                                             GetNode(arcs_[i].node)));
+  }
+  node_cache_[id] = result;
+  return result;
+}
+
+void BinaryLexiconWriter::Write(const Lexicon<std::size_t> &lexicon,
+                                std::ostream &output) const {
+  typedef BinaryLexicon::Node Node;
+  typedef BinaryLexicon::Arc Arc;
+  typedef boost::unordered_map<const FeatureStructure *,
+                               boost::uint32_t> NodeIdMap;
+
+  // Order the words by ID, so that the output does not depend on the order
+  // of the lexicon's hash table.
+  std::vector<std::size_t> word_ids;
+  for (Lexicon<std::size_t>::ConstIterator p = lexicon.Begin();
+       p != lexicon.End(); ++p) {
+    word_ids.push_back(p->first);
+  }
+  std::sort(word_ids.begin(), word_ids.end());
+  CheckCount(word_ids.size(), "words");
+
+  // Intern the feature structures and number their nodes so that values
+  // come before the nodes that contain them.
+  FeatureStructureInterner interner;
+  NodeIdMap node_ids;
+  std::vector<Node> nodes;
+  std::vector<Arc> arcs;
+  std::vector<boost::uint32_t> word_entries;
+  std::vector<boost::uint32_t> entries;
+  Vocabulary words;
+  for (std::vector<std::size_t>::const_iterator p = word_ids.begin();
+       p != word_ids.end(); ++p) {
+    words.Insert(words_.Lookup(*p));
+    word_entries.push_back(entries.size());
+    const Lexicon<std::size_t>::MappedType &values = *lexicon.Lookup(*p);
+    for (Lexicon<std::size_t>::MappedType::const_iterator q = values.begin();
+         q != values.end(); ++q) {
+      boost::shared_ptr<FeatureStructure> root = interner.Intern(**q);
+      // Visit the nodes depth-first, numbering each after its values.
+      std::vector<std::pair<const FeatureStructure *, bool> > stack;
+      stack.push_back(std::make_pair(root.get(), false));
+      while (!stack.empty()) {
+        const FeatureStructure *node = stack.back().first;
+        bool expanded = stack.back().second;
+        stack.pop_back();
+        if (node_ids.find(node) != node_ids.end()) {
+          continue;
+        }
+        const internal::FSContent::Map &c = node->content_.c;
+        if (!expanded) {
+          stack.push_back(std::make_pair(node, true));
+          for (internal::FSContent::Map::const_reverse_iterator r = c.rbegin();
+               r != c.rend(); ++r) {
+            stack.push_back(std::make_pair(r->second.get(), false));
+          }
+          continue;
+        }
+        Node n;
+        n.atom = node->content_.a;
+        n.first_arc = arcs.size();
+        for (internal::FSContent::Map::const_iterator r = c.begin();
+             r != c.end(); ++r) {
+          Arc arc;
+          arc.feature = r->first;
+          arc.node = node_ids[r->second.get()];
+          arcs.push_back(arc);
+        }
+        CheckCount(arcs.size(), "arcs");
+        CheckCount(nodes.size() + 1, "nodes");
+        node_ids[node] = nodes.size();
+        nodes.push_back(n);
+      }
+      entries.push_back(node_ids[root.get()]);
+      CheckCount(entries.size(), "entries");
+    }
+  }
+  word_entries.push_back(entries.size());
+  Node sentinel;
+  sentinel.atom = kNullAtom;
+  sentinel.first_arc = arcs.size();
+  const std::size_t num_nodes = nodes.size();
+  nodes.push_back(sentinel);
+
+  // Build the word index.
+  const std::size_t num_words = word_ids.size();
+  std::vector<StringPiece> keys;
+  keys.reserve(num_words);
+  for (std::size_t i = 0; i < num_words; ++i) {
+    keys.push_back(words.Lookup(i));
+  }
+  std::vector<boost::uint32_t> buckets;
+  std::vector<boost::uint32_t> slots;
+  PerfectHash::Build(keys, buckets, slots);
+
+  // Lay out the sections.
+  std::string body;
+  BinaryLexicon::Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrder;
+  header.num_words = num_words;
+  header.num_entries = entries.size();
+  header.num_nodes = num_nodes;
+  header.num_arcs = arcs.size();
+  header.num_buckets = buckets.size();
+  header.num_slots = slots.size();
+  body.resize(Align(sizeof(header)));
+  header.features_offset = body.size();
+  AppendStringPool(feature_set_, body);
+  AlignBuffer(body);
+  header.values_offset = body.size();
+  AppendStringPool(value_set_, body);
+  AlignBuffer(body);
+  header.words_offset = body.size();
+  AppendStringPool(words, body);
+  AlignBuffer(body);
+  header.buckets_offset = body.size();
+  Append(buckets, body);
+  AlignBuffer(body);
+  header.slots_offset = body.size();
+  Append(slots, body);
+  AlignBuffer(body);
+  header.word_entries_offset = body.size();
+  Append(word_entries, body);
+  AlignBuffer(body);
+  header.entries_offset = body.size();
+  Append(entries, body);
+  AlignBuffer(body);
+  header.nodes_offset = body.size();
+  Append(nodes, body);
+  AlignBuffer(body);
+  header.arcs_offset = body.size();
+  Append(arcs, body);
+  AlignBuffer(body);
+  header.size = body.size();
+  std::memcpy(&body[0], &header, sizeof(header));
+
+  output.write(body.data(), body.size());
+}
+
+}  // namespace taco
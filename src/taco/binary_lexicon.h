@@ -0,0 +1,176 @@
+#ifndef TACO_SRC_TACO_BINARY_LEXICON_H_
+#define TACO_SRC_TACO_BINARY_LEXICON_H_
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "taco/base/binary_format.h"
+#include "taco/base/string_piece.h"
+#include "taco/base/vocabulary.h"
+#include "taco/feature_structure.h"
+#include "taco/lexicon.h"
+
+namespace boost {
+namespace interprocess {
+class mapped_region;
+}
+}
+
+namespace taco {
+
+// A read-only lexicon that is used in place, from a file written by
+// BinaryLexiconWriter, instead of being parsed and built in memory.  The file
+// is memory-mapped, so opening it costs almost nothing however large the
+// lexicon and the pages are shared between processes that map the same file.
+//
+// The file holds the feature and value vocabularies, the words, a perfect
+// hash index from words to their entries, and the entries' feature
+// structures as a flat array of nodes.  The nodes are interned (see
+// FeatureStructureInterner) so values that occur in more than one entry are
+// stored once.  Lookup() builds FeatureStructure objects for a word's entries
+// on first use and keeps them, sharing nodes in the same way as the
+// interner, so the lexicon's feature structures must not be modified.
+//
+// The feature and value IDs in the feature structures are those of the
+// vocabularies that the file was written with.  A caller that parses other
+// feature structures or constraints should fill its vocabularies with
+// ReadVocabularies() first.
+//
+// Lookup() is not thread-safe, since it updates the cache of built feature
+// structures.
+class BinaryLexicon {
+ public:
+  typedef Lexicon<std::size_t>::MappedType MappedType;
+
+  static const std::size_t kNotFound = static_cast<std::size_t>(-1);
+
+  // Maps the named file.  Throws Exception if the file cannot be mapped or
+  // is not a valid binary lexicon.
+  explicit BinaryLexicon(const std::string &path);
+
+  // Uses a binary lexicon that has already been loaded or mapped by the
+  // caller.  The memory must be aligned to 8 bytes and must outlive the
+  // lexicon.  Throws Exception if it is not a valid binary lexicon.
+  BinaryLexicon(const char *data, std::size_t size);
+
+  ~BinaryLexicon();
+
+  // Returns the number of words.
+  std::size_t Size() const { return num_words_; }
+  bool IsEmpty() const { return num_words_ == 0; }
+
+  // Returns the number of entries (pairs of a word and a feature structure).
+  std::size_t NumEntries() const { return num_entries_; }
+
+  // Returns the number of distinct feature structure nodes.
+  std::size_t NumNodes() const { return num_nodes_; }
+
+  // Inserts the file's features and values into the vocabularies, in ID
+  // order, so that IDs in the two agree.  Throws Exception if a vocabulary
+  // already assigns a different ID to one of them.
+  void ReadVocabularies(Vocabulary &feature_set, Vocabulary &value_set) const;
+
+  // Returns the index of the word, between 0 and Size()-1, or kNotFound.
+  std::size_t Find(const StringPiece &) const;
+
+  // Returns the word with the given index.
+  StringPiece GetWord(std::size_t) const;
+
+  // Replaces the contents of the vector with the word's feature structures.
+  // Returns false (leaving the vector empty) if the word is not found.
+  bool Lookup(const StringPiece &, MappedType &) const;
+
+  // Looks up the word and then copies pointers to the feature structures
+  // that can be unified with the given feature structure to the output
+  // iterator, as Lexicon::Lookup does.  Returns true iff at least one
+  // unifiable value was found.
+  template<typename OutputIterator>
+  bool Lookup(const StringPiece &, const FeatureStructure &,
+              OutputIterator) const;
+
+ private:
+  friend class BinaryLexiconWriter;
+
+  // The sections of the file (see binary_lexicon.cc).
+  struct Header;
+  struct Node;
+  struct Arc;
+
+  typedef boost::unordered_map<boost::uint32_t,
+                               boost::shared_ptr<FeatureStructure> > NodeCache;
+
+  // Copying is not allowed
+  BinaryLexicon(const BinaryLexicon &);
+  BinaryLexicon &operator=(const BinaryLexicon &);
+
+  void Init(const char *, std::size_t);
+
+  // Returns the node with the given ID, building it if necessary.
+  boost::shared_ptr<FeatureStructure> GetNode(std::size_t) const;
+
+  boost::scoped_ptr<boost::interprocess::mapped_region> region_;
+  std::size_t num_words_;
+  std::size_t num_entries_;
+  std::size_t num_nodes_;
+  binary_format::StringPool features_;
+  binary_format::StringPool values_;
+  binary_format::StringPool words_;
+  binary_format::PerfectHash index_;
+  const boost::uint32_t *word_entries_;
+  const boost::uint32_t *entries_;
+  const Node *nodes_;
+  const Arc *arcs_;
+  // The nodes that have been built so far, by node ID.
+  mutable NodeCache node_cache_;
+};
+
+// Writes a lexicon in the binary format read by BinaryLexicon.
+class BinaryLexiconWriter {
+ public:
+  // The vocabularies are the ones used to load the lexicon: word IDs are
+  // looked up in the first, features in the second and atomic values in the
+  // third.
+  BinaryLexiconWriter(const Vocabulary &words, const Vocabulary &feature_set,
+                      const Vocabulary &value_set)
+      : words_(words)
+      , feature_set_(feature_set)
+      , value_set_(value_set) {}
+
+  // Writes the lexicon.  Throws Exception if the lexicon is too large for
+  // the format's 32-bit offsets.
+  void Write(const Lexicon<std::size_t> &, std::ostream &) const;
+
+ private:
+  const Vocabulary &words_;
+  const Vocabulary &feature_set_;
+  const Vocabulary &value_set_;
+};
+
+template<typename OutputIterator>
+bool BinaryLexicon::Lookup(const StringPiece &word, const FeatureStructure &x,
+                           OutputIterator result) const {
+  MappedType values;
+  if (!Lookup(word, values)) {
+    return false;
+  }
+  bool ret_val = false;
+  QuasiDestructiveUnifier unifier;
+  for (MappedType::const_iterator p = values.begin(); p != values.end(); ++p) {
+    if (unifier.IsUnifiable(x, **p)) {
+      ret_val = true;
+      *result++ = *p;
+    }
+  }
+  return ret_val;
+}
+
+}  // namespace taco
+
+#endif
@@ -0,0 +1,182 @@
+#include "taco/bitset_feature_structure.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace taco {
+
+namespace {
+
+const BitsetLayout::Word kOne = 1;
+
+}  // namespace
+
+const std::size_t BitsetLayout::kMaxFieldValues;
+
+const FeatureStructure *BitsetLayout::Bearer(const FeatureStructure &fs) {
+  const FeatureStructure *bearer = &fs;
+  while (bearer->forward_) {
+    bearer = bearer->forward_.get();
+  }
+  return bearer;
+}
+
+bool BitsetLayout::Encode(const FeatureStructure &fs,
+                          BitsetFeatureStructure &result) const {
+  result.words_ = ones_;
+  std::vector<const FeatureStructure *> visited;
+  return Encode(fs, 0, visited, result.words_);
+}
+
+bool BitsetLayout::IsUnifiable(const BitsetFeatureStructure &a,
+                               const BitsetFeatureStructure &b) const {
+  assert(a.words_.size() == ones_.size());
+  assert(b.words_.size() == ones_.size());
+  for (std::size_t i = 0; i < ones_.size(); ++i) {
+    Word x = a.words_[i] & b.words_[i];
+    if (((x + ones_[i]) & guards_[i]) != guards_[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool BitsetLayout::Unify(BitsetFeatureStructure &a,
+                         const BitsetFeatureStructure &b) const {
+  assert(a.words_.size() == ones_.size());
+  assert(b.words_.size() == ones_.size());
+  for (std::size_t i = 0; i < ones_.size(); ++i) {
+    a.words_[i] &= b.words_[i];
+  }
+  return IsUnifiable(a.words_);
+}
+
+bool BitsetLayout::IsUnifiable(const std::vector<Word> &words) const {
+  for (std::size_t i = 0; i < ones_.size(); ++i) {
+    if (((words[i] + ones_[i]) & guards_[i]) != guards_[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void BitsetLayout::Collect(const FeatureStructure &fs, FeaturePath &path,
+                           AtomicPathMap &atomic_paths,
+                           std::set<FeaturePath> &complex_paths) const {
+  const internal::FSContent &content = Bearer(fs)->content_;
+  if (content.IsAtomic()) {
+    atomic_paths[path].insert(content.a);
+    return;
+  }
+  if (content.c.empty()) {
+    return;
+  }
+  complex_paths.insert(path);
+  for (internal::FSContent::Map::const_iterator p = content.c.begin();
+       p != content.c.end(); ++p) {
+    path.push_back(p->first);
+    Collect(*p->second, path, atomic_paths, complex_paths);
+    path.pop_back();
+  }
+}
+
+void BitsetLayout::Build(const AtomicPathMap &atomic_paths,
+                         const std::set<FeaturePath> &complex_paths) {
+  nodes_.resize(1);
+  std::size_t bit = 64;
+  for (AtomicPathMap::const_iterator p = atomic_paths.begin();
+       p != atomic_paths.end(); ++p) {
+    const FeaturePath &path = p->first;
+    const std::set<AtomicValue> &values = p->second;
+    if (values.size() > kMaxFieldValues || complex_paths.count(path)) {
+      continue;
+    }
+    // Allocate the field's bits plus a guard bit, starting a new word if
+    // necessary.
+    std::size_t width = values.size();
+    if (bit + width + 1 > 64) {
+      ones_.push_back(0);
+      guards_.push_back(0);
+      bit = 0;
+    }
+    Field field;
+    field.path = path;
+    field.values.assign(values.begin(), values.end());
+    field.word = ones_.size() - 1;
+    field.shift = bit;
+    ones_.back() |= ((kOne << width) - 1) << bit;
+    guards_.back() |= kOne << (bit + width);
+    bit += width + 1;
+    // Add the path to the prefix tree.
+    int node = 0;
+    for (FeaturePath::const_iterator q = path.begin(); q != path.end(); ++q) {
+      boost::container::flat_map<Feature, int>::iterator r =
+          nodes_[node].children.find(*q);
+      if (r == nodes_[node].children.end()) {
+        int child = nodes_.size();
+        nodes_[node].children.insert(std::make_pair(*q, child));
+        nodes_.push_back(Node());
+        node = child;
+      } else {
+        node = r->second;
+      }
+    }
+    nodes_[node].field = fields_.size();
+    fields_.push_back(field);
+  }
+}
+
+bool BitsetLayout::Encode(const FeatureStructure &fs, int node,
+                          std::vector<const FeatureStructure *> &visited,
+                          std::vector<Word> &words) const {
+  const FeatureStructure *bearer = Bearer(fs);
+  if (std::find(visited.begin(), visited.end(), bearer) != visited.end()) {
+    return false;  // Reentrancy.
+  }
+  visited.push_back(bearer);
+
+  const internal::FSContent &content = bearer->content_;
+  int field_index = (node < 0) ? -1 : nodes_[node].field;
+
+  if (content.IsAtomic()) {
+    if (field_index < 0) {
+      return false;
+    }
+    const Field &field = fields_[field_index];
+    std::vector<AtomicValue>::const_iterator p = std::lower_bound(
+        field.values.begin(), field.values.end(), content.a);
+    if (p == field.values.end() || *p != content.a) {
+      return false;
+    }
+    Word mask = ((kOne << field.values.size()) - 1) << field.shift;
+    Word bit = kOne << (field.shift + (p - field.values.begin()));
+    words[field.word] = (words[field.word] & ~mask) | bit;
+    return true;
+  }
+
+  if (content.c.empty()) {
+    return true;
+  }
+
+  if (field_index >= 0) {
+    return false;  // Non-empty complex value at an atomic path.
+  }
+
+  for (internal::FSContent::Map::const_iterator p = content.c.begin();
+       p != content.c.end(); ++p) {
+    int child = -1;
+    if (node >= 0) {
+      boost::container::flat_map<Feature, int>::const_iterator q =
+          nodes_[node].children.find(p->first);
+      if (q != nodes_[node].children.end()) {
+        child = q->second;
+      }
+    }
+    if (!Encode(*p->second, child, visited, words)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace taco
@@ -0,0 +1,133 @@
+#ifndef TACO_SRC_TACO_BITSET_FEATURE_STRUCTURE_H_
+#define TACO_SRC_TACO_BITSET_FEATURE_STRUCTURE_H_
+
+#include <cstddef>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <boost/container/flat_map.hpp>
+#include <boost/cstdint.hpp>
+
+#include "taco/base/basic_types.h"
+#include "taco/feature_path.h"
+#include "taco/feature_structure.h"
+
+namespace taco {
+
+// A compact encoding of a tree-shaped feature structure whose atomic values
+// all belong to small, closed inventories.  Each atomic-valued path is
+// represented by a field containing one bit per admissible value, so a value
+// that is specified is encoded as a single bit and a value that is missing
+// (or empty) is encoded as all ones.  Encodings are produced and interpreted
+// by a BitsetLayout.
+class BitsetFeatureStructure {
+ public:
+  typedef boost::uint64_t Word;
+
+  BitsetFeatureStructure() {}
+
+  const std::vector<Word> &words() const { return words_; }
+
+  bool operator==(const BitsetFeatureStructure &other) const {
+    return words_ == other.words_;
+  }
+
+ private:
+  friend class BitsetLayout;
+  std::vector<Word> words_;
+};
+
+// Assigns bit fields to the atomic-valued paths of a collection of feature
+// structures, such as the values of a lexicon.  A path is given a field if
+// it is never used for a non-empty complex value and if it has no more than
+// kMaxFieldValues distinct values.
+//
+// Two encoded feature structures are unifiable iff the bitwise AND of their
+// encodings has at least one bit set in every field.  To make that test
+// cheap, each field is followed by an unused guard bit and fields never span
+// two words: adding a word containing all ones in each field carries into
+// the guard bit iff the field is non-zero.
+//
+// A feature structure can only be encoded if it contains no reentrancy and if
+// every atomic value occurs at a field's path and belongs to its inventory.
+// Otherwise Encode() returns false and the caller must fall back to the
+// general FeatureStructure operations.
+class BitsetLayout {
+ public:
+  typedef BitsetFeatureStructure::Word Word;
+
+  static const std::size_t kMaxFieldValues = 32;
+
+  // Constructs a layout covering the feature structures in the range
+  // [first,last), which must contain pointers (or smart pointers) to
+  // FeatureStructure objects.
+  template<typename InputIterator>
+  BitsetLayout(InputIterator first, InputIterator last);
+
+  std::size_t NumFields() const { return fields_.size(); }
+  std::size_t NumWords() const { return ones_.size(); }
+
+  // Encodes the feature structure.  Returns false if it cannot be encoded
+  // under this layout.
+  bool Encode(const FeatureStructure &, BitsetFeatureStructure &) const;
+
+  // Tests whether the feature structures encoded by the arguments are
+  // unifiable.
+  bool IsUnifiable(const BitsetFeatureStructure &,
+                   const BitsetFeatureStructure &) const;
+
+  // Unifies the second encoding into the first.  Returns false if
+  // unification fails (in which case the first encoding is left in an
+  // undefined state).
+  bool Unify(BitsetFeatureStructure &, const BitsetFeatureStructure &) const;
+
+ private:
+  struct Field {
+    FeaturePath path;
+    std::vector<AtomicValue> values;  // Sorted.
+    std::size_t word;
+    unsigned int shift;
+  };
+
+  // A node in the prefix tree of field paths.
+  struct Node {
+    Node() : field(-1) {}
+    boost::container::flat_map<Feature, int> children;
+    int field;
+  };
+
+  typedef std::map<FeaturePath, std::set<AtomicValue> > AtomicPathMap;
+
+  // Follows forward pointers without compressing them, so that shared
+  // feature structures are not modified.
+  static const FeatureStructure *Bearer(const FeatureStructure &);
+
+  void Collect(const FeatureStructure &, FeaturePath &, AtomicPathMap &,
+               std::set<FeaturePath> &) const;
+  void Build(const AtomicPathMap &, const std::set<FeaturePath> &);
+  bool Encode(const FeatureStructure &, int,
+              std::vector<const FeatureStructure *> &,
+              std::vector<Word> &) const;
+  bool IsUnifiable(const std::vector<Word> &) const;
+
+  std::vector<Field> fields_;
+  std::vector<Node> nodes_;
+  std::vector<Word> ones_;    // All bits of every field.
+  std::vector<Word> guards_;  // The guard bit of every field.
+};
+
+template<typename InputIterator>
+BitsetLayout::BitsetLayout(InputIterator first, InputIterator last) {
+  AtomicPathMap atomic_paths;
+  std::set<FeaturePath> complex_paths;
+  FeaturePath path;
+  for (; first != last; ++first) {
+    Collect(**first, path, atomic_paths, complex_paths);
+  }
+  Build(atomic_paths, complex_paths);
+}
+
+}  // namespace taco
+
+#endif
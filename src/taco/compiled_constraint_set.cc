@@ -0,0 +1,97 @@
+#include "taco/compiled_constraint_set.h"
+
+#include <set>
+
+namespace taco {
+
+CompiledConstraintSet::CompiledConstraintSet(const ConstraintSet &cs)
+    : constraint_set_(cs) {
+  NodeMap node_map;
+
+  // The instruction order must match Interpretation::Eval(const
+  // ConstraintSet &) since evaluation of one constraint can affect the
+  // outcome of the next (for example, a relative constraint can give a value
+  // to a path that is later tested by an absolute constraint).
+  for (RelConstraintSet::ConstIterator p = cs.rel_set().Begin();
+       p != cs.rel_set().End(); ++p) {
+    const RelConstraint &constraint = **p;
+    Instruction instruction;
+    instruction.opcode = kRel;
+    instruction.lhs = AddPath(constraint.lhs.index(), constraint.lhs.path(),
+                              node_map);
+    instruction.rhs = AddPath(constraint.rhs.index(), constraint.rhs.path(),
+                              node_map);
+    instruction.value = kNullAtom;
+    instruction.var = 0;
+    program_.push_back(instruction);
+  }
+  for (AbsConstraintSet::ConstIterator p = cs.abs_set().Begin();
+       p != cs.abs_set().End(); ++p) {
+    const AbsConstraint &constraint = **p;
+    Instruction instruction;
+    instruction.opcode = kAbs;
+    instruction.lhs = AddPath(constraint.lhs.index(), constraint.lhs.path(),
+                              node_map);
+    instruction.rhs = -1;
+    instruction.value = constraint.rhs.value();
+    instruction.var = 0;
+    program_.push_back(instruction);
+  }
+  for (VarConstraintSet::ConstIterator p = cs.var_set().Begin();
+       p != cs.var_set().End(); ++p) {
+    const VarConstraint &constraint = **p;
+    Instruction instruction;
+    instruction.opcode = kVar;
+    instruction.lhs = AddPath(constraint.lhs.index(), constraint.lhs.path(),
+                              node_map);
+    instruction.rhs = -1;
+    instruction.value = kNullAtom;
+    instruction.var = &constraint.rhs;
+    program_.push_back(instruction);
+  }
+
+  std::set<int> indices;
+  cs.GetIndices(indices);
+  for (std::set<int>::const_iterator p = indices.begin(); p != indices.end();
+       ++p) {
+    cs.GetModifiablePaths(*p, modifiable_paths_[*p]);
+  }
+}
+
+const FeatureTree &CompiledConstraintSet::GetModifiablePaths(int index) const {
+  std::map<int, FeatureTree>::const_iterator p = modifiable_paths_.find(index);
+  return p == modifiable_paths_.end() ? empty_tree_ : p->second;
+}
+
+int CompiledConstraintSet::AddPath(int index, const FeaturePath &path,
+                                   NodeMap &node_map) {
+  FeaturePath prefix;
+  int parent = -1;
+  int root = -1;
+  // Find or add the node for each prefix of the path, starting with the
+  // empty prefix (the root).
+  for (std::size_t i = 0; i <= path.size(); ++i) {
+    if (i > 0) {
+      prefix.push_back(path[i-1]);
+    }
+    std::pair<NodeMap::iterator, bool> result = node_map.insert(
+        std::make_pair(std::make_pair(index, prefix), 0));
+    if (result.second) {
+      PathNode node;
+      node.root = (i == 0) ? static_cast<int>(nodes_.size()) : root;
+      node.parent = parent;
+      node.index = index;
+      node.feature = (i == 0) ? Feature() : path[i-1];
+      node.path = prefix;
+      result.first->second = nodes_.size();
+      nodes_.push_back(node);
+    }
+    parent = result.first->second;
+    if (i == 0) {
+      root = parent;
+    }
+  }
+  return parent;
+}
+
+}  // namespace taco
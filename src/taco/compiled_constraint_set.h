@@ -0,0 +1,86 @@
+#ifndef TACO_SRC_TACO_COMPILED_CONSTRAINT_SET_H_
+#define TACO_SRC_TACO_COMPILED_CONSTRAINT_SET_H_
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "taco/base/basic_types.h"
+#include "taco/constraint.h"
+#include "taco/constraint_set.h"
+#include "taco/feature_path.h"
+#include "taco/feature_tree.h"
+
+namespace taco {
+
+class Interpretation;
+
+// A ConstraintSet that has been translated into a form that is cheaper to
+// evaluate repeatedly.  Compilation gathers the feature paths used by the
+// constraints into a prefix tree (one per index) and translates each
+// constraint into an instruction that refers to its paths by node number.
+// During evaluation (see Interpretation::Eval(const CompiledConstraintSet &))
+// the value found at each node is remembered, so a prefix shared by several
+// constraints, such as <0 AGR> in <0 AGR NUM> and <0 AGR PERS>, is walked
+// once per interpretation instead of once per constraint.
+//
+// The modifiable paths of each index (see ConstraintSet::GetModifiablePaths)
+// are also computed once, at compile time.
+//
+// The instructions are evaluated in the same order as the constraints in
+// Interpretation::Eval(const ConstraintSet &), with the same results.
+class CompiledConstraintSet {
+ public:
+  // The ConstraintSet is not copied, so it must outlive the compiled set.
+  explicit CompiledConstraintSet(const ConstraintSet &);
+
+  const ConstraintSet &constraint_set() const { return constraint_set_; }
+
+  // Returns a FeatureTree equivalent to the one built by
+  // ConstraintSet::GetModifiablePaths for the given index.
+  const FeatureTree &GetModifiablePaths(int) const;
+
+  std::size_t NumInstructions() const { return program_.size(); }
+  std::size_t NumPathNodes() const { return nodes_.size(); }
+
+ private:
+  friend class Interpretation;
+
+  enum Opcode {
+    kRel,
+    kAbs,
+    kVar,
+  };
+
+  struct Instruction {
+    Opcode opcode;
+    int lhs;                 // Path node of the left-hand side.
+    int rhs;                 // Path node of the right-hand side (kRel only).
+    AtomicValue value;       // kAbs only.
+    const VarTerm *var;      // kVar only.
+  };
+
+  // A node in the prefix tree of feature paths.  A root node represents the
+  // feature structure with the given index (and has an empty path).
+  struct PathNode {
+    int root;
+    int parent;              // -1 for a root node.
+    int index;
+    Feature feature;         // Undefined for a root node.
+    FeaturePath path;        // The path from the root.
+  };
+
+  typedef std::map<std::pair<int, FeaturePath>, int> NodeMap;
+
+  int AddPath(int, const FeaturePath &, NodeMap &);
+
+  const ConstraintSet &constraint_set_;
+  std::vector<Instruction> program_;
+  std::vector<PathNode> nodes_;
+  std::map<int, FeatureTree> modifiable_paths_;
+  FeatureTree empty_tree_;
+};
+
+}  // namespace taco
+
+#endif
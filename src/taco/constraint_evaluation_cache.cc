@@ -0,0 +1,134 @@
+#include "taco/constraint_evaluation_cache.h"
+
+#include <cstring>
+#include <iterator>
+#include <set>
+
+#include <boost/functional/hash.hpp>
+
+#include "taco/compiled_constraint_set.h"
+#include "taco/constraint_evaluator.h"
+#include "taco/constraint_set.h"
+#include "taco/option_table.h"
+
+namespace taco {
+
+std::size_t ConstraintEvaluationCache::KeyHasher::operator()(
+    const Key *key) const {
+  std::size_t seed = boost::hash_range(key->signature.begin(),
+                                       key->signature.end());
+  boost::hash_combine(seed, key->constraint_set_id);
+  return seed;
+}
+
+bool ConstraintEvaluationCache::Eval(const ConstraintEvaluator &evaluator,
+                                     std::size_t constraint_set_id,
+                                     const std::vector<Interpretation> &prev,
+                                     const OptionTable &table,
+                                     const CompiledConstraintSet &compiled,
+                                     std::vector<Interpretation> &results) {
+  Key key;
+  key.constraint_set_id = constraint_set_id;
+  MakeSignature(prev, table, compiled, key.signature);
+
+  Index::iterator p = index_.find(&key);
+  if (p != index_.end()) {
+    ++num_hits_;
+    // Move the entry to the front.
+    entries_.splice(entries_.begin(), entries_, p->second);
+    results = p->second->results;
+    return p->second->success;
+  }
+
+  ++num_misses_;
+  bool success = evaluator.Eval(prev, table, compiled, results);
+  if (capacity_ == 0) {
+    return success;
+  }
+  if (index_.size() >= capacity_) {
+    index_.erase(&entries_.back().key);
+    entries_.pop_back();
+  }
+  entries_.push_front(Entry());
+  Entry &entry = entries_.front();
+  entry.key.constraint_set_id = constraint_set_id;
+  entry.key.signature.swap(key.signature);
+  entry.success = success;
+  entry.results = results;
+  index_.insert(std::make_pair(&entry.key, entries_.begin()));
+  return success;
+}
+
+void ConstraintEvaluationCache::Clear() {
+  index_.clear();
+  entries_.clear();
+}
+
+void ConstraintEvaluationCache::MakeSignature(
+    const std::vector<Interpretation> &prev,
+    const OptionTable &table,
+    const CompiledConstraintSet &compiled,
+    ProjectionEncoder::Encoding &signature) {
+  const ConstraintSet &constraint_set = compiled.constraint_set();
+
+  // An option on an index that the interpretations already cover is unified
+  // with the earlier value at the root, so the whole of both values can
+  // decide the outcome.  They are encoded in full.
+  std::set<int> covered;
+  for (std::vector<Interpretation>::const_iterator p = prev.begin();
+       p != prev.end(); ++p) {
+    for (Interpretation::const_iterator q = p->begin(); q != p->end(); ++q) {
+      covered.insert(q->first);
+    }
+  }
+  std::set<int> full;
+  for (OptionTable::const_iterator p = table.begin(); p != table.end(); ++p) {
+    if (covered.count(p->first)) {
+      full.insert(p->first);
+    }
+  }
+  const FeatureTree whole;
+
+  encoder_.Reset();
+  encoder_.AddLabel(prev.size());
+  for (std::vector<Interpretation>::const_iterator p = prev.begin();
+       p != prev.end(); ++p) {
+    // The probability affects the pruning of the results as well as their
+    // probabilities.
+    float probability = p->probability();
+    boost::uint32_t bits;
+    std::memcpy(&bits, &probability, sizeof(bits));
+    encoder_.AddLabel(bits);
+    encoder_.AddLabel(std::distance(p->begin(), p->end()));
+    for (Interpretation::const_iterator q = p->begin(); q != p->end(); ++q) {
+      encoder_.AddLabel(q->first);
+      if (full.count(q->first)) {
+        encoder_.Add(*q->second, whole);
+      } else if (constraint_set.ContainsIndex(q->first)) {
+        encoder_.Add(*q->second, compiled.GetModifiablePaths(q->first));
+      }
+    }
+  }
+
+  // The options of an unconstrained column on a new index are only counted,
+  // since that is all that evaluation depends on.
+  encoder_.AddLabel(table.Size());
+  for (OptionTable::const_iterator p = table.begin(); p != table.end(); ++p) {
+    const OptionColumn &col = p->second;
+    encoder_.AddLabel(p->first);
+    encoder_.AddLabel(col.Size());
+    const bool in_full = full.count(p->first) > 0;
+    if (!in_full && !constraint_set.ContainsIndex(p->first)) {
+      continue;
+    }
+    const FeatureTree &tree =
+        in_full ? whole : compiled.GetModifiablePaths(p->first);
+    for (OptionColumn::const_iterator q = col.begin(); q != col.end(); ++q) {
+      encoder_.Add(**q, tree);
+    }
+  }
+
+  signature = encoder_.encoding();
+}
+
+}  // namespace taco
@@ -0,0 +1,121 @@
+#ifndef TACO_SRC_TACO_CONSTRAINT_EVALUATION_CACHE_H_
+#define TACO_SRC_TACO_CONSTRAINT_EVALUATION_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+#include "taco/feature_structure.h"
+#include "taco/interpretation.h"
+
+namespace taco {
+
+class CompiledConstraintSet;
+class ConstraintEvaluator;
+class OptionTable;
+
+// Memoizes the third form of ConstraintEvaluator::Eval, which extends a set of
+// interpretations with the columns of an option table.  In chart decoding the
+// same child hypotheses are combined under the same rule many times, so the
+// same evaluation recurs.
+//
+// An evaluation is identified by a caller-supplied constraint set ID (which
+// must uniquely identify the compiled constraint set) and a signature of the
+// inputs: the probabilities of the interpretations and the values of their
+// feature structures and of the options, projected onto the paths that the
+// constraints can read or modify (see ProjectionEncoder).  The exception is
+// an index that both the interpretations and the option table cover: there
+// the options are unified with the earlier values in full, so both are
+// encoded in full.  Evaluations that differ only in the other values share
+// an entry.  Consequently, on a hit the returned interpretations agree with
+// the ones that evaluation would return in their order, probabilities and
+// values at the constrained paths, but their other values (and those of the
+// unconstrained indices) come from the inputs of the evaluation that created
+// the entry.
+//
+// The cache holds at most a given number of entries, discarding the least
+// recently used entry when it is full.  The cached interpretations share
+// feature structures with those returned by Eval, so neither may be modified.
+// The evaluator's settings should not change while the cache is in use
+// (otherwise the cache should be cleared).
+class ConstraintEvaluationCache {
+ public:
+  explicit ConstraintEvaluationCache(std::size_t capacity)
+      : capacity_(capacity)
+      , num_hits_(0)
+      , num_misses_(0) {}
+
+  // Returns the result of evaluator.Eval(prev, table, compiled, results),
+  // from the cache if possible.
+  bool Eval(const ConstraintEvaluator &evaluator,
+            std::size_t constraint_set_id,
+            const std::vector<Interpretation> &prev,
+            const OptionTable &table,
+            const CompiledConstraintSet &compiled,
+            std::vector<Interpretation> &results);
+
+  std::size_t Size() const { return index_.size(); }
+  std::size_t Capacity() const { return capacity_; }
+
+  // Returns the number of calls to Eval that were answered from the cache
+  // and the number that were not.
+  std::size_t NumHits() const { return num_hits_; }
+  std::size_t NumMisses() const { return num_misses_; }
+
+  // Discards all entries (but not the counts).
+  void Clear();
+
+  // Resets the hit and miss counts to zero.
+  void ResetCounts() { num_hits_ = num_misses_ = 0; }
+
+ private:
+  struct Key {
+    std::size_t constraint_set_id;
+    ProjectionEncoder::Encoding signature;
+  };
+
+  struct Entry {
+    Key key;
+    bool success;
+    std::vector<Interpretation> results;
+  };
+
+  typedef std::list<Entry> EntryList;
+
+  struct KeyHasher {
+    std::size_t operator()(const Key *) const;
+  };
+
+  struct KeyEqualityPred {
+    bool operator()(const Key *a, const Key *b) const {
+      return a->constraint_set_id == b->constraint_set_id &&
+             a->signature == b->signature;
+    }
+  };
+
+  // Maps the key of each entry to the entry's position in entries_.
+  typedef boost::unordered_map<const Key *, EntryList::iterator, KeyHasher,
+                               KeyEqualityPred> Index;
+
+  // Copying is not allowed
+  ConstraintEvaluationCache(const ConstraintEvaluationCache &);
+  ConstraintEvaluationCache &operator=(const ConstraintEvaluationCache &);
+
+  void MakeSignature(const std::vector<Interpretation> &, const OptionTable &,
+                     const CompiledConstraintSet &,
+                     ProjectionEncoder::Encoding &);
+
+  std::size_t capacity_;
+  // Entries in order of use, most recent first.
+  EntryList entries_;
+  Index index_;
+  ProjectionEncoder encoder_;
+  std::size_t num_hits_;
+  std::size_t num_misses_;
+};
+
+}  // namespace taco
+
+#endif
@@ -1,82 +1,894 @@
 #include "taco/constraint_evaluator.h"
 
+#include <time.h>
+
 #include <algorithm>
+#include <map>
+#include <set>
+#include <utility>
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
 
+#include "taco/base/thread_pool.h"
+#include "taco/bitset_feature_structure.h"
+#include "taco/compiled_constraint_set.h"
+#include "taco/constraint_evaluator_stats.h"
 #include "taco/constraint_set.h"
+#include "taco/constraint_set_set.h"
 #include "taco/interpretation.h"
 #include "taco/option_table.h"
 
 namespace taco {
 
+namespace {
+
+struct HigherProbability {
+  bool operator()(const Interpretation &a, const Interpretation &b) const {
+    return a.probability() > b.probability();
+  }
+};
+
+// The smallest number of candidates that a parallel column step hands to a
+// thread at a time, and the number of chunks per thread that it aims for
+// (so that a thread that draws cheap candidates can take over chunks from
+// the others).
+const std::size_t kMinChunkSize = 16;
+const std::size_t kChunksPerThread = 8;
+
+// Returns the time in seconds on a monotonic wall clock.  Wall time is used
+// rather than processor time because std::clock() counts every thread of
+// the process, which the concurrent evaluations of EvalBatch would count
+// several times over.
+double Now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+double Seconds(double start) {
+  return Now() - start;
+}
+
+// Records the number of interpretations remaining after a column step.
+void RecordResults(ConstraintEvaluatorStats &stats, std::size_t step,
+                   std::size_t size) {
+  if (stats.max_results.size() <= step) {
+    stats.max_results.resize(step + 1, 0);
+  }
+  stats.max_results[step] = std::max(stats.max_results[step], size);
+}
+
+// Shorten the forward chains of feature structures that are about to be read
+// by several threads, so that the threads only read them.
+void DechainAll(const std::vector<Interpretation> &results) {
+  for (std::vector<Interpretation>::const_iterator r = results.begin();
+       r != results.end(); ++r) {
+    for (Interpretation::const_iterator p = r->begin(); p != r->end(); ++p) {
+      p->second->DechainAll();
+    }
+  }
+}
+
+void DechainAll(const OptionColumn &col) {
+  for (OptionColumn::const_iterator q = col.begin(); q != col.end(); ++q) {
+    (*q)->DechainAll();
+  }
+}
+
+// Returns true if every constraint in b is also in a.
+bool Includes(const ConstraintSet &a, const ConstraintSet &b) {
+  return std::includes(a.abs_set().Begin(), a.abs_set().End(),
+                       b.abs_set().Begin(), b.abs_set().End(),
+                       AbsConstraintSet::KeyOrderer()) &&
+         std::includes(a.rel_set().Begin(), a.rel_set().End(),
+                       b.rel_set().Begin(), b.rel_set().End(),
+                       RelConstraintSet::KeyOrderer()) &&
+         std::includes(a.var_set().Begin(), a.var_set().End(),
+                       b.var_set().Begin(), b.var_set().End(),
+                       VarConstraintSet::KeyOrderer());
+}
+
+}  // namespace
+
+// Tests candidate interpretations against the relational constraints that
+// equate values at the evaluator's bitset path, using encoded values.  The
+// values of the options and of the previous interpretations are encoded once
+// per column, so each test is a handful of bitwise operations.
+class ConstraintEvaluator::BitsetFilter {
+ public:
+  BitsetFilter(const BitsetLayout *layout, const FeaturePath &path)
+      : layout_(layout)
+      , path_(path) {}
+
+  // Prepares to test the candidates that extend the given interpretations
+  // with the options from the column at the given index.
+  void Prepare(const ConstraintSet &, const std::vector<Interpretation> &,
+               size_t, const OptionColumn &);
+
+  // Returns false if extending the r-th interpretation with the q-th option
+  // is certain to violate the constraints.
+  bool Check(std::size_t r, std::size_t q) const {
+    if (other_indices_.empty() || !option_valid_[q]) {
+      return true;
+    }
+    std::size_t k = r * other_indices_.size();
+    for (std::size_t i = 0; i < other_indices_.size(); ++i, ++k) {
+      if (result_valid_[k] &&
+          !layout_->IsUnifiable(option_bits_[q], result_bits_[k])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  bool Encode(boost::shared_ptr<const FeatureStructure>,
+              BitsetFeatureStructure &) const;
+
+  const BitsetLayout *layout_;
+  const FeaturePath &path_;
+  std::vector<int> other_indices_;
+  std::vector<BitsetFeatureStructure> option_bits_;
+  std::vector<char> option_valid_;
+  std::vector<BitsetFeatureStructure> result_bits_;
+  std::vector<char> result_valid_;
+};
+
+void ConstraintEvaluator::BitsetFilter::Prepare(
+    const ConstraintSet &constraint_set,
+    const std::vector<Interpretation> &results,
+    size_t index,
+    const OptionColumn &col) {
+  other_indices_.clear();
+  if (!layout_) {
+    return;
+  }
+  for (RelConstraintSet::ConstIterator p = constraint_set.rel_set().Begin();
+       p != constraint_set.rel_set().End(); ++p) {
+    const RelConstraint &constraint = **p;
+    if (constraint.lhs.path() != path_ || constraint.rhs.path() != path_) {
+      continue;
+    }
+    int other;
+    if (constraint.lhs.index() == static_cast<int>(index)) {
+      other = constraint.rhs.index();
+    } else if (constraint.rhs.index() == static_cast<int>(index)) {
+      other = constraint.lhs.index();
+    } else {
+      continue;
+    }
+    if (other != static_cast<int>(index) &&
+        std::find(other_indices_.begin(), other_indices_.end(), other) ==
+            other_indices_.end()) {
+      other_indices_.push_back(other);
+    }
+  }
+  if (other_indices_.empty()) {
+    return;
+  }
+
+  option_bits_.resize(col.Size());
+  option_valid_.resize(col.Size());
+  std::size_t i = 0;
+  for (OptionColumn::const_iterator q = col.begin(); q != col.end(); ++q) {
+    option_valid_[i] = Encode(*q, option_bits_[i]);
+    ++i;
+  }
+
+  result_bits_.resize(results.size() * other_indices_.size());
+  result_valid_.resize(result_bits_.size());
+  i = 0;
+  for (std::vector<Interpretation>::const_iterator r = results.begin();
+       r != results.end(); ++r) {
+    for (std::vector<int>::const_iterator k = other_indices_.begin();
+         k != other_indices_.end(); ++k) {
+      result_valid_[i] = Encode(r->GetFS(*k), result_bits_[i]);
+      ++i;
+    }
+  }
+}
+
+bool ConstraintEvaluator::BitsetFilter::Encode(
+    boost::shared_ptr<const FeatureStructure> root,
+    BitsetFeatureStructure &bits) const {
+  if (!root) {
+    return false;
+  }
+  const FeatureStructure *value = root.get();
+  if (!path_.empty()) {
+    value = root->Find(path_.begin(), path_.end());
+    if (!value) {
+      // Full evaluation will create an empty value, which is unconstrained.
+      return false;
+    }
+  }
+  return layout_->Encode(*value, bits);
+}
+
+// The atomic values found at feature paths in the options of a column, for
+// use by ColumnFilter.  For each path, the values are extracted from all of
+// the options into a dense array the first time that the path is requested,
+// so each option's paths are walked once per column however many constraint
+// sets are evaluated against the column.  Once every path that will be
+// requested has been extracted, Get() only reads, so the object can be
+// shared between threads.
+class ConstraintEvaluator::ColumnValues {
+ public:
+  struct Entry {
+    // kNullAtom indicates a missing, empty or complex value.
+    std::vector<AtomicValue> values;
+    // Non-zero if the value is complex and non-empty.
+    std::vector<unsigned char> complex;
+  };
+
+  const Entry &Get(const FeaturePath &, const OptionColumn &);
+
+ private:
+  std::map<FeaturePath, Entry> entries_;
+};
+
+const ConstraintEvaluator::ColumnValues::Entry &
+ConstraintEvaluator::ColumnValues::Get(const FeaturePath &path,
+                                       const OptionColumn &col) {
+  std::map<FeaturePath, Entry>::iterator p = entries_.find(path);
+  if (p != entries_.end()) {
+    return p->second;
+  }
+  assert(!path.empty());
+  const std::size_t size = col.Size();
+  Entry &entry = entries_[path];
+  entry.values.assign(size, kNullAtom);
+  entry.complex.assign(size, 0);
+  std::size_t q = 0;
+  for (OptionColumn::const_iterator r = col.begin(); r != col.end();
+       ++r, ++q) {
+    const FeatureStructure *value = (*r)->Find(path.begin(), path.end());
+    if (!value || value->IsEmpty()) {
+      continue;
+    }
+    if (value->IsAtomic()) {
+      entry.values[q] = value->GetAtomicValue();
+    } else {
+      entry.complex[q] = 1;
+    }
+  }
+  return entry;
+}
+
+// Applies the checks of PotentialInterpretation::QuickCheckOption() to every
+// option in a column at once.  The constraints are tested by simple loops
+// over the arrays of a ColumnValues object (which the compiler can
+// vectorize) instead of walking each option's paths once per candidate
+// interpretation.
+class ConstraintEvaluator::ColumnFilter {
+ public:
+  // Prepares the filter for a column.  If the final argument is non-null
+  // then the rejected options are counted.
+  void Prepare(const ConstraintSet &, size_t, const OptionColumn &,
+               ColumnValues &, ConstraintEvaluatorStats *);
+
+  // Returns false if the q-th option is certain to violate the constraints.
+  bool Check(std::size_t q) const { return pass_[q]; }
+
+  // Returns the number of options for which Check() returns true.
+  std::size_t NumPassed() const {
+    return std::count(pass_.begin(), pass_.end(), 1);
+  }
+
+ private:
+  std::vector<unsigned char> pass_;
+};
+
+void ConstraintEvaluator::ColumnFilter::Prepare(
+    const ConstraintSet &constraint_set,
+    size_t index,
+    const OptionColumn &col,
+    ColumnValues &column_values,
+    ConstraintEvaluatorStats *stats) {
+  const std::size_t size = col.Size();
+  pass_.assign(size, 1);
+  if (size == 0) {
+    return;
+  }
+
+  // A non-empty complex value violates any absolute or variable constraint.
+  for (AbsConstraintSet::ConstIterator p = constraint_set.abs_set().Begin();
+       p != constraint_set.abs_set().End(); ++p) {
+    const AbsConstraint &constraint = **p;
+    if (constraint.lhs.index() != static_cast<int>(index)) {
+      continue;
+    }
+    const ColumnValues::Entry &entry =
+        column_values.Get(constraint.lhs.path(), col);
+    const AtomicValue *values = &entry.values[0];
+    const unsigned char *complex = &entry.complex[0];
+    const AtomicValue atom = constraint.rhs.value();
+    unsigned char *pass = &pass_[0];
+    for (std::size_t q = 0; q < size; ++q) {
+      pass[q] &= ((values[q] == atom) | (values[q] == kNullAtom)) &
+                 (complex[q] ^ 1);
+    }
+  }
+
+  std::size_t num_passed = 0;
+  if (stats) {
+    num_passed = NumPassed();
+    stats->num_abs_rejections += size - num_passed;
+  }
+
+  for (VarConstraintSet::ConstIterator p = constraint_set.var_set().Begin();
+       p != constraint_set.var_set().End(); ++p) {
+    const VarConstraint &constraint = **p;
+    if (constraint.lhs.index() != static_cast<int>(index)) {
+      continue;
+    }
+    const ColumnValues::Entry &entry =
+        column_values.Get(constraint.lhs.path(), col);
+    const VarTerm::ProbabilityMap &prob_map = constraint.rhs.probabilities();
+    for (std::size_t q = 0; q < size; ++q) {
+      if (entry.complex[q] || (entry.values[q] != kNullAtom &&
+          prob_map.find(entry.values[q]) == prob_map.end())) {
+        pass_[q] = 0;
+      }
+    }
+  }
+
+  if (stats) {
+    stats->num_var_rejections += num_passed - NumPassed();
+  }
+}
+
+// Chooses the order in which the columns of an option table are added to
+// the interpretations, in the manner of a query planner choosing a join order.
+// Every column is filtered up front, so evaluation fails immediately if any
+// column has no viable option.  Then, starting from the smallest column, each
+// step adds the smallest remaining column that shares a relative constraint
+// with the columns already covered, so the quick checks can prune candidates
+// before the next cross product is formed.  Columns that are unconnected to
+// the covered columns multiply the number of interpretations without pruning
+// any, so they are added only when no connected column remains.
+class ConstraintEvaluator::ColumnPlan {
+ public:
+  // Plans the evaluation of the option table's columns, given that the
+  // interpretations already cover the indices in the set.  Returns false if
+  // some column has no option that can satisfy the constraints.  If the
+  // final argument is non-null then it holds one ColumnValues object per
+  // column of the option table (in table order), which may be shared with
+  // other plans for the same table.  If stats are given then the options
+  // rejected by the column filters are counted.
+  bool Build(const OptionTable &, const ConstraintSet &, const std::set<int> &,
+             std::vector<ColumnValues> *, ConstraintEvaluatorStats *);
+
+  std::size_t Size() const { return order_.size(); }
+
+  // Returns the index, options, and filter of the i-th column in the plan.
+  std::size_t index(std::size_t i) const { return columns_[order_[i]]->first; }
+  const OptionColumn &column(std::size_t i) const {
+    return columns_[order_[i]]->second;
+  }
+  const ColumnFilter &filter(std::size_t i) const {
+    return filters_[order_[i]];
+  }
+
+  // Returns an upper bound on the factor by which the probability of an
+  // interpretation can change after the i-th column has been added: the
+  // product of the maximum probabilities of the variable constraints on the
+  // columns that are not yet covered, excluding those at the initial indices.
+  float RemainingMaxProbability(std::size_t i) const { return bounds_[i]; }
+
+ private:
+  static bool IsConnected(const ConstraintSet &, int, const std::set<int> &);
+
+  std::vector<OptionTable::const_iterator> columns_;
+  std::vector<ColumnFilter> filters_;
+  std::vector<ColumnValues> values_;
+  std::vector<std::size_t> order_;
+  std::vector<float> bounds_;
+};
+
+bool ConstraintEvaluator::ColumnPlan::Build(
+    const OptionTable &option_table,
+    const ConstraintSet &constraint_set,
+    const std::set<int> &initial,
+    std::vector<ColumnValues> *shared_values,
+    ConstraintEvaluatorStats *stats) {
+  columns_.clear();
+  order_.clear();
+  bounds_.clear();
+  for (OptionTable::const_iterator p = option_table.begin();
+       p != option_table.end(); ++p) {
+    columns_.push_back(p);
+  }
+  const std::size_t n = columns_.size();
+
+  std::vector<ColumnValues> &column_values =
+      shared_values ? *shared_values : values_;
+  if (!shared_values) {
+    values_.clear();
+    values_.resize(n);
+  }
+  assert(column_values.size() == n);
+
+  filters_.resize(n);
+  std::vector<std::size_t> sizes(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    filters_[i].Prepare(constraint_set, columns_[i]->first,
+                        columns_[i]->second, column_values[i], stats);
+    sizes[i] = filters_[i].NumPassed();
+    if (sizes[i] == 0) {
+      return false;
+    }
+  }
+
+  std::set<int> covered(initial);
+  std::vector<unsigned char> done(n, 0);
+  for (std::size_t step = 0; step < n; ++step) {
+    std::size_t best = n;
+    bool best_connected = false;
+    for (std::size_t i = 0; i < n; ++i) {
+      if (done[i]) {
+        continue;
+      }
+      bool connected = IsConnected(constraint_set, columns_[i]->first,
+                                   covered);
+      if (best == n || (connected && !best_connected) ||
+          (connected == best_connected && sizes[i] < sizes[best])) {
+        best = i;
+        best_connected = connected;
+      }
+    }
+    done[best] = 1;
+    order_.push_back(best);
+    covered.insert(columns_[best]->first);
+  }
+
+  // Compute the probability bounds, working backwards from the final column.
+  // The variable constraints on the initial indices are already scored into
+  // the interpretations' probabilities (using the maximum probability where
+  // there is no value yet), so adding an option there can only lower them.
+  bounds_.resize(n);
+  float bound = 1.0f;
+  for (std::size_t i = n; i-- > 0; ) {
+    bounds_[i] = bound;
+    int index = columns_[order_[i]]->first;
+    if (initial.count(index)) {
+      continue;
+    }
+    for (VarConstraintSet::ConstIterator p = constraint_set.var_set().Begin();
+         p != constraint_set.var_set().End(); ++p) {
+      if ((*p)->lhs.index() == index) {
+        bound *= (*p)->MaxProbability();
+      }
+    }
+  }
+  return true;
+}
+
+bool ConstraintEvaluator::ColumnPlan::IsConnected(
+    const ConstraintSet &constraint_set,
+    int index,
+    const std::set<int> &covered) {
+  for (RelConstraintSet::ConstIterator p = constraint_set.rel_set().Begin();
+       p != constraint_set.rel_set().End(); ++p) {
+    int lhs_index = (*p)->lhs.index();
+    int rhs_index = (*p)->rhs.index();
+    if ((lhs_index == index && rhs_index != index &&
+         covered.count(rhs_index)) ||
+        (rhs_index == index && lhs_index != index &&
+         covered.count(lhs_index))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Forms and evaluates the candidates of one column step: every pairing of an
+// option that passes the column filter with one of the previous
+// interpretations.  Candidate k pairs the (k / R)-th passing option with the
+// (k % R)-th interpretation, where R is the number of interpretations, so
+// concatenating the outputs of the chunks in order gives the same sequence
+// of interpretations regardless of how the chunks were shared out.
+class ConstraintEvaluator::ColumnJob : public ThreadPool::Job {
+ public:
+  typedef std::vector<boost::shared_ptr<QuasiDestructiveUnifier> > UnifierVec;
+
+  // If the final argument is non-null then each worker counts the work that
+  // it does (see MergeStats).
+  ColumnJob(const ColumnPlan &, std::size_t, const CompiledConstraintSet &,
+            const BitsetFilter &, const std::vector<Interpretation> &,
+            UnifierVec &, ConstraintEvaluatorStats *);
+
+  std::size_t NumCandidates() const {
+    return options_.size() * results_.size();
+  }
+
+  // Must be called before Run() with the chunk size that will be used.
+  void SetChunkSize(std::size_t);
+
+  void Run(std::size_t, std::size_t, std::size_t);
+
+  // Appends the new interpretations to the vector, in candidate order.
+  void Collect(std::vector<Interpretation> &) const;
+
+  // Adds the workers' counts to the stats given to the constructor.
+  void MergeStats();
+
+ private:
+  // Implements Run().  The counting is compiled out when kStats is false.
+  template<bool kStats>
+  void Run(std::size_t, std::size_t, QuasiDestructiveUnifier &,
+           ConstraintEvaluatorStats *);
+
+  const std::size_t index_;
+  const OptionColumn &col_;
+  const FeatureTree &tree_;
+  const CompiledConstraintSet &compiled_;
+  const BitsetFilter &filter_;
+  const std::vector<Interpretation> &results_;
+  UnifierVec &unifiers_;
+  std::vector<std::size_t> options_;
+  std::size_t chunk_size_;
+  std::vector<std::vector<Interpretation> > outputs_;
+  ConstraintEvaluatorStats *stats_;
+  std::vector<ConstraintEvaluatorStats> worker_stats_;
+};
+
+ConstraintEvaluator::ColumnJob::ColumnJob(
+    const ColumnPlan &plan,
+    std::size_t step,
+    const CompiledConstraintSet &compiled,
+    const BitsetFilter &filter,
+    const std::vector<Interpretation> &results,
+    UnifierVec &unifiers,
+    ConstraintEvaluatorStats *stats)
+    : index_(plan.index(step))
+    , col_(plan.column(step))
+    , tree_(compiled.GetModifiablePaths(index_))
+    , compiled_(compiled)
+    , filter_(filter)
+    , results_(results)
+    , unifiers_(unifiers)
+    , chunk_size_(1)
+    , stats_(stats) {
+  if (stats) {
+    worker_stats_.resize(unifiers.size());
+  }
+  const ColumnFilter &column_filter = plan.filter(step);
+  for (std::size_t qi = 0; qi < col_.Size(); ++qi) {
+    if (column_filter.Check(qi)) {
+      options_.push_back(qi);
+    }
+  }
+}
+
+void ConstraintEvaluator::ColumnJob::SetChunkSize(std::size_t chunk_size) {
+  chunk_size_ = chunk_size;
+  outputs_.clear();
+  outputs_.resize((NumCandidates() + chunk_size - 1) / chunk_size);
+}
+
+void ConstraintEvaluator::ColumnJob::Run(std::size_t begin, std::size_t end,
+                                         std::size_t worker) {
+  if (stats_) {
+    Run<true>(begin, end, *unifiers_[worker], &worker_stats_[worker]);
+  } else {
+    Run<false>(begin, end, *unifiers_[worker], 0);
+  }
+}
+
+template<bool kStats>
+void ConstraintEvaluator::ColumnJob::Run(std::size_t begin, std::size_t end,
+                                         QuasiDestructiveUnifier &unifier,
+                                         ConstraintEvaluatorStats *stats) {
+  const ConstraintSet &constraint_set = compiled_.constraint_set();
+  std::vector<Interpretation> &output = outputs_[begin / chunk_size_];
+  const std::size_t num_results = results_.size();
+  if (kStats) {
+    stats->num_candidates += end - begin;
+  }
+  for (std::size_t k = begin; k < end; ++k) {
+    std::size_t qi = options_[k / num_results];
+    std::size_t ri = k % num_results;
+    if (!filter_.Check(ri, qi)) {
+      if (kStats) {
+        ++stats->num_bitset_rejections;
+      }
+      continue;
+    }
+    boost::shared_ptr<const FeatureStructure> fs = *(col_.begin() + qi);
+    assert(fs);
+    PotentialInterpretation candidate(results_[ri], index_, fs);
+    if (kStats) {
+      ++stats->num_quick_unifications;
+    }
+    if (!candidate.QuickCheckRelations(constraint_set, unifier)) {
+      if (kStats) {
+        ++stats->num_rel_rejections;
+      }
+      continue;
+    }
+    Interpretation interpretation(candidate, tree_);
+    if (kStats) {
+      ++stats->num_clones;
+    }
+    // FIXME Is constraint evaluation necessary?
+    if (!interpretation.IsEmpty() && interpretation.Eval(compiled_)) {
+      output.push_back(interpretation);
+    } else if (kStats) {
+      ++stats->num_eval_failures;
+    }
+  }
+}
+
+void ConstraintEvaluator::ColumnJob::MergeStats() {
+  for (std::vector<ConstraintEvaluatorStats>::iterator p =
+       worker_stats_.begin(); p != worker_stats_.end(); ++p) {
+    stats_->Merge(*p);
+    p->Clear();
+  }
+}
+
+void ConstraintEvaluator::ColumnJob::Collect(
+    std::vector<Interpretation> &results) const {
+  for (std::vector<std::vector<Interpretation> >::const_iterator p =
+       outputs_.begin(); p != outputs_.end(); ++p) {
+    results.insert(results.end(), p->begin(), p->end());
+  }
+}
+
+// Evaluates the queries of EvalBatch, one per item.  If the queries share an
+// option table then they can also share its ColumnValues, provided that
+// every path has already been extracted.
+class ConstraintEvaluator::BatchJob : public ThreadPool::Job {
+ public:
+  // If the evaluator has stats then each worker counts its work separately
+  // until MergeStats() is called.
+  BatchJob(const ConstraintEvaluator &evaluator,
+           const std::vector<Query> &queries,
+           std::vector<ColumnValues> *column_values,
+           std::size_t num_workers,
+           std::vector<std::vector<Interpretation> > &results,
+           std::vector<char> &found)
+      : evaluator_(evaluator)
+      , queries_(queries)
+      , column_values_(column_values)
+      , results_(results)
+      , found_(found) {
+    if (evaluator.stats_) {
+      worker_stats_.resize(num_workers);
+    }
+  }
+
+  void Run(std::size_t begin, std::size_t end, std::size_t worker) {
+    for (std::size_t i = begin; i < end; ++i) {
+      Run(i, worker);
+    }
+  }
+
+  void Run(std::size_t i, std::size_t worker) {
+    CompiledConstraintSet compiled(*queries_[i].second);
+    ConstraintEvaluatorStats *stats =
+        worker_stats_.empty() ? 0 : &worker_stats_[worker];
+    found_[i] = evaluator_.Eval(*queries_[i].first, compiled, results_[i], 0,
+                                column_values_, stats);
+  }
+
+  void MergeStats() {
+    for (std::vector<ConstraintEvaluatorStats>::const_iterator p =
+         worker_stats_.begin(); p != worker_stats_.end(); ++p) {
+      evaluator_.stats_->Merge(*p);
+    }
+  }
+
+ private:
+  const ConstraintEvaluator &evaluator_;
+  const std::vector<Query> &queries_;
+  std::vector<ColumnValues> *column_values_;
+  std::vector<std::vector<Interpretation> > &results_;
+  std::vector<char> &found_;
+  std::vector<ConstraintEvaluatorStats> worker_stats_;
+};
+
+void ConstraintEvaluator::Prune(std::vector<Interpretation> &results,
+                                float remaining) const {
+  if (min_probability_ > 0.0f) {
+    std::vector<Interpretation>::iterator p = results.begin();
+    for (std::vector<Interpretation>::iterator q = results.begin();
+         q != results.end(); ++q) {
+      if (q->probability() * remaining >= min_probability_) {
+        if (p != q) {
+          *p = *q;
+        }
+        ++p;
+      }
+    }
+    results.erase(p, results.end());
+  }
+  if (beam_width_ > 0 && results.size() > beam_width_) {
+    std::nth_element(results.begin(), results.begin() + beam_width_,
+                     results.end(), HigherProbability());
+    results.erase(results.begin() + beam_width_, results.end());
+  }
+}
+
+void ConstraintEvaluator::Recombine(
+    const ColumnPlan &plan, std::size_t step,
+    const CompiledConstraintSet &compiled,
+    std::vector<Interpretation> &results) const {
+  if (!recombine_ || results.size() < 2) {
+    return;
+  }
+  const ConstraintSet &constraint_set = compiled.constraint_set();
+
+  // The options of a remaining column are unified with any existing value at
+  // that index at the root (which can only happen in the third form of Eval)
+  // so such values must be compared in full.
+  std::set<int> full;
+  for (std::size_t i = step + 1; i < plan.Size(); ++i) {
+    full.insert(plan.index(i));
+  }
+  const FeatureTree whole;
+
+  // Maps the encoding of each distinct state to its position in results.
+  typedef boost::unordered_map<ProjectionEncoder::Encoding, std::size_t,
+                               boost::hash<ProjectionEncoder::Encoding> >
+      StateMap;
+  StateMap states;
+  ProjectionEncoder encoder;
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    encoder.Reset();
+    for (Interpretation::const_iterator p = results[i].begin();
+         p != results[i].end(); ++p) {
+      if (full.count(p->first)) {
+        encoder.AddLabel(p->first);
+        encoder.Add(*p->second, whole);
+      } else if (constraint_set.ContainsIndex(p->first)) {
+        encoder.AddLabel(p->first);
+        encoder.Add(*p->second, compiled.GetModifiablePaths(p->first));
+      }
+    }
+    std::pair<StateMap::iterator, bool> result =
+        states.insert(std::make_pair(encoder.encoding(), n));
+    if (result.second) {
+      if (n != i) {
+        results[n] = results[i];
+      }
+      ++n;
+    } else if (results[i].probability() >
+               results[result.first->second].probability()) {
+      results[result.first->second] = results[i];
+    }
+  }
+  results.erase(results.begin() + n, results.end());
+}
+
+void ConstraintEvaluator::SetNumThreads(std::size_t num_threads) {
+  if (num_threads > 1) {
+    thread_pool_.reset(new ThreadPool(num_threads));
+  } else {
+    thread_pool_.reset();
+  }
+}
+
+void ConstraintEvaluator::SetBitsetLayout(
+    const FeaturePath &path,
+    boost::shared_ptr<const BitsetLayout> layout) {
+  bitset_path_ = path;
+  bitset_layout_ = layout;
+}
+
 bool ConstraintEvaluator::Eval(const OptionTable &option_table,
                                const ConstraintSet &constraint_set,
                                std::vector<Interpretation> &results) const {
+  return Eval(option_table, CompiledConstraintSet(constraint_set), results);
+}
+
+bool ConstraintEvaluator::Eval(const OptionTable &option_table,
+                               const CompiledConstraintSet &compiled,
+                               std::vector<Interpretation> &results) const {
+  return Eval(option_table, compiled, results, thread_pool_.get(), 0, stats_);
+}
+
+bool ConstraintEvaluator::Eval(const OptionTable &option_table,
+                               const CompiledConstraintSet &compiled,
+                               std::vector<Interpretation> &results,
+                               ThreadPool *thread_pool,
+                               std::vector<ColumnValues> *column_values,
+                               ConstraintEvaluatorStats *stats) const {
+  const ConstraintSet &constraint_set = compiled.constraint_set();
+
   results.clear();
 
-  OptionTable::const_iterator p = option_table.begin();
+  if (stats) {
+    ++stats->num_evals;
+  }
 
   // TODO What's the right thing to do here?
-  if (p == option_table.end()) {
+  if (option_table.IsEmpty()) {
     return true;
   }
 
+  double start = stats ? Now() : 0.0;
+  ColumnPlan plan;
+  bool ok = plan.Build(option_table, constraint_set, std::set<int>(),
+                       column_values, stats);
+  if (stats) {
+    stats->plan_seconds += Seconds(start);
+    start = Now();
+  }
+  if (!ok) {
+    if (stats) {
+      ++stats->num_plan_failures;
+    }
+    return false;
+  }
+
   // Create initial Interpretations, one for each feature structure option
-  // of the first rule element in option_table.
+  // of the first rule element in the plan.
   {
-    size_t index = p->first;
-    const OptionColumn &col = p->second;
+    size_t index = plan.index(0);
+    const OptionColumn &col = plan.column(0);
+    const ColumnFilter &column_filter = plan.filter(0);
+    const FeatureTree &tree = compiled.GetModifiablePaths(index);
     results.reserve(col.Size());
-    for (OptionColumn::const_iterator q = col.begin(); q != col.end(); ++q) {
+    std::size_t qi = 0;
+    for (OptionColumn::const_iterator q = col.begin(); q != col.end();
+         ++q, ++qi) {
       boost::shared_ptr<const FeatureStructure> fs = *q;
       assert(fs);
       assert(fs->IsComplex());
-      Interpretation interpretation(index, fs->Clone());
-      if (interpretation.Eval(constraint_set)) {
+      if (!column_filter.Check(qi)) {
+        continue;
+      }
+      Interpretation interpretation(index, fs->PartialClone(tree));
+      if (interpretation.Eval(compiled)) {
         results.push_back(interpretation);
+      } else if (stats) {
+        ++stats->num_eval_failures;
       }
     }
+    const std::size_t num_built = results.size();
+    if (stats) {
+      ++stats->num_columns;
+      stats->num_candidates += column_filter.NumPassed();
+      stats->num_clones += column_filter.NumPassed();
+    }
+    Recombine(plan, 0, compiled, results);
+    Prune(results, plan.RemainingMaxProbability(0));
+    if (stats) {
+      stats->num_pruned += num_built - results.size();
+      RecordResults(*stats, 0, results.size());
+    }
     if (results.empty()) {
+      if (stats) {
+        stats->extend_seconds += Seconds(start);
+      }
       return false;
     }
   }
 
-  std::vector<Interpretation> new_results;
-
   // Iteratively extend Interpretations to cover remaining rule elements.
-  for (++p; p != option_table.end(); ++p) {
-    size_t index = p->first;
-    const OptionColumn &col = p->second;
-    for (OptionColumn::const_iterator q = col.begin(); q != col.end(); ++q) {
-      boost::shared_ptr<const FeatureStructure> fs = *q;
-      assert(fs);
-      std::vector<Interpretation>::const_iterator r;
-      std::vector<Interpretation>::const_iterator end = results.end();
-      for (r = results.begin(); r != end; ++r) {
-        PotentialInterpretation candidate(*r, index, fs);
-        if (!candidate.QuickCheck(constraint_set)) {
-          continue;
-        }
-        Interpretation interpretation(candidate);
-        if (interpretation.Eval(constraint_set)) {
-          new_results.push_back(interpretation);
-        }
-      }
-    }
-    if (new_results.empty()) {
-      results.clear();
-      return false;
-    }
-    results.swap(new_results);
-    new_results.clear();
+  bool found = Extend(plan, 1, compiled, thread_pool, stats, results);
+  if (stats) {
+    stats->extend_seconds += Seconds(start);
   }
-
-  return !results.empty();
+  return found;
 }
 
 bool ConstraintEvaluator::Eval(const std::vector<Interpretation> &prev_results,
                                const OptionTable &option_table,
                                const ConstraintSet &constraint_set,
                                std::vector<Interpretation> &results) const {
+  return Eval(prev_results, option_table, CompiledConstraintSet(constraint_set),
+              results);
+}
+
+bool ConstraintEvaluator::Eval(const std::vector<Interpretation> &prev_results,
+                               const OptionTable &option_table,
+                               const CompiledConstraintSet &compiled,
+                               std::vector<Interpretation> &results) const {
   // TODO Avoid copying?
   results = prev_results;
 
@@ -89,30 +901,210 @@ bool ConstraintEvaluator::Eval(const std::vector<Interpretation> &prev_results,
     return true;
   }
 
-  std::vector<Interpretation> new_results;
+  std::set<int> covered;
+  if (!results.empty()) {
+    for (Interpretation::const_iterator p = results.front().begin();
+         p != results.front().end(); ++p) {
+      covered.insert(p->first);
+    }
+  }
+
+  if (stats_) {
+    ++stats_->num_evals;
+  }
+  double start = stats_ ? Now() : 0.0;
+  ColumnPlan plan;
+  bool ok = plan.Build(option_table, compiled.constraint_set(), covered, 0,
+                       stats_);
+  if (stats_) {
+    stats_->plan_seconds += Seconds(start);
+    start = Now();
+  }
+  if (!ok) {
+    if (stats_) {
+      ++stats_->num_plan_failures;
+    }
+    results.clear();
+    return false;
+  }
 
   // Iteratively expand Interpretations to cover new rule elements.
-  for (OptionTable::const_iterator p = option_table.begin();
-       p != option_table.end(); ++p) {
-    size_t index = p->first;
-    const OptionColumn &col = p->second;
-    for (OptionColumn::const_iterator q = col.begin(); q != col.end(); ++q) {
-      boost::shared_ptr<const FeatureStructure> fs = *q;
-      assert(fs);
-      std::vector<Interpretation>::const_iterator r;
-      std::vector<Interpretation>::const_iterator end = results.end();
-      for (r = results.begin(); r != end; ++r) {
-        PotentialInterpretation candidate(*r, index, fs);
-        if (!candidate.QuickCheck(constraint_set)) {
-          continue;
+  bool found = Extend(plan, 0, compiled, thread_pool_.get(), stats_, results);
+  if (stats_) {
+    stats_->extend_seconds += Seconds(start);
+  }
+  return found;
+}
+
+void ConstraintEvaluator::EvalBatch(
+    const std::vector<Query> &queries,
+    std::vector<std::vector<Interpretation> > &results,
+    std::vector<bool> &found) const {
+  results.clear();
+  results.resize(queries.size());
+  std::vector<char> flags(queries.size(), 0);
+  if (thread_pool_) {
+    // The queries may share options, so make sure that no thread modifies
+    // them.
+    for (std::vector<Query>::const_iterator p = queries.begin();
+         p != queries.end(); ++p) {
+      for (OptionTable::const_iterator q = p->first->begin();
+           q != p->first->end(); ++q) {
+        DechainAll(q->second);
+      }
+    }
+  }
+  const std::size_t num_workers = thread_pool_ ? thread_pool_->Size() : 1;
+  BatchJob job(*this, queries, 0, num_workers, results, flags);
+  if (thread_pool_) {
+    thread_pool_->Execute(job, queries.size(), 1);
+  } else {
+    job.Run(0, queries.size(), 0);
+  }
+  job.MergeStats();
+  found.assign(flags.begin(), flags.end());
+}
+
+void ConstraintEvaluator::EvalBatch(
+    const OptionTable &option_table,
+    const ConstraintSetSet &constraint_sets,
+    std::vector<std::vector<Interpretation> > &results,
+    std::vector<bool> &found) const {
+  std::vector<Query> queries;
+  queries.reserve(constraint_sets.size());
+  for (ConstraintSetSet::const_iterator p = constraint_sets.begin();
+       p != constraint_sets.end(); ++p) {
+    queries.push_back(std::make_pair(&option_table, p->get()));
+  }
+  results.clear();
+  results.resize(queries.size());
+
+  // TODO What's the right thing to do here?  (As for Eval.)
+  if (option_table.IsEmpty()) {
+    found.assign(queries.size(), true);
+    return;
+  }
+
+  std::vector<char> flags(queries.size(), 0);
+  std::vector<ColumnValues> column_values(option_table.Size());
+
+  if (thread_pool_) {
+    // Extract every path that the constraint sets test, so that the threads
+    // only read the shared ColumnValues.
+    std::map<std::size_t, std::size_t> positions;
+    std::vector<const OptionColumn *> columns;
+    for (OptionTable::const_iterator p = option_table.begin();
+         p != option_table.end(); ++p) {
+      positions[p->first] = columns.size();
+      columns.push_back(&p->second);
+      DechainAll(p->second);
+    }
+    for (ConstraintSetSet::const_iterator p = constraint_sets.begin();
+         p != constraint_sets.end(); ++p) {
+      const ConstraintSet &cs = **p;
+      for (AbsConstraintSet::ConstIterator q = cs.abs_set().Begin();
+           q != cs.abs_set().End(); ++q) {
+        std::map<std::size_t, std::size_t>::const_iterator r =
+            positions.find((*q)->lhs.index());
+        if (r != positions.end()) {
+          column_values[r->second].Get((*q)->lhs.path(), *columns[r->second]);
+        }
+      }
+      for (VarConstraintSet::ConstIterator q = cs.var_set().Begin();
+           q != cs.var_set().End(); ++q) {
+        std::map<std::size_t, std::size_t>::const_iterator r =
+            positions.find((*q)->lhs.index());
+        if (r != positions.end()) {
+          column_values[r->second].Get((*q)->lhs.path(), *columns[r->second]);
         }
-        Interpretation interpretation(candidate);
-        // FIXME Is constraint evaluation necessary?
-        if (!interpretation.IsEmpty() && interpretation.Eval(constraint_set)) {
-          new_results.push_back(interpretation);
+      }
+    }
+    BatchJob job(*this, queries, &column_values, thread_pool_->Size(),
+                 results, flags);
+    thread_pool_->Execute(job, queries.size(), 1);
+    job.MergeStats();
+    found.assign(flags.begin(), flags.end());
+    return;
+  }
+
+  // Evaluate the smallest constraint sets first.  If a set has no solution
+  // then neither does any superset (extra constraints can only remove
+  // interpretations or lower their probabilities), unless the beam is in use
+  // (since the beam can discard different partial interpretations for the
+  // superset).
+  std::vector<std::pair<std::size_t, std::size_t> > order;
+  order.reserve(queries.size());
+  for (std::size_t i = 0; i < queries.size(); ++i) {
+    order.push_back(std::make_pair(queries[i].second->Size(), i));
+  }
+  std::sort(order.begin(), order.end());
+  std::vector<const ConstraintSet *> failed;
+  BatchJob job(*this, queries, &column_values, 1, results, flags);
+  for (std::size_t i = 0; i < order.size(); ++i) {
+    const ConstraintSet &cs = *queries[order[i].second].second;
+    bool skip = false;
+    if (beam_width_ == 0) {
+      for (std::vector<const ConstraintSet *>::const_iterator p =
+           failed.begin(); p != failed.end(); ++p) {
+        if (Includes(cs, **p)) {
+          skip = true;
+          break;
         }
       }
     }
+    if (!skip) {
+      job.Run(order[i].second, 0);
+      if (!flags[order[i].second]) {
+        failed.push_back(&cs);
+      }
+    }
+  }
+  job.MergeStats();
+  found.assign(flags.begin(), flags.end());
+}
+
+bool ConstraintEvaluator::Extend(const ColumnPlan &plan, std::size_t first,
+                                 const CompiledConstraintSet &compiled,
+                                 ThreadPool *thread_pool,
+                                 ConstraintEvaluatorStats *stats,
+                                 std::vector<Interpretation> &results) const {
+  const ConstraintSet &constraint_set = compiled.constraint_set();
+
+  std::vector<Interpretation> new_results;
+  BitsetFilter filter(bitset_layout_.get(), bitset_path_);
+  const std::size_t num_threads = thread_pool ? thread_pool->Size() : 1;
+  ColumnJob::UnifierVec unifiers(num_threads);
+  for (std::size_t i = 0; i < num_threads; ++i) {
+    unifiers[i].reset(new QuasiDestructiveUnifier());
+  }
+
+  for (std::size_t i = first; i < plan.Size(); ++i) {
+    size_t index = plan.index(i);
+    const OptionColumn &col = plan.column(i);
+    filter.Prepare(constraint_set, results, index, col);
+    ColumnJob job(plan, i, compiled, filter, results, unifiers, stats);
+    const std::size_t num_candidates = job.NumCandidates();
+    if (thread_pool) {
+      DechainAll(results);
+      DechainAll(col);
+      std::size_t chunk_size = std::max(
+          kMinChunkSize, num_candidates / (num_threads * kChunksPerThread));
+      job.SetChunkSize(chunk_size);
+      thread_pool->Execute(job, num_candidates, chunk_size);
+    } else if (num_candidates > 0) {
+      job.SetChunkSize(num_candidates);
+      job.Run(0, num_candidates, 0);
+    }
+    job.Collect(new_results);
+    const std::size_t num_built = new_results.size();
+    Recombine(plan, i, compiled, new_results);
+    Prune(new_results, plan.RemainingMaxProbability(i));
+    if (stats) {
+      job.MergeStats();
+      ++stats->num_columns;
+      stats->num_pruned += num_built - new_results.size();
+      RecordResults(*stats, i, new_results.size());
+    }
     if (new_results.empty()) {
       results.clear();
       return false;
@@ -124,12 +1116,80 @@ bool ConstraintEvaluator::Eval(const std::vector<Interpretation> &prev_results,
   return !results.empty();
 }
 
-// TODO This should be an optimised version of the other eval() -- only need
-// to find first valid interpretation.
 bool ConstraintEvaluator::Eval(const OptionTable &option_table,
                                const ConstraintSet &constraint_set) const {
-  std::vector<Interpretation> results;
-  return Eval(option_table, constraint_set, results);
+  return Eval(option_table, CompiledConstraintSet(constraint_set));
+}
+
+bool ConstraintEvaluator::Eval(const OptionTable &option_table,
+                               const CompiledConstraintSet &compiled) const {
+  // TODO What's the right thing to do here?
+  if (option_table.IsEmpty()) {
+    return true;
+  }
+
+  if (stats_) {
+    ++stats_->num_evals;
+  }
+  double start = stats_ ? Now() : 0.0;
+  ColumnPlan plan;
+  bool ok = plan.Build(option_table, compiled.constraint_set(), std::set<int>(),
+                       0, stats_);
+  if (stats_) {
+    stats_->plan_seconds += Seconds(start);
+  }
+  if (!ok) {
+    if (stats_) {
+      ++stats_->num_plan_failures;
+    }
+    return false;
+  }
+
+  QuasiDestructiveUnifier unifier;
+  return Search(plan, 0, 0, compiled, unifier);
+}
+
+bool ConstraintEvaluator::Search(const ColumnPlan &plan, std::size_t step,
+                                 const Interpretation *prev,
+                                 const CompiledConstraintSet &compiled,
+                                 QuasiDestructiveUnifier &unifier) const {
+  const ConstraintSet &constraint_set = compiled.constraint_set();
+  size_t index = plan.index(step);
+  const OptionColumn &col = plan.column(step);
+  const ColumnFilter &column_filter = plan.filter(step);
+  const FeatureTree &tree = compiled.GetModifiablePaths(index);
+  const bool last = (step + 1 == plan.Size());
+  const float remaining = plan.RemainingMaxProbability(step);
+
+  std::size_t qi = 0;
+  for (OptionColumn::const_iterator q = col.begin(); q != col.end();
+       ++q, ++qi) {
+    if (!column_filter.Check(qi)) {
+      continue;
+    }
+    boost::shared_ptr<const FeatureStructure> fs = *q;
+    assert(fs);
+    if (!prev) {
+      Interpretation interpretation(index, fs->PartialClone(tree));
+      if (interpretation.Eval(compiled) &&
+          interpretation.probability() * remaining >= min_probability_ &&
+          (last || Search(plan, step+1, &interpretation, compiled, unifier))) {
+        return true;
+      }
+      continue;
+    }
+    PotentialInterpretation candidate(*prev, index, fs);
+    if (!candidate.QuickCheckRelations(constraint_set, unifier)) {
+      continue;
+    }
+    Interpretation interpretation(candidate, tree);
+    if (!interpretation.IsEmpty() && interpretation.Eval(compiled) &&
+        interpretation.probability() * remaining >= min_probability_ &&
+        (last || Search(plan, step+1, &interpretation, compiled, unifier))) {
+      return true;
+    }
+  }
+  return false;
 }
 
 }  // namespace taco
@@ -1,31 +1,53 @@
 #ifndef TACO_SRC_TACO_CONSTRAINT_EVALUATOR_H_
 #define TACO_SRC_TACO_CONSTRAINT_EVALUATOR_H_
 
+#include <cstddef>
+#include <utility>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
+
+#include "taco/feature_path.h"
+
 namespace taco {
 
+class BitsetLayout;
+class CompiledConstraintSet;
 class ConstraintSet;
+class ConstraintSetSet;
+struct ConstraintEvaluatorStats;
 class Interpretation;
 class OptionTable;
+class QuasiDestructiveUnifier;
+class ThreadPool;
 
-// TODO 'Recombine' interpretations?  Two interpretations could contain
-// feature structures that only differ in values outside the constraints.  It
-// might make sense to compress them into a single object, either losslessly
-// (by retaining ambiguity) or by discarding all but one.
+// TODO Recombination currently discards all but one of a set of equivalent
+// interpretations.  It might make sense to retain the ambiguity instead.
 class ConstraintEvaluator {
  public:
+  // An option table and a set of constraints to evaluate against it.
+  typedef std::pair<const OptionTable *, const ConstraintSet *> Query;
+
+  ConstraintEvaluator()
+      : beam_width_(0)
+      , min_probability_(0.0f)
+      , recombine_(false)
+      , stats_(0) {}
+
   // Searches for interpretations over the option table that satisfy the
   // constraints.  If the option table is missing a column indexed by the
   // constraints then a 'wildcard' column (containing a single empty feature
   // structure) is inserted prior to evaluation.  Returns true if at least one
-  // interpretation is found.
+  // interpretation is found.  The columns are not necessarily evaluated in
+  // index order (the most selective are evaluated first) so the order of the
+  // resulting interpretations is unspecified.
   bool Eval(const OptionTable &, const ConstraintSet &,
             std::vector<Interpretation> &) const;
 
   // Same as above except that it does not return the set of interpretations.
-  // This is potentially faster since Eval only needs to find the first valid
-  // interpretation, but currently it's just a wrapper around the first form.
+  // Instead of building every interpretation column by column, this performs
+  // a depth-first search that stops at the first valid interpretation, so
+  // only one interpretation per column is held at a time.
   bool Eval(const OptionTable &, const ConstraintSet &) const;
 
   // Searches for interpretations that are consistent with both an existing set
@@ -34,6 +56,155 @@ class ConstraintEvaluator {
   // interpretation is found.
   bool Eval(const std::vector<Interpretation> &, const OptionTable &,
             const ConstraintSet &, std::vector<Interpretation> &) const;
+
+  // As above, but taking a compiled constraint set.  The ConstraintSet forms
+  // compile the constraint set on every call, so a caller that evaluates the
+  // same constraints against many option tables should compile them once and
+  // use these forms instead.
+  bool Eval(const OptionTable &, const CompiledConstraintSet &,
+            std::vector<Interpretation> &) const;
+  bool Eval(const OptionTable &, const CompiledConstraintSet &) const;
+  bool Eval(const std::vector<Interpretation> &, const OptionTable &,
+            const CompiledConstraintSet &,
+            std::vector<Interpretation> &) const;
+
+  // Evaluates each query independently, as by the first form of Eval,
+  // storing the interpretations in the corresponding element of the second
+  // argument and the return value in the corresponding element of the third.
+  // If the evaluator has more than one thread then the queries are shared
+  // among the threads (each query is evaluated by a single thread).  The
+  // option tables' feature structures may be shared between queries.
+  void EvalBatch(const std::vector<Query> &,
+                 std::vector<std::vector<Interpretation> > &,
+                 std::vector<bool> &) const;
+
+  // Evaluates every constraint set of the set against the option table, as
+  // by the first form of Eval, storing the results in set order.  Work that
+  // does not depend on the constraints is shared: the values that the
+  // absolute and variable constraints test are extracted from each column
+  // once for all of the sets.  Without threads, the sets are evaluated
+  // smallest first, and a set that includes a set that has already failed
+  // is not evaluated since it cannot succeed (unless the beam is in use).
+  // With threads, the sets are evaluated concurrently.
+  void EvalBatch(const OptionTable &, const ConstraintSetSet &,
+                 std::vector<std::vector<Interpretation> > &,
+                 std::vector<bool> &) const;
+
+  // Sets the number of threads used by evaluation.  With more than one
+  // thread, each column step of the forms of Eval that return
+  // interpretations divides the candidates (pairs of an option and a partial
+  // interpretation) among the threads, and EvalBatch divides its queries.
+  // The results are the same as with one thread (the default), in the same
+  // order.  The depth-first yes/no form of Eval is not parallelized.  The
+  // evaluator must not be used by several threads at once when this is
+  // greater than one, and evaluation may shorten chains of forward pointers
+  // in the option tables and input interpretations (see
+  // FeatureStructure::DechainAll).  Copies of the evaluator share its threads.
+  void SetNumThreads(std::size_t);
+
+  // Sets a layout for encoding the values found at the given path.  Before
+  // the full check, candidate interpretations are tested against relational
+  // constraints that equate values at this path using the encoded values
+  // (see BitsetLayout).  Values that cannot be encoded are left to the full
+  // check.  Typically the layout is built from the lexicon's values at the
+  // path (for example, <INFL>).
+  void SetBitsetLayout(const FeaturePath &,
+                       boost::shared_ptr<const BitsetLayout>);
+
+  // Limits the number of partial interpretations that are kept after each
+  // column to the given number, keeping those with the highest probabilities.
+  // This bounds the time and memory used by evaluation but may discard
+  // interpretations that would have scored highest in the end, so it only
+  // applies to the forms of Eval that return interpretations.  Zero (the
+  // default) means no limit.
+  void SetBeamWidth(std::size_t width) { beam_width_ = width; }
+
+  // Discards any interpretation whose probability is certain to end up below
+  // the given value.  Since variable constraints can only reduce an
+  // interpretation's probability, a partial interpretation is discarded as
+  // soon as its probability times the maximum probabilities of the variable
+  // constraints on the remaining columns falls below the threshold.  Unlike
+  // the beam, this never discards an interpretation that would meet the
+  // threshold.  The default is zero.
+  void SetMinProbability(float p) { min_probability_ = p; }
+
+  // Enables or disables recombination of partial interpretations.  Two
+  // interpretations can contain feature structures that only differ in
+  // values outside the constraints.  Since constraint evaluation never looks
+  // at those values, both interpretations will succeed or fail together
+  // when extended and their probabilities will change by the same factor.
+  // (The exception is an index whose option has yet to be unified with an
+  // existing value, as in the third form of Eval, so values at such indices
+  // are compared in full.)
+  // If recombination is enabled then, after each column, only the most
+  // probable of a set of such interpretations is kept.  Recombination is
+  // disabled by default, since the discarded interpretations may be of
+  // interest to the caller.  Like the beam, it only applies to the forms of
+  // Eval that return interpretations.
+  void SetRecombination(bool recombine) { recombine_ = recombine; }
+
+  // Sets an object to which evaluation adds counts of the work done at each
+  // stage (see ConstraintEvaluatorStats), or disables counting if null (the
+  // default).  The object is not owned and must outlive its use.  The
+  // per-candidate loops are compiled in two versions, so evaluation without
+  // stats does no counting.  The depth-first form of Eval only counts
+  // evaluations, planning and filtered options.  Copies of the evaluator
+  // share the object.
+  void SetStats(ConstraintEvaluatorStats *stats) { stats_ = stats; }
+
+ private:
+  class BatchJob;
+  class BitsetFilter;
+  class ColumnFilter;
+  class ColumnJob;
+  class ColumnPlan;
+  class ColumnValues;
+
+  // Implements the first form of Eval, using the given thread pool (which
+  // may be null) for the column steps.  If the fifth argument is non-null
+  // then it holds the ColumnValues of the option table's columns (see
+  // ColumnPlan::Build).  If the final argument is non-null then the work is
+  // counted there.
+  bool Eval(const OptionTable &, const CompiledConstraintSet &,
+            std::vector<Interpretation> &, ThreadPool *,
+            std::vector<ColumnValues> *, ConstraintEvaluatorStats *) const;
+
+  // Extends the interpretations to cover the columns of the plan, starting
+  // with the given step.  Returns true if at least one interpretation is
+  // found.  If the thread pool is non-null then the candidates of each step
+  // are divided among its threads.  If the stats are non-null then the work
+  // is counted there.
+  bool Extend(const ColumnPlan &, std::size_t, const CompiledConstraintSet &,
+              ThreadPool *, ConstraintEvaluatorStats *,
+              std::vector<Interpretation> &) const;
+
+  // Searches depth-first for a valid interpretation covering the columns of
+  // the plan from the given step onwards, extending the given interpretation
+  // (which is null at step 0).
+  bool Search(const ColumnPlan &, std::size_t, const Interpretation *,
+              const CompiledConstraintSet &, QuasiDestructiveUnifier &) const;
+
+  // Applies the probability threshold and the beam to a set of partial
+  // interpretations.  The second argument is the plan's remaining maximum
+  // probability.
+  void Prune(std::vector<Interpretation> &, float) const;
+
+  // Discards all but the most probable of each set of interpretations that
+  // have the same values at the paths referenced by the constraints, after
+  // the given step of the plan.  Values at the indices of the plan's
+  // remaining columns are compared in full, since those columns will be
+  // unified with them at the root.
+  void Recombine(const ColumnPlan &, std::size_t,
+                 const CompiledConstraintSet &,
+                 std::vector<Interpretation> &) const;
+
+  FeaturePath bitset_path_;
+  boost::shared_ptr<const BitsetLayout> bitset_layout_;
+  std::size_t beam_width_;
+  float min_probability_;
+  bool recombine_;
+  boost::shared_ptr<ThreadPool> thread_pool_;
+  ConstraintEvaluatorStats *stats_;
 };
 
 }  // namespace taco
@@ -0,0 +1,70 @@
+#include "taco/constraint_evaluator_stats.h"
+
+#include <algorithm>
+
+namespace taco {
+
+void ConstraintEvaluatorStats::Clear() {
+  num_evals = 0;
+  num_plan_failures = 0;
+  num_columns = 0;
+  num_abs_rejections = 0;
+  num_var_rejections = 0;
+  num_candidates = 0;
+  num_bitset_rejections = 0;
+  num_quick_unifications = 0;
+  num_rel_rejections = 0;
+  num_clones = 0;
+  num_eval_failures = 0;
+  num_pruned = 0;
+  max_results.clear();
+  plan_seconds = 0.0;
+  extend_seconds = 0.0;
+}
+
+void ConstraintEvaluatorStats::Merge(const ConstraintEvaluatorStats &other) {
+  num_evals += other.num_evals;
+  num_plan_failures += other.num_plan_failures;
+  num_columns += other.num_columns;
+  num_abs_rejections += other.num_abs_rejections;
+  num_var_rejections += other.num_var_rejections;
+  num_candidates += other.num_candidates;
+  num_bitset_rejections += other.num_bitset_rejections;
+  num_quick_unifications += other.num_quick_unifications;
+  num_rel_rejections += other.num_rel_rejections;
+  num_clones += other.num_clones;
+  num_eval_failures += other.num_eval_failures;
+  num_pruned += other.num_pruned;
+  if (max_results.size() < other.max_results.size()) {
+    max_results.resize(other.max_results.size(), 0);
+  }
+  for (std::size_t i = 0; i < other.max_results.size(); ++i) {
+    max_results[i] = std::max(max_results[i], other.max_results[i]);
+  }
+  plan_seconds += other.plan_seconds;
+  extend_seconds += other.extend_seconds;
+}
+
+void ConstraintEvaluatorStats::Dump(std::ostream &out) const {
+  out << "evals: " << num_evals << "\n"
+      << "plan failures: " << num_plan_failures << "\n"
+      << "columns: " << num_columns << "\n"
+      << "options rejected (abs): " << num_abs_rejections << "\n"
+      << "options rejected (var): " << num_var_rejections << "\n"
+      << "candidates: " << num_candidates << "\n"
+      << "candidates rejected (bitset): " << num_bitset_rejections << "\n"
+      << "quick unifications: " << num_quick_unifications << "\n"
+      << "candidates rejected (rel): " << num_rel_rejections << "\n"
+      << "clones: " << num_clones << "\n"
+      << "full evaluation failures: " << num_eval_failures << "\n"
+      << "pruned: " << num_pruned << "\n"
+      << "max results per column:";
+  for (std::size_t i = 0; i < max_results.size(); ++i) {
+    out << " " << max_results[i];
+  }
+  out << "\n"
+      << "plan seconds: " << plan_seconds << "\n"
+      << "extend seconds: " << extend_seconds << "\n";
+}
+
+}  // namespace taco
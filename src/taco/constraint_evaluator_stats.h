@@ -0,0 +1,72 @@
+#ifndef TACO_SRC_TACO_CONSTRAINT_EVALUATOR_STATS_H_
+#define TACO_SRC_TACO_CONSTRAINT_EVALUATOR_STATS_H_
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace taco {
+
+// Counters and timers describing the work done by a ConstraintEvaluator (see
+// ConstraintEvaluator::SetStats).  The counts accumulate over calls until
+// Clear() is called.
+struct ConstraintEvaluatorStats {
+  ConstraintEvaluatorStats() { Clear(); }
+
+  void Clear();
+
+  // Adds the counts of another object to this one.
+  void Merge(const ConstraintEvaluatorStats &);
+
+  // Writes the counts in a human-readable form, one per line.
+  void Dump(std::ostream &) const;
+
+  // The number of evaluations (calls to Eval, or queries of EvalBatch) and
+  // the number that failed because some column had no viable option.
+  std::size_t num_evals;
+  std::size_t num_plan_failures;
+
+  // The number of column steps.
+  std::size_t num_columns;
+
+  // The number of options that the column filters rejected, split by the
+  // type of the constraint that rejected them (an option rejected by both
+  // types is counted as rejected by the absolute constraints).  Each
+  // rejected option removes a whole row of candidates.
+  std::size_t num_abs_rejections;
+  std::size_t num_var_rejections;
+
+  // The number of candidates (an option plus, after the first column, a
+  // partial interpretation) that were generated from the options that
+  // passed the column filters, the number rejected by the bitset filter, and
+  // the number of quasi-destructive unification checks of the relational
+  // constraints and the number of those that failed.
+  std::size_t num_candidates;
+  std::size_t num_bitset_rejections;
+  std::size_t num_quick_unifications;
+  std::size_t num_rel_rejections;
+
+  // The number of interpretations built (each copies the feature structures
+  // of a candidate) and the number of those that failed full evaluation.
+  std::size_t num_clones;
+  std::size_t num_eval_failures;
+
+  // The number of interpretations discarded by recombination, the
+  // probability threshold and the beam.
+  std::size_t num_pruned;
+
+  // The largest number of interpretations that remained after the n-th
+  // column step of an evaluation, for each n.
+  std::vector<std::size_t> max_results;
+
+  // Elapsed (wall-clock) time spent planning column orders and extending
+  // interpretations, in seconds, summed over evaluations.  The threads of a
+  // column step are not counted separately, but the queries of EvalBatch
+  // are, so with several threads these can exceed the batch's elapsed time.
+  double plan_seconds;
+  double extend_seconds;
+};
+
+}  // namespace taco
+
+#endif
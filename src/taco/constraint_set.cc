@@ -1,7 +1,32 @@
 #include "taco/constraint_set.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace taco {
 
+namespace {
+
+// Inserts the path into the tree, creating nodes as necessary, and returns
+// the node corresponding to the end of the path.
+FeatureTree &InsertPath(FeatureTree &tree, const FeaturePath &path) {
+  FeatureTree *node = &tree;
+  for (FeaturePath::const_iterator p = path.begin(); p != path.end(); ++p) {
+    boost::shared_ptr<FeatureTree> &child = node->children_[*p];
+    if (!child) {
+      child.reset(new FeatureTree());
+    }
+    node = child.get();
+  }
+  return *node;
+}
+
+bool LongerPath(const FeaturePath *a, const FeaturePath *b) {
+  return a->size() > b->size();
+}
+
+}  // namespace
+
 bool AbsConstraintSet::ContainsIndex(int i) const {
   for (ConstIterator p = Begin(); p != End(); ++p) {
     if ((*p)->ContainsIndex(i)) {
@@ -144,6 +169,44 @@ float ConstraintSet::MaxProbability() const {
   return prob;
 }
 
+void ConstraintSet::GetModifiablePaths(int index, FeatureTree &tree) const {
+  tree.children_.clear();
+
+  // Absolute and variable constraints can add values along their paths.
+  for (AbsConstraintSet::ConstIterator p = abs_set_.Begin();
+       p != abs_set_.End(); ++p) {
+    if ((*p)->lhs.index() == index) {
+      InsertPath(tree, (*p)->lhs.path());
+    }
+  }
+  for (VarConstraintSet::ConstIterator p = var_set_.Begin();
+       p != var_set_.End(); ++p) {
+    if ((*p)->lhs.index() == index) {
+      InsertPath(tree, (*p)->lhs.path());
+    }
+  }
+
+  // Relative constraints unify the values at their paths in full, so those
+  // values must be leaves.  Inserting the longest paths first ensures that
+  // shorter paths prune any longer ones.
+  std::vector<const FeaturePath *> rel_paths;
+  for (RelConstraintSet::ConstIterator p = rel_set_.Begin();
+       p != rel_set_.End(); ++p) {
+    const RelConstraint &constraint = **p;
+    if (constraint.lhs.index() == index) {
+      rel_paths.push_back(&constraint.lhs.path());
+    }
+    if (constraint.rhs.index() == index) {
+      rel_paths.push_back(&constraint.rhs.path());
+    }
+  }
+  std::stable_sort(rel_paths.begin(), rel_paths.end(), LongerPath);
+  for (std::vector<const FeaturePath *>::const_iterator p = rel_paths.begin();
+       p != rel_paths.end(); ++p) {
+    InsertPath(tree, **p).children_.clear();
+  }
+}
+
 bool operator==(const ConstraintSet &lhs, const ConstraintSet &rhs) {
   if (lhs.Size() != rhs.Size()) {
     return false;
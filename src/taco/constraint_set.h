@@ -8,6 +8,7 @@
 #include <boost/shared_ptr.hpp>
 
 #include "taco/constraint.h"
+#include "taco/feature_tree.h"
 #include "taco/base/utility.h"
 
 namespace taco {
@@ -192,6 +193,12 @@ class ConstraintSet {
 
   float MaxProbability() const;
 
+  // Builds a FeatureTree containing every feature path at which evaluation of
+  // this constraint set may modify the feature structure with the given index
+  // (values that are unified in full become leaves of the tree).  An empty
+  // tree means that the whole feature structure may be modified.
+  void GetModifiablePaths(int, FeatureTree &) const;
+
   friend bool operator==(const ConstraintSet &, const ConstraintSet &);
   friend bool operator!=(const ConstraintSet &, const ConstraintSet &);
 
@@ -7,19 +7,19 @@
 #include <boost/lexical_cast.hpp>
 
 #include "taco/base/exception.h"
+#include "taco/base/string_util.h"
 #include "taco/text-formats/feature_tree_parser.h"
 
 namespace taco {
 
 FeatureSelectionTableParser::FeatureSelectionTableParser()
-    : input_(0)
-    , feature_set_(0)
+    : feature_set_(0)
     , parser_(0) {
 }
 
 FeatureSelectionTableParser::FeatureSelectionTableParser(std::istream &input,
     Vocabulary &feature_set)
-    : input_(&input)
+    : reader_(new LineReader(input))
     , feature_set_(&feature_set)
     , parser_(new FeatureTreeParser(feature_set)) {
   ++(*this);
@@ -30,12 +30,12 @@ FeatureSelectionTableParser::~FeatureSelectionTableParser() {
 }
 
 FeatureSelectionTableParser &FeatureSelectionTableParser::operator++() {
-  if (!input_) {
+  if (!reader_) {
     return *this;
   }
-  std::string line;
-  if (!std::getline(*input_, line)) {
-    input_ = 0;
+  StringPiece line;
+  if (!reader_->Next(line)) {
+    reader_.reset();
     return *this;
   }
   ParseLine(line);
@@ -48,19 +48,19 @@ FeatureSelectionTableParser FeatureSelectionTableParser::operator++(int) {
   return tmp;
 }
 
-void FeatureSelectionTableParser::ParseLine(const std::string &line) {
+void FeatureSelectionTableParser::ParseLine(const StringPiece &line) {
   // Index
-  size_t pos = line.find("|||");
+  size_t pos = FindFieldSeparator(line);
   if (pos == std::string::npos) {
     throw Exception("missing delimiter");
   }
-  std::string text = line.substr(0, pos);
+  std::string text = line.substr(0, pos).as_string();
   boost::trim(text);
   // TODO Error handling
   value_.index = boost::lexical_cast<int>(text);
 
   // Feature selection rule
-  text = line.substr(pos+3);
+  text = line.substr(pos+3).as_string();
   boost::trim(text);
   if (text == "assign") {
     value_.rule.reset(new FeatureSelectionRule(
@@ -78,7 +78,7 @@ void FeatureSelectionTableParser::ParseLine(const std::string &line) {
 bool operator==(const FeatureSelectionTableParser &lhs,
                 const FeatureSelectionTableParser &rhs) {
   // TODO Is this right?  Compare values of istreams if non-zero?
-  return lhs.input_ == rhs.input_;
+  return lhs.reader_ == rhs.reader_;
 }
 
 bool operator!=(const FeatureSelectionTableParser &lhs,
@@ -8,6 +8,8 @@
 #include <boost/shared_ptr.hpp>
 
 #include "taco/feature_selection_rule.h"
+#include "taco/base/line_reader.h"
+#include "taco/base/string_piece.h"
 #include "taco/text-formats/feature_tree_parser.h"
 
 namespace taco {
@@ -47,11 +49,11 @@ class FeatureSelectionTableParser {
 
  private:
   Entry value_;
-  std::istream *input_;
+  boost::shared_ptr<LineReader> reader_;
   Vocabulary *feature_set_;
   FeatureTreeParser *parser_;
 
-  void ParseLine(const std::string &);
+  void ParseLine(const StringPiece &);
 };
 
 }  // namespace taco
@@ -1,37 +1,39 @@
 #include "taco/feature_structure.h"
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 #include <sstream>
 #include <utility>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/unordered_set.hpp>
 
 namespace taco {
 
 FeatureStructure::FeatureStructure(const FeatureStructureSpec &spec)
-    : content_(0) {
+    : trailed_(0) {
   typedef FeatureStructureSpec Spec;
 
+  bool have_root_content = false;
   for (Spec::ContentPairSet::const_iterator p = spec.content_pairs.begin();
        p != spec.content_pairs.end(); ++p) {
     const FeaturePath &path = p->first;
     const AtomicValue &atom = p->second;
     if (path.empty()) {
-      if (content_) {
+      if (have_root_content) {
         std::ostringstream msg;
         msg << "Invalid FeatureStructureSpec: multiple empty-pathed "
             << "content pairs";
         throw Exception(msg.str());
-      } else if (atom == kNullAtom) {
-        content_ = new internal::FSContent();
-      } else {
-        content_ = new internal::FSContent(atom);
       }
+      content_.a = atom;
     } else {
-      if (!content_) {
-        content_ = new internal::FSContent();
-      }
       CreateAtomicValue(path.begin(), path.end(), atom);
     }
+    have_root_content = true;
   }
 
   for (Spec::EquivPairSet::const_iterator p = spec.equiv_pairs.begin();
@@ -51,16 +53,19 @@ FeatureStructure::FeatureStructure(const FeatureStructureSpec &spec)
 }
 
 FeatureStructure::~FeatureStructure() {
-  delete content_;
+}
+
+boost::shared_ptr<FeatureStructure> FeatureStructure::NewNode() {
+  return boost::make_shared<FeatureStructure>(PrivateTag());
 }
 
 boost::shared_ptr<FeatureStructure> FeatureStructure::Clone() const {
-  boost::shared_ptr<FeatureStructure> clone(new FeatureStructure());
+  boost::shared_ptr<FeatureStructure> clone = NewNode();
   FeatureStructure::CloneMap clone_map;
   if (forward_) {
     clone->forward_ = GetForwardTarget()->Clone(clone_map);
   } else {
-    clone->content_ = content_->Clone(clone_map);
+    content_.Clone(clone->content_, clone_map);
   }
   return clone;
 }
@@ -68,22 +73,30 @@ boost::shared_ptr<FeatureStructure> FeatureStructure::Clone() const {
 boost::shared_ptr<FeatureStructure> FeatureStructure::SelectiveClone(
     const FeatureTree &tree) const {
   assert(!tree.Empty());
-  boost::shared_ptr<FeatureStructure> clone(new FeatureStructure());
+  boost::shared_ptr<FeatureStructure> clone = NewNode();
   FeatureStructure::CloneMap clone_map;
   if (forward_) {
     clone->forward_ = GetForwardTarget()->SelectiveClone(tree, clone_map);
   } else {
-    clone->content_ = content_->SelectiveClone(tree, clone_map);
+    content_.SelectiveClone(tree, clone->content_, clone_map);
   }
   return clone;
 }
 
+boost::shared_ptr<FeatureStructure> FeatureStructure::PartialClone(
+    const FeatureTree &tree) const {
+  if (tree.Empty() || !IsTreeShaped()) {
+    return Clone();
+  }
+  return CopyPaths(tree);
+}
+
 // Clones the feature structure rooted at this node.  The clone_map argument
 // maps a feature structure to its clone and is used to ensure that a feature
 // structure is only cloned the first time it is encountered.
 boost::shared_ptr<FeatureStructure> FeatureStructure::Clone(
     FeatureStructure::CloneMap &clone_map) const {
-  boost::shared_ptr<FeatureStructure> clone(new FeatureStructure());
+  boost::shared_ptr<FeatureStructure> clone = NewNode();
   if (forward_) {
     boost::shared_ptr<FeatureStructure> orig_fs = GetForwardTarget();
     boost::shared_ptr<FeatureStructure> &clone_fs = clone_map[orig_fs];
@@ -92,7 +105,7 @@ boost::shared_ptr<FeatureStructure> FeatureStructure::Clone(
     }
     clone->forward_ = clone_fs;
   } else {
-    clone->content_ = content_->Clone(clone_map);
+    content_.Clone(clone->content_, clone_map);
   }
   return clone;
 }
@@ -101,7 +114,7 @@ boost::shared_ptr<FeatureStructure> FeatureStructure::SelectiveClone(
     const FeatureTree &tree,
     FeatureStructure::CloneMap &clone_map) const {
   assert(!tree.Empty());
-  boost::shared_ptr<FeatureStructure> clone(new FeatureStructure());
+  boost::shared_ptr<FeatureStructure> clone = NewNode();
   if (forward_) {
     boost::shared_ptr<FeatureStructure> orig_fs = GetForwardTarget();
     boost::shared_ptr<FeatureStructure> clone_fs;
@@ -114,11 +127,63 @@ boost::shared_ptr<FeatureStructure> FeatureStructure::SelectiveClone(
     }
     clone->forward_ = clone_fs;
   } else {
-    clone->content_ = content_->SelectiveClone(tree, clone_map);
+    content_.SelectiveClone(tree, clone->content_, clone_map);
   }
   return clone;
 }
 
+boost::shared_ptr<FeatureStructure> FeatureStructure::CopyPaths(
+    const FeatureTree &tree) const {
+  assert(!forward_);
+  boost::shared_ptr<FeatureStructure> copy = NewNode();
+  copy->content_.a = content_.a;
+  copy->content_.c.reserve(content_.c.size());
+  for (internal::FSContent::Map::const_iterator p = content_.c.begin();
+       p != content_.c.end(); ++p) {
+    Feature f = p->first;
+    const boost::shared_ptr<FeatureStructure> &orig_fs = p->second;
+    FeatureTree::ChildMap::const_iterator q = tree.children_.find(f);
+    boost::shared_ptr<FeatureStructure> value;
+    if (q == tree.children_.end()) {
+      value = orig_fs;
+    } else if (q->second->Empty()) {
+      value = orig_fs->Clone();
+    } else {
+      value = orig_fs->CopyPaths(*q->second);
+    }
+    copy->content_.c.insert(copy->content_.c.end(), std::make_pair(f, value));
+  }
+  return copy;
+}
+
+bool FeatureStructure::IsTreeShaped() const {
+  // Reference counts can't be used here: values are also shared with other
+  // feature structures (by earlier partial clones or by interning), which
+  // does not make them reentrant.  Instead, look for a node that is reached
+  // twice.
+  std::vector<const FeatureStructure *> nodes;
+  if (!CollectTreeNodes(nodes)) {
+    return false;
+  }
+  std::sort(nodes.begin(), nodes.end());
+  return std::adjacent_find(nodes.begin(), nodes.end()) == nodes.end();
+}
+
+bool FeatureStructure::CollectTreeNodes(
+    std::vector<const FeatureStructure *> &nodes) const {
+  if (forward_) {
+    return false;
+  }
+  for (internal::FSContent::Map::const_iterator p = content_.c.begin();
+       p != content_.c.end(); ++p) {
+    nodes.push_back(p->second.get());
+    if (!p->second->CollectTreeNodes(nodes)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool FeatureStructure::IsEmpty() const {
   return GetContent()->Empty();
 }
@@ -228,6 +293,34 @@ boost::shared_ptr<const FeatureStructure> FeatureStructure::Get(
   }
 }
 
+const FeatureStructure *FeatureStructure::Find(
+    FeaturePath::const_iterator begin,
+    FeaturePath::const_iterator end) const {
+  if (begin == end) {
+    throw Exception("FeatureStructure::Find() called with empty path");
+  }
+  const FeatureStructure *node = this;
+  for (FeaturePath::const_iterator p = begin; p != end; ++p) {
+    while (node->forward_) {
+      node = node->forward_.get();
+    }
+    const internal::FSContent &content = node->content_;
+    if (content.IsAtomic()) {
+      throw Exception(
+          "FeatureStructure::Find() called on atomic feature structure");
+    }
+    internal::FSContent::Map::const_iterator q = content.c.find(*p);
+    if (q == content.c.end()) {
+      return 0;
+    }
+    node = q->second.get();
+  }
+  while (node->forward_) {
+    node = node->forward_.get();
+  }
+  return node;
+}
+
 AtomicValue FeatureStructure::GetAtomicValue() const {
   internal::FSContent *p = GetContent();
   if (p->IsComplex()) {
@@ -236,25 +329,58 @@ AtomicValue FeatureStructure::GetAtomicValue() const {
   return p->a;
 }
 
-void FeatureStructure::Redirect(boost::shared_ptr<FeatureStructure> &other) {
-  if (forward_) {
-    assert(content_ == 0);
-    Dechain();
-    delete forward_->content_;
-    forward_->content_ = 0;
-    forward_->forward_ = other;
+void FeatureStructure::Redirect(boost::shared_ptr<FeatureStructure> &other,
+                                UnificationTrail *trail) {
+  FeatureStructure *target = GetContentBearer();
+  if (target != this) {
+    assert(content_.Empty());
+    if (trail) {
+      trail->RecordContent(*target);
+      trail->RecordForward(*target);
+    } else {
+      target->content_.Clear();
+    }
+    target->forward_ = other;
+  } else if (trail) {
+    trail->RecordContent(*this);
   } else {
-    delete content_;
-    content_ = 0;
+    content_.Clear();
+  }
+  if (trail) {
+    trail->RecordForward(*this);
   }
   forward_ = other;
 }
 
 bool FeatureStructure::Unify(boost::shared_ptr<FeatureStructure> &lhs,
                              boost::shared_ptr<FeatureStructure> &rhs) {
+  return Unify(lhs, rhs, 0);
+}
+
+bool FeatureStructure::Unify(boost::shared_ptr<FeatureStructure> &lhs,
+                             boost::shared_ptr<FeatureStructure> &rhs,
+                             UnificationTrail &trail) {
+  return Unify(lhs, rhs, &trail);
+}
+
+bool FeatureStructure::UnifyOrRollback(
+    boost::shared_ptr<FeatureStructure> &lhs,
+    boost::shared_ptr<FeatureStructure> &rhs) {
+  UnificationTrail trail;
+  if (Unify(lhs, rhs, &trail)) {
+    return true;
+  }
+  trail.Rollback();
+  return false;
+}
+
+bool FeatureStructure::Unify(boost::shared_ptr<FeatureStructure> &lhs,
+                             boost::shared_ptr<FeatureStructure> &rhs,
+                             UnificationTrail *trail) {
   // Dereference to get direct pointers to content objects.
+  FeatureStructure *rhs_bearer = rhs->GetContentBearer();
   internal::FSContent *lhs_content = lhs->GetContent();
-  internal::FSContent *rhs_content = rhs->GetContent();
+  internal::FSContent *rhs_content = &rhs_bearer->content_;
 
   // If the feature structures are already unified then there is nothing to do.
   if (lhs_content == rhs_content) {
@@ -263,10 +389,10 @@ bool FeatureStructure::Unify(boost::shared_ptr<FeatureStructure> &lhs,
 
   // Check for the case that one or both values are empty.
   if (lhs_content->Empty()) {
-    lhs->Redirect(rhs);
+    lhs->Redirect(rhs, trail);
     return true;
   } else if (rhs_content->Empty()) {
-    rhs->Redirect(lhs);
+    rhs->Redirect(lhs, trail);
     return true;
   }
 
@@ -280,7 +406,7 @@ bool FeatureStructure::Unify(boost::shared_ptr<FeatureStructure> &lhs,
       // has been left in defensively.
       return false;
     }
-    lhs->Redirect(rhs);
+    lhs->Redirect(rhs, trail);
     return true;
   } else if (rhs_content->IsAtomic()) {
     return false;
@@ -299,8 +425,11 @@ bool FeatureStructure::Unify(boost::shared_ptr<FeatureStructure> &lhs,
     if (rhs_fs.get() == 0) {  // Didn't previously exist.
       // FIXME Is this OK?  Or should we create an empty FS then unify?  (I
       // think it's OK since the feature structures are acyclic.)
+      if (trail) {
+        trail->RecordInsert(*rhs_bearer, f);
+      }
       rhs_fs = lhs_fs;
-    } else if (!Unify(lhs_fs, rhs_fs)) {
+    } else if (!Unify(lhs_fs, rhs_fs, trail)) {
       return false;
     }
   }
@@ -308,7 +437,7 @@ bool FeatureStructure::Unify(boost::shared_ptr<FeatureStructure> &lhs,
   // FIXME Should lhs->forward_ be adjusted before the for loop?  (I
   // think it's OK since the feature structures are acyclic: nothing 'inside'
   // lhs_content or rhs_content can .)
-  lhs->Redirect(rhs);
+  lhs->Redirect(rhs, trail);
 
   return true;
 }
@@ -360,28 +489,65 @@ bool FeatureStructure::PossiblyUnifiable(
   return true;
 }
 
+void FeatureStructure::DechainAll() const {
+  boost::unordered_set<const FeatureStructure *> visited;
+  std::vector<const FeatureStructure *> stack(1, this);
+  while (!stack.empty()) {
+    const FeatureStructure *node = stack.back();
+    stack.pop_back();
+    if (!visited.insert(node).second) {
+      continue;
+    }
+    if (node->forward_) {
+      node->Dechain();
+      stack.push_back(node->GetContentBearer());
+      continue;
+    }
+    for (internal::FSContent::Map::const_iterator p = node->content_.c.begin();
+         p != node->content_.c.end(); ++p) {
+      stack.push_back(p->second.get());
+    }
+  }
+}
+
 boost::shared_ptr<FeatureStructure> FeatureStructure::GetForwardTarget() const {
   if (forward_) {
     Dechain();
-    return forward_;
+    if (!forward_->forward_) {
+      return forward_;
+    }
+    // The chain passes through a trailed feature structure.
+    boost::shared_ptr<FeatureStructure> target = forward_;
+    while (target->forward_) {
+      target = target->forward_;
+    }
+    return target;
   }
   // TODO Just return forward_?
   return boost::shared_ptr<FeatureStructure>();
 }
 
-internal::FSContent *FeatureStructure::GetContent() const {
-  if (forward_) {
-    Dechain();
-    return forward_->content_;
+FeatureStructure *FeatureStructure::GetContentBearer() const {
+  if (!forward_) {
+    return const_cast<FeatureStructure *>(this);
+  }
+  Dechain();
+  FeatureStructure *target = forward_.get();
+  while (target->forward_) {
+    target = target->forward_.get();
   }
-  return content_;
+  return target;
+}
+
+internal::FSContent *FeatureStructure::GetContent() const {
+  return &GetContentBearer()->content_;
 }
 
 void FeatureStructure::Dechain() const {
   if (!forward_) {
     return;
   }
-  while (forward_->forward_) {
+  while (forward_->forward_ && !forward_->trailed_) {
     forward_ = forward_->forward_;
   }
 }
@@ -393,7 +559,13 @@ boost::shared_ptr<FeatureStructure> FeatureStructure::CreateAtomicValue(
     FeaturePath::const_iterator end,
     AtomicValue atom) {
 
-  if (content_->IsAtomic()) {
+  // An enclosing value may have been unified since the path was last walked,
+  // in which case its content lives in the forward target.
+  if (forward_) {
+    return GetForwardTarget()->CreateAtomicValue(begin, end, atom);
+  }
+
+  if (content_.IsAtomic()) {
     std::ostringstream msg;
     msg << "FeatureStructure::CreateAtomicValue() called on atomic feature "
         << "structure";
@@ -411,14 +583,10 @@ boost::shared_ptr<FeatureStructure> FeatureStructure::CreateAtomicValue(
   if (begin == end) {
     // f is the last feature in the path.  Insert the value into this
     // feature structure's content object.
-    boost::shared_ptr<FeatureStructure> value(new FeatureStructure());
-    if (atom == kNullAtom) {
-      value->content_ = new internal::FSContent();
-    } else {
-      value->content_ = new internal::FSContent(atom);
-    }
+    boost::shared_ptr<FeatureStructure> value = NewNode();
+    value->content_.a = atom;
     std::pair<internal::FSContent::Map::iterator, bool> result;
-    result = content_->c.insert(std::make_pair(f, value));
+    result = content_.c.insert(std::make_pair(f, value));
     // TODO Exception?
     assert(result.second);
     return value;
@@ -426,12 +594,11 @@ boost::shared_ptr<FeatureStructure> FeatureStructure::CreateAtomicValue(
 
   // Recursive step.
   boost::shared_ptr<FeatureStructure> inner;
-  internal::FSContent::Map::iterator i = content_->c.find(f);
+  internal::FSContent::Map::iterator i = content_.c.find(f);
   // TODO Fix double lookup
-  if (i == content_->c.end()) {
-    inner.reset(new FeatureStructure());
-    inner->content_ = new internal::FSContent();
-    content_->c[f] = inner;
+  if (i == content_.c.end()) {
+    inner = NewNode();
+    content_.c[f] = inner;
   } else {
     inner = i->second;
     if (inner->IsAtomic()) {
@@ -465,13 +632,13 @@ void FeatureStructure::SetForwardPtr(
   if (p != cc->c.end()) {
     inner = p->second.get();
   } else {
-    inner = new FeatureStructure();
-    cc->c[f] = boost::shared_ptr<FeatureStructure>(inner);
+    boost::shared_ptr<FeatureStructure> node = NewNode();
+    cc->c[f] = node;
+    inner = node.get();
     if (begin == end) {
       inner->forward_ = fwd_ptr;
       return;
     }
-    inner->content_ = new internal::FSContent();
   }
   inner->SetForwardPtr(begin, end, fwd_ptr);
 }
@@ -496,6 +663,315 @@ boost::shared_ptr<FeatureStructure> FeatureStructure::GetContentBearingFS(
   }
 }
 
+void UnificationTrail::RecordForward(FeatureStructure &fs) {
+  records_.push_back(Record());
+  Record &record = records_.back();
+  record.type = kForward;
+  record.fs = &fs;
+  record.old_forward = fs.forward_;
+  ++fs.trailed_;
+}
+
+void UnificationTrail::RecordContent(FeatureStructure &fs) {
+  records_.push_back(Record());
+  Record &record = records_.back();
+  record.type = kContent;
+  record.fs = &fs;
+  // Take ownership of the content (leaving fs with empty content).
+  std::swap(record.old_content, fs.content_);
+}
+
+void UnificationTrail::RecordInsert(FeatureStructure &fs, Feature f) {
+  records_.push_back(Record());
+  Record &record = records_.back();
+  record.type = kInsert;
+  record.fs = &fs;
+  record.feature = f;
+}
+
+void UnificationTrail::Rollback(std::size_t checkpoint) {
+  assert(checkpoint <= records_.size());
+  while (records_.size() > checkpoint) {
+    Record &record = records_.back();
+    FeatureStructure &fs = *record.fs;
+    if (record.type == kForward) {
+      fs.forward_ = record.old_forward;
+      --fs.trailed_;
+    } else if (record.type == kContent) {
+      std::swap(fs.content_, record.old_content);
+    } else {
+      fs.content_.c.erase(record.feature);
+    }
+    records_.pop_back();
+  }
+}
+
+void UnificationTrail::Commit() {
+  for (std::vector<Record>::iterator p = records_.begin();
+       p != records_.end(); ++p) {
+    if (p->type == kForward) {
+      --p->fs->trailed_;
+    }
+  }
+  records_.clear();
+}
+
+QuasiDestructiveUnifier::QuasiDestructiveUnifier()
+    : table_(64)
+    , size_(0)
+    , generation_(1) {
+}
+
+void QuasiDestructiveUnifier::Reset() {
+  if (++generation_ == 0) {
+    // The generation counter has wrapped around so stale entries could be
+    // mistaken for valid ones.
+    for (std::vector<Entry>::iterator p = table_.begin(); p != table_.end();
+         ++p) {
+      p->generation = 0;
+    }
+    generation_ = 1;
+  }
+  size_ = 0;
+  arcs_.clear();
+  copies_.clear();
+}
+
+bool QuasiDestructiveUnifier::Unify(const Node &lhs, const Node &rhs) {
+  return UnifyNodes(lhs, rhs);
+}
+
+bool QuasiDestructiveUnifier::IsUnifiable(const FeatureStructure &lhs,
+                                          const FeatureStructure &rhs) {
+  Reset();
+  return UnifyNodes(Node(lhs, kLhsInstance), Node(rhs, kRhsInstance));
+}
+
+boost::shared_ptr<FeatureStructure> QuasiDestructiveUnifier::UnifyAndCopy(
+    const FeatureStructure &lhs, const FeatureStructure &rhs) {
+  Reset();
+  if (!UnifyNodes(Node(lhs, kLhsInstance), Node(rhs, kRhsInstance))) {
+    return boost::shared_ptr<FeatureStructure>();
+  }
+  return Copy(Node(rhs, kRhsInstance));
+}
+
+QuasiDestructiveUnifier::Node QuasiDestructiveUnifier::Get(
+    const Node &root,
+    FeaturePath::const_iterator begin,
+    FeaturePath::const_iterator end) const {
+  Node node = Deref(root);
+  for (FeaturePath::const_iterator p = begin; p != end; ++p) {
+    Node value = GetValue(node, *p);
+    if (!value.fs) {
+      return value;
+    }
+    node = Deref(value);
+  }
+  return node;
+}
+
+boost::shared_ptr<FeatureStructure> QuasiDestructiveUnifier::Copy(
+    const Node &root) {
+  Node node = Deref(root);
+  int arcs;
+  {
+    Entry &entry = FindOrInsert(node);
+    if (entry.copy >= 0) {
+      return copies_[entry.copy];
+    }
+    entry.copy = copies_.size();
+    arcs = entry.arcs;
+  }
+  boost::shared_ptr<FeatureStructure> clone = FeatureStructure::NewNode();
+  copies_.push_back(clone);
+  const internal::FSContent &content = node.fs->content_;
+  if (content.IsAtomic()) {
+    clone->content_.a = content.a;
+    return clone;
+  }
+  internal::FSContent::Map &map = clone->content_.c;
+  map.reserve(content.c.size());
+  for (internal::FSContent::Map::const_iterator p = content.c.begin();
+       p != content.c.end(); ++p) {
+    Node value(*p->second, node.instance);
+    map.insert(map.end(), std::make_pair(p->first, Copy(value)));
+  }
+  for (int i = arcs; i >= 0; i = arcs_[i].next) {
+    map.insert(std::make_pair(arcs_[i].feature, Copy(arcs_[i].value)));
+  }
+  return clone;
+}
+
+QuasiDestructiveUnifier::Node QuasiDestructiveUnifier::Deref(Node node) const {
+  for (;;) {
+    while (node.fs->forward_) {
+      node.fs = node.fs->forward_.get();
+    }
+    const Entry *entry = Find(node);
+    if (!entry || !entry->forward.fs) {
+      return node;
+    }
+    node = entry->forward;
+  }
+}
+
+std::size_t QuasiDestructiveUnifier::Slot(const Node &node) const {
+  std::size_t h = reinterpret_cast<std::size_t>(node.fs) ^ node.instance;
+  h ^= h >> 16;
+  h *= 0x45d9f3bu;
+  h ^= h >> 16;
+  return h & (table_.size() - 1);
+}
+
+const QuasiDestructiveUnifier::Entry *QuasiDestructiveUnifier::Find(
+    const Node &node) const {
+  // Within a generation, entries are only ever added so the probe sequence
+  // ends at the first slot belonging to an earlier generation.
+  std::size_t mask = table_.size() - 1;
+  for (std::size_t i = Slot(node); ; i = (i + 1) & mask) {
+    const Entry &entry = table_[i];
+    if (entry.generation != generation_) {
+      return 0;
+    }
+    if (entry.node == node) {
+      return &entry;
+    }
+  }
+}
+
+QuasiDestructiveUnifier::Entry &QuasiDestructiveUnifier::FindOrInsert(
+    const Node &node) {
+  if ((size_ + 1) * 2 > table_.size()) {
+    Grow();
+  }
+  std::size_t mask = table_.size() - 1;
+  for (std::size_t i = Slot(node); ; i = (i + 1) & mask) {
+    Entry &entry = table_[i];
+    if (entry.generation != generation_) {
+      entry.node = node;
+      entry.generation = generation_;
+      entry.forward = Node();
+      entry.arcs = -1;
+      entry.copy = -1;
+      ++size_;
+      return entry;
+    }
+    if (entry.node == node) {
+      return entry;
+    }
+  }
+}
+
+void QuasiDestructiveUnifier::Grow() {
+  std::vector<Entry> old_table(table_.size() * 2);
+  old_table.swap(table_);
+  std::size_t mask = table_.size() - 1;
+  for (std::vector<Entry>::const_iterator p = old_table.begin();
+       p != old_table.end(); ++p) {
+    if (p->generation != generation_) {
+      continue;
+    }
+    std::size_t i = Slot(p->node);
+    while (table_[i].generation == generation_) {
+      i = (i + 1) & mask;
+    }
+    table_[i] = *p;
+  }
+}
+
+QuasiDestructiveUnifier::Node QuasiDestructiveUnifier::GetValue(
+    const Node &node, Feature f) const {
+  const internal::FSContent::Map &map = node.fs->content_.c;
+  internal::FSContent::Map::const_iterator p = map.find(f);
+  if (p != map.end()) {
+    return Node(*p->second, node.instance);
+  }
+  const Entry *entry = Find(node);
+  if (entry) {
+    for (int i = entry->arcs; i >= 0; i = arcs_[i].next) {
+      if (arcs_[i].feature == f) {
+        return arcs_[i].value;
+      }
+    }
+  }
+  return Node();
+}
+
+bool QuasiDestructiveUnifier::UnifyNodes(Node lhs, Node rhs) {
+  lhs = Deref(lhs);
+  rhs = Deref(rhs);
+
+  // If the feature structures are already unified then there is nothing to do.
+  if (lhs == rhs) {
+    return true;
+  }
+
+  const internal::FSContent &lhs_content = lhs.fs->content_;
+  const internal::FSContent &rhs_content = rhs.fs->content_;
+  const Entry *lhs_entry = Find(lhs);
+  const Entry *rhs_entry = Find(rhs);
+  int lhs_arcs = lhs_entry ? lhs_entry->arcs : -1;
+  int rhs_arcs = rhs_entry ? rhs_entry->arcs : -1;
+
+  // Check for the case that one or both values are empty.
+  if (lhs_content.Empty() && lhs_arcs < 0) {
+    FindOrInsert(lhs).forward = rhs;
+    return true;
+  } else if (rhs_content.Empty() && rhs_arcs < 0) {
+    FindOrInsert(rhs).forward = lhs;
+    return true;
+  }
+
+  // Atomic case.
+  if (lhs_content.IsAtomic()) {
+    if (rhs_content.IsComplex() || lhs_content.a != rhs_content.a) {
+      return false;
+    }
+    FindOrInsert(lhs).forward = rhs;
+    return true;
+  } else if (rhs_content.IsAtomic()) {
+    return false;
+  }
+
+  // Complex case.  The forward pointer is set first so that from now on the
+  // lhs's values (and any arcs that are added to it) are found via the rhs.
+  FindOrInsert(lhs).forward = rhs;
+  internal::FSContent::Map::const_iterator p;
+  internal::FSContent::Map::const_iterator end = lhs_content.c.end();
+  for (p = lhs_content.c.begin(); p != end; ++p) {
+    if (!UnifyValue(rhs, p->first, Node(*p->second, lhs.instance))) {
+      return false;
+    }
+  }
+  for (int i = lhs_arcs; i >= 0; i = arcs_[i].next) {
+    // Copy the arc since arcs_ can be reallocated by UnifyValue().
+    Arc arc = arcs_[i];
+    if (!UnifyValue(rhs, arc.feature, arc.value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool QuasiDestructiveUnifier::UnifyValue(Node node, Feature f,
+                                         const Node &value) {
+  node = Deref(node);
+  Node existing = GetValue(node, f);
+  if (existing.fs) {
+    return UnifyNodes(value, existing);
+  }
+  // Add a complement arc.
+  Arc arc;
+  arc.feature = f;
+  arc.value = value;
+  Entry &entry = FindOrInsert(node);
+  arc.next = entry.arcs;
+  entry.arcs = arcs_.size();
+  arcs_.push_back(arc);
+  return true;
+}
+
 namespace internal {
 
 bool FSContent::EffectivelyEmpty() const {
@@ -511,35 +987,38 @@ bool FSContent::EffectivelyEmpty() const {
   return true;
 }
 
-FSContent *FSContent::Clone(FeatureStructure::CloneMap &clone_map) const {
-  typedef FeatureStructure::CloneMap CloneMap;
+void FSContent::Clone(FSContent &clone, CloneMap &clone_map) const {
+  clone.a = a;
   if (a != kNullAtom) {
-    return new FSContent(a);
+    return;
   }
-  FSContent *clone = new FSContent();
-  clone->c.reserve(c.size());
+  clone.c.reserve(c.size());
   for (Map::const_iterator p = c.begin(); p != c.end(); ++p) {
     Feature f = p->first;
-    boost::shared_ptr<FeatureStructure> orig_fs = p->second;
+    const boost::shared_ptr<FeatureStructure> &orig_fs = p->second;
+    // If this map holds the only reference to orig_fs then it can't be
+    // reached by any other route, so there's no need to record its clone.
+    if (orig_fs.unique()) {
+      clone.c.insert(clone.c.end(), std::make_pair(f, orig_fs->Clone(clone_map)));
+      continue;
+    }
     CloneMap::value_type x(orig_fs, boost::shared_ptr<FeatureStructure>());
     std::pair<CloneMap::iterator, bool> result = clone_map.insert(x);
     if (result.second) {  // orig_fs was not already in clone_map
       result.first->second = orig_fs->Clone(clone_map);
     }
-    clone->c.insert(std::make_pair(f, result.first->second));
+    clone.c.insert(clone.c.end(), std::make_pair(f, result.first->second));
   }
-  return clone;
 }
 
 // TODO Rewrite this to avoid map lookup
-FSContent *FSContent::SelectiveClone(
-    const FeatureTree &tree,
-    FeatureStructure::CloneMap &clone_map) const {
+void FSContent::SelectiveClone(const FeatureTree &tree, FSContent &clone,
+                               CloneMap &clone_map) const {
   assert(!tree.Empty());
+  clone.a = a;
   if (a != kNullAtom) {
-    return new FSContent(a);
+    return;
   }
-  FSContent *clone = new FSContent();
   for (Map::const_iterator p = c.begin(); p != c.end(); ++p) {
     Feature f = p->first;
     // TODO Shouldn't be doing a map lookup here.  Should be jointly iterating
@@ -551,7 +1030,7 @@ FSContent *FSContent::SelectiveClone(
     const FeatureTree &sub_tree = *(child_iter->second);
     boost::shared_ptr<FeatureStructure> orig_fs = p->second;
     boost::shared_ptr<FeatureStructure> clone_fs;
-    FeatureStructure::CloneMap::iterator q = clone_map.find(orig_fs);
+    CloneMap::iterator q = clone_map.find(orig_fs);
     if (q == clone_map.end()) {
       if (sub_tree.Empty()) {
         clone_fs = orig_fs->Clone(clone_map);
@@ -562,9 +1041,8 @@ FSContent *FSContent::SelectiveClone(
     } else {
       clone_fs = q->second;
     }
-    clone->c.insert(std::make_pair(f, clone_fs));
+    clone.c.insert(std::make_pair(f, clone_fs));
   }
-  return clone;
 }
 
 bool ComplexContentValueOrderer::operator()(
@@ -600,6 +1078,188 @@ bool BadFeatureStructureOrderer::operator()(const FeatureStructure &a,
   return orderer(*(a.GetContent()), *(b.GetContent()));
 }
 
+void ProjectionEncoder::Reset() {
+  visits_.clear();
+  encoding_.clear();
+}
+
+void ProjectionEncoder::Add(const FeatureStructure &fs,
+                            const FeatureTree &tree) {
+  Encode(fs, tree.Empty() ? 0 : &tree);
+}
+
+void ProjectionEncoder::Encode(const FeatureStructure &fs,
+                               const FeatureTree *tree) {
+  // Follow forward pointers without compressing them, so that shared feature
+  // structures are not modified.
+  const FeatureStructure *bearer = &fs;
+  while (bearer->forward_) {
+    bearer = bearer->forward_.get();
+  }
+
+  std::pair<boost::unordered_map<const FeatureStructure *, Visit>::iterator,
+            bool> result = visits_.insert(
+      std::make_pair(bearer, Visit(visits_.size(), tree)));
+  if (result.second) {
+    EncodeContent(*bearer, tree);
+    return;
+  }
+
+  // The value has been reached before.  If it was encoded in full, or with
+  // the same tree, then a reference is sufficient.  Otherwise this path may
+  // select values that the first did not, so they are encoded too.
+  const Visit &visit = result.first->second;
+  if (visit.second == 0 || visit.second == tree) {
+    encoding_.push_back(kReference);
+    encoding_.push_back(visit.first);
+  } else {
+    encoding_.push_back(kReferenceWithContent);
+    encoding_.push_back(visit.first);
+    EncodeContent(*bearer, tree);
+  }
+}
+
+void ProjectionEncoder::EncodeContent(const FeatureStructure &fs,
+                                      const FeatureTree *tree) {
+  const internal::FSContent &content = fs.content_;
+  if (content.IsAtomic()) {
+    encoding_.push_back(kAtomic);
+    encoding_.push_back(content.a);
+    return;
+  }
+  encoding_.push_back(kComplex);
+  std::size_t count_pos = encoding_.size();
+  encoding_.push_back(0);
+  boost::uint32_t count = 0;
+  for (internal::FSContent::Map::const_iterator p = content.c.begin();
+       p != content.c.end(); ++p) {
+    const FeatureTree *sub_tree = 0;
+    if (tree) {
+      FeatureTree::ChildMap::const_iterator q = tree->children_.find(p->first);
+      if (q == tree->children_.end()) {
+        continue;
+      }
+      if (!q->second->Empty()) {
+        sub_tree = q->second.get();
+      }
+    }
+    encoding_.push_back(p->first);
+    Encode(*p->second, sub_tree);
+    ++count;
+  }
+  encoding_[count_pos] = count;
+}
+
+namespace {
+
+enum CanonicalTag {
+  kCanonicalAtomic,
+  kCanonicalComplex,
+  kCanonicalReference,
+};
+
+typedef boost::unordered_map<const FeatureStructure *, std::size_t>
+    NumberMap;
+
+}  // namespace
+
+// Helpers for FeatureStructureHasher and FeatureStructureEqualityPred.  They
+// follow forward pointers without compressing them, so that shared feature
+// structures are not modified.
+class FeatureStructureCanonicalizer {
+ public:
+  static const FeatureStructure *Bearer(const FeatureStructure &fs) {
+    const FeatureStructure *bearer = &fs;
+    while (bearer->forward_) {
+      bearer = bearer->forward_.get();
+    }
+    return bearer;
+  }
+
+  static void Hash(const FeatureStructure &fs, NumberMap &numbers,
+                   std::size_t &seed) {
+    const FeatureStructure *bearer = Bearer(fs);
+    std::pair<NumberMap::iterator, bool> result =
+        numbers.insert(std::make_pair(bearer, numbers.size()));
+    if (!result.second) {
+      boost::hash_combine(seed, static_cast<int>(kCanonicalReference));
+      boost::hash_combine(seed, result.first->second);
+      return;
+    }
+    const internal::FSContent &content = bearer->content_;
+    if (content.IsAtomic()) {
+      boost::hash_combine(seed, static_cast<int>(kCanonicalAtomic));
+      boost::hash_combine(seed, content.a);
+      return;
+    }
+    boost::hash_combine(seed, static_cast<int>(kCanonicalComplex));
+    boost::hash_combine(seed, content.c.size());
+    for (internal::FSContent::Map::const_iterator p = content.c.begin();
+         p != content.c.end(); ++p) {
+      boost::hash_combine(seed, p->first);
+      Hash(*p->second, numbers, seed);
+    }
+  }
+
+  static bool Equal(const FeatureStructure &x, const FeatureStructure &y,
+                    NumberMap &x_numbers, NumberMap &y_numbers) {
+    const FeatureStructure *x_bearer = Bearer(x);
+    const FeatureStructure *y_bearer = Bearer(y);
+    NumberMap::const_iterator p = x_numbers.find(x_bearer);
+    NumberMap::const_iterator q = y_numbers.find(y_bearer);
+    if (p != x_numbers.end() || q != y_numbers.end()) {
+      // At least one value has been reached before.  They're only equal if
+      // both have and they were first reached at the same point.
+      return p != x_numbers.end() && q != y_numbers.end() &&
+             p->second == q->second;
+    }
+    std::size_t number = x_numbers.size();
+    x_numbers[x_bearer] = number;
+    y_numbers[y_bearer] = number;
+    const internal::FSContent &x_content = x_bearer->content_;
+    const internal::FSContent &y_content = y_bearer->content_;
+    if (x_content.a != y_content.a || x_content.c.size() != y_content.c.size()) {
+      return false;
+    }
+    internal::FSContent::Map::const_iterator r = x_content.c.begin();
+    internal::FSContent::Map::const_iterator s = y_content.c.begin();
+    for (; r != x_content.c.end(); ++r, ++s) {
+      if (r->first != s->first ||
+          !Equal(*r->second, *s->second, x_numbers, y_numbers)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+std::size_t FeatureStructureHasher::operator()(
+    const FeatureStructure &x) const {
+  NumberMap numbers;
+  std::size_t seed = 0;
+  FeatureStructureCanonicalizer::Hash(x, numbers, seed);
+  return seed;
+}
+
+bool FeatureStructureEqualityPred::operator()(
+    const FeatureStructure &x, const FeatureStructure &y) const {
+  NumberMap x_numbers;
+  NumberMap y_numbers;
+  return FeatureStructureCanonicalizer::Equal(x, y, x_numbers, y_numbers);
+}
+
+std::size_t CachingFeatureStructureHasher::operator()(
+    const FeatureStructure &x) const {
+  boost::unordered_map<const FeatureStructure *, std::size_t>::const_iterator
+      p = cache_.find(&x);
+  if (p != cache_.end()) {
+    return p->second;
+  }
+  std::size_t hash = FeatureStructureHasher()(x);
+  cache_[&x] = hash;
+  return hash;
+}
+
 std::size_t BadFeatureStructureHasher::operator()(
     const FeatureStructure &x) const {
   internal::FSContentHasher contentHasher;
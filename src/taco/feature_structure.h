@@ -2,6 +2,7 @@
 #define TACO_SRC_TACO_FEATURE_STRUCTURE_H_
 
 #include <map>
+#include <vector>
 
 #include <boost/container/flat_map.hpp>
 #include <boost/shared_ptr.hpp>
@@ -16,9 +17,36 @@
 
 namespace taco {
 
+class FeatureStructure;
+class UnificationTrail;
+
 namespace internal {
-struct FSContent;
-}
+
+typedef boost::unordered_map<boost::shared_ptr<FeatureStructure>,
+                             boost::shared_ptr<FeatureStructure> > CloneMap;
+
+// The content of a content-bearing FeatureStructure: either an atomic value or
+// a (possibly empty) mapping from features to values.  FSContent objects are
+// stored inline in their owning FeatureStructure, so creating a node costs a
+// single allocation (plus one for the map's storage if it is non-empty).
+struct FSContent {
+  typedef boost::container::flat_map<Feature,
+                                     boost::shared_ptr<FeatureStructure> > Map;
+  FSContent() : a(kNullAtom) {}
+  FSContent(AtomicValue x) : a(x) {}
+  bool IsAtomic() const { return a != kNullAtom; }
+  bool IsComplex() const { return a == kNullAtom; }
+  bool Empty() const { return a == kNullAtom ? c.empty() : false; }
+  bool EffectivelyEmpty() const;
+  // Resets this object to the empty state, releasing any values.
+  void Clear() { c.clear(); a = kNullAtom; }
+  void Clone(FSContent &, CloneMap &) const;
+  void SelectiveClone(const FeatureTree &, FSContent &, CloneMap &) const;
+  Map c;
+  AtomicValue a;
+};
+
+}  // namespace internal
 
 // Represents an untyped, acyclic feature structure as in the PATR-II
 // formalism (Shieber, 1986).  Feature structures are represented as nodes
@@ -29,7 +57,9 @@ struct FSContent;
 // there is only one level of indirection, but chaining of forward pointers can
 // occur can as a natural result of the unification algorithm.  Chains will be
 // eliminated as early as possible.
-// TODO note about use of shared_ptr
+// Nodes are always owned through boost::shared_ptr.  Nodes created internally
+// (by cloning, unification, etc.) are allocated together with their reference
+// count and content in a single block.
 // TODO *might* represent atomic and complex feature structures as separate
 // classes since most operations only make sense for one type.
 class FeatureStructure {
@@ -56,7 +86,16 @@ class FeatureStructure {
   // iff its feature path is present in the given FeatureTree.  The FeatureTree
   // must be non-empty.
   boost::shared_ptr<FeatureStructure> SelectiveClone(const FeatureTree &) const;
- 
+
+  // Produces a copy of this FeatureStructure that shares structure with the
+  // original.  Values whose feature paths are in the given FeatureTree are
+  // copied (values at the tree's leaves are deep-copied) and all other values
+  // are shared with the original.  The shared values must not be modified,
+  // so this is only useful if the copy will only be modified along the paths
+  // in the tree.  If the FeatureTree is empty or if this FeatureStructure
+  // contains reentrancy then the result is a full Clone().
+  boost::shared_ptr<FeatureStructure> PartialClone(const FeatureTree &) const;
+
   bool IsAtomic() const;
   bool IsComplex() const;
   bool IsEmpty() const;
@@ -85,6 +124,17 @@ class FeatureStructure {
     FeaturePath::const_iterator begin,
     FeaturePath::const_iterator end) const;
 
+  // Non-owning form of Get().  This returns a raw pointer to the
+  // content-bearing value at the path (or 0 if there isn't one) and, unlike
+  // Get(), neither copies shared pointers nor shortens chains of forward
+  // pointers along the way, so it is cheaper and can be used on feature
+  // structures that are shared between threads.  The pointer is valid for
+  // as long as the value remains part of this feature structure.  As for
+  // Get(), an exception is thrown if the path is empty or passes through an
+  // atomic value.
+  const FeatureStructure *Find(FeaturePath::const_iterator begin,
+                               FeaturePath::const_iterator end) const;
+
   // Return the atomic value associated with this feature structure.
   AtomicValue GetAtomicValue() const;
 
@@ -117,23 +167,64 @@ class FeatureStructure {
   static bool Unify(boost::shared_ptr<FeatureStructure> &,
                     boost::shared_ptr<FeatureStructure> &);
 
+  // As above, except that every modification is recorded in the given trail
+  // so that the unification can be undone (whether it succeeded or not) by
+  // calling UnificationTrail::Rollback().
+  static bool Unify(boost::shared_ptr<FeatureStructure> &,
+                    boost::shared_ptr<FeatureStructure> &,
+                    UnificationTrail &);
+
+  // Attempts to unify two feature structures.  Returns true on success, in
+  // which case the result is the same as for Unify().  If unification fails
+  // then both feature structures are restored to their original states.  The
+  // cost of restoration is proportional to the number of changes made before
+  // the failure was detected.
+  static bool UnifyOrRollback(boost::shared_ptr<FeatureStructure> &,
+                              boost::shared_ptr<FeatureStructure> &);
+
   // Performs a cheap, non-destructive test to determine if unficiation between
   // this feature structure and another might succeed.  The test can produce
   // false positives, but not false negatives.
   bool PossiblyUnifiable(boost::shared_ptr<const FeatureStructure>) const;
 
+  // Shortens every chain of forward pointers in this feature structure to a
+  // single pointer.  Const member functions such as Clone() and Get()
+  // shorten chains as they pass, so until this has been called they modify
+  // the feature structure.  Afterwards (and until the next unification) they
+  // do not, so the feature structure can be read from several threads at
+  // once.
+  void DechainAll() const;
+
   //bool subsumes(const FeatureStructure &) const;
 
  private:
   friend struct internal::FSContent;
+  friend class BinaryLexicon;
+  friend class BinaryLexiconWriter;
+  friend class UnificationTrail;
+  friend class QuasiDestructiveUnifier;
+  friend class BitsetLayout;
+  friend class FeatureStructureInterner;
+  friend class ProjectionEncoder;
+  friend class FeatureStructureCanonicalizer;
   friend class BadFeatureStructureOrderer;
   friend class BadFeatureStructureHasher;
   friend class BadFeatureStructureEqualityPred;
+  friend class FeatureStructureParser;
+
+  typedef internal::CloneMap CloneMap;
 
-  typedef boost::unordered_map<boost::shared_ptr<FeatureStructure>,
-                               boost::shared_ptr<FeatureStructure> > CloneMap;
+  // Restricts use of the public tag constructor to FeatureStructure itself.
+  struct PrivateTag {};
 
-  FeatureStructure() : content_(0) {}
+ public:
+  // For internal use only (the tag type is private).  Allows nodes to be
+  // created by boost::make_shared.
+  explicit FeatureStructure(PrivateTag) : trailed_(0) {}
+
+ private:
+  // Allocates a new, empty, content-bearing node.
+  static boost::shared_ptr<FeatureStructure> NewNode();
 
   // Copying is not allowed
   FeatureStructure(const FeatureStructure &);
@@ -146,19 +237,42 @@ class FeatureStructure {
   boost::shared_ptr<FeatureStructure> SelectiveClone(const FeatureTree &,
                                                      CloneMap &) const;
 
+  // Implements the public PartialClone() function for a non-empty tree.
+  // Requires that this feature structure is tree-shaped.
+  boost::shared_ptr<FeatureStructure> CopyPaths(const FeatureTree &) const;
+
+  // Returns true if every value in this feature structure is reachable by
+  // exactly one path, i.e. if there are no forward pointers and no value is
+  // referenced by more than one feature.  Values may be shared with other
+  // feature structures.
+  bool IsTreeShaped() const;
+
+  // Appends this feature structure's values to the vector, recursively.
+  // Returns false if a forward pointer is found.
+  bool CollectTreeNodes(std::vector<const FeatureStructure *> &) const;
+
   // Returns a pointer to the content-bearing feature structure at the end of
   // the chain of forward pointers.  Returns an empty pointer if this is
   // not a forwarding feature structure.
   boost::shared_ptr<FeatureStructure> GetForwardTarget() const;
 
+  // Returns a raw pointer to the content-bearing feature structure at the end
+  // of the chain of forward pointers, or to this feature structure if it is
+  // content-bearing.
+  FeatureStructure *GetContentBearer() const;
+
   // Gets a pointer to the FSContent object owned by either this feature
   // structure or the feature structure at the end of the forwarding
-  // chain.
+  // chain.  The content of a forwarding feature structure is unused (and is
+  // always empty).
   internal::FSContent *GetContent() const;
 
   // Follows the chain of forward pointers and replaces forward_ with a
   // direct pointer to the content-bearing feature structure.  Has no effect
-  // if this is content-bearing feature structure.
+  // if this is content-bearing feature structure.  The chain is not
+  // shortened past a feature structure whose forward pointer is recorded in a
+  // UnificationTrail, since rolling back the trail would then leave this
+  // feature structure forwarding to the wrong place.
   void Dechain() const;
 
   // Sets the forward pointer of the feature structure at the path
@@ -177,17 +291,288 @@ class FeatureStructure {
     FeaturePath::const_iterator begin,
     FeaturePath::const_iterator end);
 
+  // Implements the public Unify() functions.  The trail may be null.
+  static bool Unify(boost::shared_ptr<FeatureStructure> &,
+                    boost::shared_ptr<FeatureStructure> &,
+                    UnificationTrail *);
+
   // Modifies this feature structure so that it forwards to the given FS.
   // If this FS already forwards to another FS then the latter is also
-  // updated.
-  void Redirect(boost::shared_ptr<FeatureStructure> &);
+  // updated.  If the trail is non-null then the changes are recorded.
+  void Redirect(boost::shared_ptr<FeatureStructure> &, UnificationTrail *);
 
   mutable boost::shared_ptr<FeatureStructure> forward_;
-  internal::FSContent *content_;
+  internal::FSContent content_;
+  // The number of records of forward_ in active UnificationTrails.
+  unsigned int trailed_;
+};
+
+// Records the modifications made to feature structures by one or more calls
+// to FeatureStructure::Unify() so that they can be undone.  Values that are
+// detached from a feature structure during unification are kept alive by the
+// trail.  Between unification and rollback, the feature structures can be
+// read but must not be modified except by further recorded unifications.  A
+// feature structure must not be recorded in more than one trail at a time.
+class UnificationTrail {
+ public:
+  UnificationTrail() {}
+
+  // Commits any recorded modifications.
+  ~UnificationTrail() { Commit(); }
+
+  bool IsEmpty() const { return records_.empty(); }
+
+  // Returns a checkpoint that can be passed to Rollback() to undo only the
+  // modifications recorded after this point.
+  std::size_t Checkpoint() const { return records_.size(); }
+
+  // Undoes all recorded modifications, most recent first.
+  void Rollback() { Rollback(0); }
+
+  // Undoes the modifications recorded since the given checkpoint.
+  void Rollback(std::size_t);
+
+  // Accepts all recorded modifications and clears the trail.
+  void Commit();
+
+ private:
+  friend class FeatureStructure;
+
+  enum RecordType {
+    kForward,  // fs->forward_ was changed from old_forward.
+    kContent,  // fs->content_ was replaced (old_content holds the original).
+    kInsert    // feature was inserted into fs->content_.c.
+  };
+
+  struct Record {
+    RecordType type;
+    FeatureStructure *fs;
+    boost::shared_ptr<FeatureStructure> old_forward;
+    internal::FSContent old_content;
+    Feature feature;
+  };
+
+  // Copying is not allowed
+  UnificationTrail(const UnificationTrail &);
+  UnificationTrail &operator=(const UnificationTrail &);
+
+  void RecordForward(FeatureStructure &);
+  void RecordContent(FeatureStructure &);
+  void RecordInsert(FeatureStructure &, Feature);
+
+  std::vector<Record> records_;
+};
+
+// Unifies feature structures non-destructively using a variant of
+// Tomabechi's (1991) quasi-destructive algorithm.  Instead of modifying the
+// input feature structures, unification records temporary forward pointers
+// and complement arcs (features added to a value by unification) in a side
+// table owned by the unifier.  The input feature structures are never
+// modified, so nothing needs to be cloned before unification and a failed
+// unification leaves nothing to undo.  If the result is required then it can
+// be copied out of the table after unification succeeds.
+//
+// A sequence of Unify() calls forms a session: each call sees the effects of
+// the previous ones, which allows a set of equations to be tested together.
+// Reset() starts a new session.  Discarding the table's contents is a
+// constant-time operation (entries are stamped with a generation number and
+// the generation is incremented) and the storage is retained for the next
+// session, so once the unifier has warmed up a unification that fails
+// performs no memory allocation.
+//
+// Feature structures are addressed by Node, which pairs a feature structure
+// with an instance number.  Values reached from different instances are
+// treated as distinct, even if they are physically shared, exactly as if each
+// instance had been cloned before destructive unification.
+//
+// The unifier does not compress chains of forward pointers (see
+// FeatureStructure::Dechain()) so it can be used concurrently on shared
+// feature structures, provided each thread uses its own unifier and nothing
+// modifies the feature structures in the meantime.
+class QuasiDestructiveUnifier {
+ public:
+  struct Node {
+    Node() : fs(0), instance(0) {}
+    Node(const FeatureStructure &x, unsigned int i=0) : fs(&x), instance(i) {}
+    bool operator==(const Node &other) const {
+      return fs == other.fs && instance == other.instance;
+    }
+    const FeatureStructure *fs;
+    unsigned int instance;
+  };
+
+  QuasiDestructiveUnifier();
+
+  // Discards the effects of any previous unifications.
+  void Reset();
+
+  // Unifies two feature structures within the current session.  Returns true
+  // on success.  If unification fails then the session is left in an
+  // undefined state and must be Reset() before further use.
+  bool Unify(const Node &, const Node &);
+
+  // Resets the unifier and then tests whether the two feature structures are
+  // unifiable.  The two are distinct instances, so values that they
+  // physically share (interned values, for example) are not reentrant.
+  bool IsUnifiable(const FeatureStructure &, const FeatureStructure &);
+
+  // Resets the unifier, unifies the two feature structures and, if
+  // unification succeeds, returns a copy of the result.  Returns an empty
+  // pointer if unification fails.  As for IsUnifiable(), the two are
+  // distinct instances.
+  boost::shared_ptr<FeatureStructure> UnifyAndCopy(const FeatureStructure &,
+                                                   const FeatureStructure &);
+
+  // Gets the value at the given path within the current session.  If the path
+  // does not exist then the returned Node's fs member is 0.  If the path is
+  // empty then the dereferenced node is returned.
+  Node Get(const Node &, FeaturePath::const_iterator,
+           FeaturePath::const_iterator) const;
+
+  // Produces a deep copy of a feature structure as it stands in the current
+  // session.  The copy is completely independent of the original feature
+  // structures.  Values that are shared between nodes that are copied in the
+  // same session are also shared between the copies.
+  boost::shared_ptr<FeatureStructure> Copy(const Node &);
+
+ private:
+  // The instance numbers used by IsUnifiable() and UnifyAndCopy().
+  static const unsigned int kLhsInstance = 0;
+  static const unsigned int kRhsInstance = 1;
+
+  // A feature added to a complex feature structure during unification.
+  struct Arc {
+    Feature feature;
+    Node value;
+    int next;
+  };
+
+  // Temporary state for a single node.  An entry is only valid if its
+  // generation matches the unifier's current generation.
+  struct Entry {
+    Node node;
+    unsigned int generation;
+    Node forward;  // Temporary forward pointer (forward.fs is 0 if unset).
+    int arcs;      // Index of first Arc or -1.
+    int copy;      // Index into copies_ or -1.
+  };
+
+  // Copying is not allowed
+  QuasiDestructiveUnifier(const QuasiDestructiveUnifier &);
+  QuasiDestructiveUnifier &operator=(const QuasiDestructiveUnifier &);
+
+  Node Deref(Node) const;
+  const Entry *Find(const Node &) const;
+  Entry &FindOrInsert(const Node &);
+  std::size_t Slot(const Node &) const;
+  void Grow();
+  Node GetValue(const Node &, Feature) const;
+  bool UnifyNodes(Node, Node);
+  bool UnifyValue(Node, Feature, const Node &);
+
+  std::vector<Entry> table_;
+  std::size_t size_;
+  unsigned int generation_;
+  std::vector<Arc> arcs_;
+  std::vector<boost::shared_ptr<FeatureStructure> > copies_;
+};
+
+// Produces canonical encodings of feature structures restricted to the paths
+// of FeatureTrees.  Two sequences of feature structures (added in the same
+// order, with the same trees) have equal encodings iff they have the same
+// values at the paths in the trees, including the same reentrancy between
+// those values, whether within or across feature structures.  Values outside
+// of the trees are ignored.  A leaf of a tree stands for the whole value at
+// its path.
+//
+// Each value is numbered when it is first reached.  If it is reached again
+// then a reference to the number is encoded instead of the value, so the
+// encoding is linear in the size of the projected feature structures.
+class ProjectionEncoder {
+ public:
+  typedef std::vector<boost::uint32_t> Encoding;
+
+  ProjectionEncoder() {}
+
+  // Clears the encoding and forgets the values that have been numbered.
+  void Reset();
+
+  // Appends the encoding of the feature structure restricted to the paths in
+  // the tree.  An empty tree stands for the whole feature structure.
+  void Add(const FeatureStructure &, const FeatureTree &);
+
+  // Appends an arbitrary label, such as the index of the next feature
+  // structure.
+  void AddLabel(boost::uint32_t label) { encoding_.push_back(label); }
+
+  const Encoding &encoding() const { return encoding_; }
+
+ private:
+  enum Tag {
+    kAtomic,
+    kComplex,
+    kReference,
+    kReferenceWithContent,
+  };
+
+  // The number assigned to a value and the tree that it was first encoded
+  // with (0 meaning the whole value).
+  typedef std::pair<boost::uint32_t, const FeatureTree *> Visit;
+
+  // Copying is not allowed
+  ProjectionEncoder(const ProjectionEncoder &);
+  ProjectionEncoder &operator=(const ProjectionEncoder &);
+
+  void Encode(const FeatureStructure &, const FeatureTree *);
+  void EncodeContent(const FeatureStructure &, const FeatureTree *);
+
+  boost::unordered_map<const FeatureStructure *, Visit> visits_;
+  Encoding encoding_;
+};
+
+// Hash function for FeatureStructures that takes structure sharing into
+// account.  Values are numbered in the order in which a depth-first
+// traversal (in feature order) first reaches them and a value that is reached
+// again contributes its number instead of its content.  The result is a hash
+// of a canonical form of the feature structure, so feature structures that
+// are equal according to FeatureStructureEqualityPred have equal hashes, and
+// the cost is linear in the number of values.
+class FeatureStructureHasher {
+ public:
+  std::size_t operator()(const FeatureStructure &) const;
+};
+
+// Equality predicate for FeatureStructures that takes structure sharing into
+// account: two feature structures are equal iff they have the same values and
+// the same reentrancies.  The two feature structures are traversed together,
+// numbering values as for FeatureStructureHasher, so the cost is linear in the
+// number of values.
+class FeatureStructureEqualityPred {
+ public:
+  bool operator()(const FeatureStructure &, const FeatureStructure &) const;
+};
+
+// As FeatureStructureHasher, but remembers the hash of each feature structure
+// that it is applied to, so hashing the same feature structure again takes
+// constant time.  The cached hashes are keyed on address, so this should only
+// be used with feature structures that are neither modified nor destroyed
+// while the hasher is in use, such as the values of a Lexicon or feature
+// structures interned by a FeatureStructureInterner.  A hasher must not be
+// shared between threads.
+class CachingFeatureStructureHasher {
+ public:
+  std::size_t operator()(const FeatureStructure &) const;
+
+  void Clear() { cache_.clear(); }
+
+ private:
+  mutable boost::unordered_map<const FeatureStructure *, std::size_t> cache_;
 };
 
 // WARNING Do not use BadFeatureStructureOrderer if you care about structure
-// sharing differences.
+// sharing differences.  There is currently no ordering that does; if you only
+// need hashing and equality then see FeatureStructureHasher and
+// FeatureStructureEqualityPred.
 //
 // Defines a (completely arbitrary) strict weak ordering between
 // FeatureStructures so they can be stored in std::sets and suchlike.  It's
@@ -209,7 +594,7 @@ class BadFeatureStructureHasher {
 };
 
 // WARNING Do not use BadFeatureStructureEqualityPred if you care about
-// structure sharing differences.
+// structure sharing differences (see FeatureStructureEqualityPred).
 //
 // Equality predicate for FeatureStructures.  Like BadFeatureStructureOrderer,
 // it doesn't distinguish between structure sharing differences, treating the
@@ -234,22 +619,6 @@ OutputIterator FeatureStructure::MultiClone(InputIterator first,
 
 namespace internal {
 
-struct FSContent {
-  typedef boost::container::flat_map<Feature,
-                                     boost::shared_ptr<FeatureStructure> > Map;
-  FSContent() : a(kNullAtom) {}
-  FSContent(AtomicValue x) : a(x) {}
-  bool IsAtomic() const { return a != kNullAtom; }
-  bool IsComplex() const { return a == kNullAtom; }
-  bool Empty() const { return a == kNullAtom ? c.empty() : false; }
-  bool EffectivelyEmpty() const;
-  FSContent *Clone(FeatureStructure::CloneMap &) const ;
-  FSContent *SelectiveClone(const FeatureTree &,
-                            FeatureStructure::CloneMap &) const;
-  Map c;
-  AtomicValue a;
-};
-
 class ComplexContentValueOrderer {
  public:
   bool operator()(const FSContent::Map::value_type &,
@@ -0,0 +1,87 @@
+#include "taco/feature_structure_interner.h"
+
+#include <boost/functional/hash.hpp>
+
+namespace taco {
+
+std::size_t FeatureStructureInterner::KeyHasher::operator()(
+    const Key &key) const {
+  std::size_t seed = 0;
+  boost::hash_combine(seed, key.atom);
+  boost::hash_combine(seed, key.copy);
+  for (std::vector<std::pair<Feature, const FeatureStructure *> >::
+       const_iterator p = key.arcs.begin(); p != key.arcs.end(); ++p) {
+    boost::hash_combine(seed, p->first);
+    boost::hash_combine(seed, p->second);
+  }
+  return seed;
+}
+
+boost::shared_ptr<FeatureStructure> FeatureStructureInterner::Intern(
+    const FeatureStructure &fs) {
+  NodeMap nodes;
+  OwnerMap owners;
+  return Intern(fs, nodes, owners);
+}
+
+boost::shared_ptr<FeatureStructure> FeatureStructureInterner::Intern(
+    const FeatureStructure &fs,
+    NodeMap &nodes,
+    OwnerMap &owners) {
+  // Follow forward pointers without compressing them, so that shared feature
+  // structures are not modified.
+  const FeatureStructure *bearer = &fs;
+  while (bearer->forward_) {
+    bearer = bearer->forward_.get();
+  }
+
+  // If the node has already been reached by another path then reuse its
+  // interned node, preserving the reentrancy.
+  NodeMap::const_iterator p = nodes.find(bearer);
+  if (p != nodes.end()) {
+    return p->second;
+  }
+
+  // Intern the values first, so that the key can refer to canonical nodes.
+  Key key;
+  key.atom = bearer->content_.a;
+  key.arcs.reserve(bearer->content_.c.size());
+  internal::FSContent content;
+  content.a = key.atom;
+  content.c.reserve(bearer->content_.c.size());
+  for (internal::FSContent::Map::const_iterator q = bearer->content_.c.begin();
+       q != bearer->content_.c.end(); ++q) {
+    boost::shared_ptr<FeatureStructure> value = Intern(*q->second, nodes,
+                                                       owners);
+    key.arcs.push_back(std::make_pair(q->first, value.get()));
+    content.c.insert(content.c.end(), std::make_pair(q->first, value));
+  }
+
+  // If a canonical node is already used for a different node of this feature
+  // structure then using it again would introduce reentrancy, so the next
+  // copy is tried instead.
+  boost::shared_ptr<FeatureStructure> result;
+  for (key.copy = 0; ; ++key.copy) {
+    boost::shared_ptr<FeatureStructure> &canonical = table_[key];
+    if (!canonical) {
+      canonical = NewNode(content);
+    }
+    std::pair<OwnerMap::iterator, bool> owner =
+        owners.insert(std::make_pair(canonical.get(), bearer));
+    if (owner.second || owner.first->second == bearer) {
+      result = canonical;
+      break;
+    }
+  }
+  nodes[bearer] = result;
+  return result;
+}
+
+boost::shared_ptr<FeatureStructure> FeatureStructureInterner::NewNode(
+    const internal::FSContent &content) {
+  boost::shared_ptr<FeatureStructure> node = FeatureStructure::NewNode();
+  node->content_ = content;
+  return node;
+}
+
+}  // namespace taco
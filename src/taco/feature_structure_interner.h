@@ -0,0 +1,92 @@
+#ifndef TACO_SRC_TACO_FEATURE_STRUCTURE_INTERNER_H_
+#define TACO_SRC_TACO_FEATURE_STRUCTURE_INTERNER_H_
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "taco/base/basic_types.h"
+#include "taco/feature_structure.h"
+
+namespace taco {
+
+// A hash-consing table for immutable feature structures.  Intern() returns a
+// copy of a feature structure in which every value is a canonical node that
+// is shared with all other interned feature structures that contain an equal
+// value.  Values are built bottom-up, so a complex value is identified by its
+// features and the canonical nodes of its values.  This respects reentrancy
+// (which the Bad* hasher and predicates ignore) and allows equality to be
+// tested by pointer comparison.
+//
+// In a FeatureStructure, a node that is reachable by two paths represents
+// reentrancy, so within a single interned feature structure a canonical node
+// is only used at two paths if the original was reentrant there.  Otherwise,
+// the second occurrence of an equal value (such as a repeated atomic value)
+// is given a second canonical copy, the third occurrence a third copy, and
+// so on.  Equal feature structures are always interned to the same node, as
+// are equal values that are not repeated within their feature structures,
+// but a repeated value may be represented by different copies in different
+// feature structures.
+//
+// Interned feature structures share nodes and so must not be modified
+// (though they can be cloned and the clones modified, as usual).
+class FeatureStructureInterner {
+ public:
+  FeatureStructureInterner() {}
+
+  // Returns an interned copy of the feature structure.
+  boost::shared_ptr<FeatureStructure> Intern(const FeatureStructure &);
+
+  // Returns the number of canonical nodes.
+  std::size_t Size() const { return table_.size(); }
+
+  // Forgets the canonical nodes.  Feature structures that have already been
+  // interned are unaffected.
+  void Clear() { table_.clear(); }
+
+ private:
+  struct Key {
+    AtomicValue atom;
+    std::vector<std::pair<Feature, const FeatureStructure *> > arcs;
+    unsigned int copy;
+    bool operator==(const Key &other) const {
+      return atom == other.atom && copy == other.copy && arcs == other.arcs;
+    }
+  };
+
+  struct KeyHasher {
+    std::size_t operator()(const Key &) const;
+  };
+
+  typedef boost::unordered_map<Key, boost::shared_ptr<FeatureStructure>,
+                               KeyHasher> Table;
+
+  // Maps each content-bearing node of the feature structure being interned
+  // to its interned node.
+  typedef boost::unordered_map<const FeatureStructure *,
+                               boost::shared_ptr<FeatureStructure> > NodeMap;
+
+  // Maps each canonical node used by the feature structure being interned to
+  // the original node that it replaces.
+  typedef boost::unordered_map<const FeatureStructure *,
+                               const FeatureStructure *> OwnerMap;
+
+  // Copying is not allowed
+  FeatureStructureInterner(const FeatureStructureInterner &);
+  FeatureStructureInterner &operator=(const FeatureStructureInterner &);
+
+  boost::shared_ptr<FeatureStructure> Intern(const FeatureStructure &,
+                                             NodeMap &, OwnerMap &);
+
+  static boost::shared_ptr<FeatureStructure> NewNode(
+      const internal::FSContent &);
+
+  Table table_;
+};
+
+}  // namespace taco
+
+#endif
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 
+#include "taco/compiled_constraint_set.h"
+
 namespace taco {
 
 // Hack-y adapter to allow FeatureStructure::MultiClone to be used with
@@ -50,39 +52,70 @@ class Interpretation::MappedValueInserter {
   Interpretation::Map::iterator dest_map_iter_;
 };
 
+// Instance numbers used with QuasiDestructiveUnifier.  The new feature
+// structure will be cloned before it is added to the full interpretation, so
+// it must be treated as distinct from the previous interpretation's values even
+// if they share structure.
+namespace {
+const unsigned int kPrevInstance = 0;
+const unsigned int kNewInstance = 1;
+}
+
 bool PotentialInterpretation::QuickCheck(const ConstraintSet &cs) {
+  QuasiDestructiveUnifier unifier;
+  return QuickCheck(cs, unifier);
+}
+
+bool PotentialInterpretation::QuickCheck(const ConstraintSet &cs,
+                                         QuasiDestructiveUnifier &unifier) {
+  return QuickCheckRelations(cs, unifier) && QuickCheckOption(cs, index_, *fs_);
+}
+
+bool PotentialInterpretation::QuickCheckRelations(
+    const ConstraintSet &cs, QuasiDestructiveUnifier &unifier) {
+  unifier.Reset();
   // If the interpretation already contains a feature structure with the
   // new index then check if the old and new FS are unifiable.
   boost::shared_ptr<const FeatureStructure> prev_fs = prev_.GetFS(index_);
   if (prev_fs.get()) {
-    return prev_fs->PossiblyUnifiable(fs_);
+    typedef QuasiDestructiveUnifier::Node Node;
+    return unifier.Unify(Node(*prev_fs, kPrevInstance),
+                         Node(*fs_, kNewInstance));
   }
+  for (RelConstraintSet::ConstIterator p = cs.rel_set().Begin();
+       p != cs.rel_set().End(); ++p) {
+    const RelConstraint &constraint = **p;
+    if (!QuickCheck(constraint, unifier)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PotentialInterpretation::QuickCheckOption(const ConstraintSet &cs,
+                                               int index,
+                                               const FeatureStructure &fs) {
   for (AbsConstraintSet::ConstIterator p = cs.abs_set().Begin();
        p != cs.abs_set().End(); ++p) {
     const AbsConstraint &constraint = **p;
-    if (!QuickCheck(constraint)) {
+    if (!QuickCheck(constraint, index, fs)) {
       return false;
     }
   }
-  for (RelConstraintSet::ConstIterator p = cs.rel_set().Begin();
-       p != cs.rel_set().End(); ++p) {
-    const RelConstraint &constraint = **p;
-    if (!QuickCheck(constraint)) {
-        return false;
-    }
-  }
   for (VarConstraintSet::ConstIterator p = cs.var_set().Begin();
        p != cs.var_set().End(); ++p) {
     const VarConstraint &constraint = **p;
-    if (!QuickCheck(constraint)) {
+    if (!QuickCheck(constraint, index, fs)) {
       return false;
     }
   }
   return true;
 }
 
-bool PotentialInterpretation::QuickCheck(const AbsConstraint &constraint) {
-  if (constraint.lhs.index() != index_) {
+bool PotentialInterpretation::QuickCheck(const AbsConstraint &constraint,
+                                         int index,
+                                         const FeatureStructure &fs) {
+  if (constraint.lhs.index() != index) {
     // The constraint doesn't apply to the new feature structure.
     return true;
   }
@@ -90,16 +123,18 @@ bool PotentialInterpretation::QuickCheck(const AbsConstraint &constraint) {
   assert(!path.empty());
   AtomicValue atom = constraint.rhs.value();
 
-  boost::shared_ptr<const FeatureStructure> val = fs_->Get(path.begin(),
-                                                           path.end());
-  if (!val) {
+  const FeatureStructure *val = fs.Find(path.begin(), path.end());
+  // An empty value could still become atomic through unification.
+  if (!val || val->IsEmpty()) {
     return true;
   }
   return val->IsAtomic() && val->GetAtomicValue() == atom;
 }
 
-bool PotentialInterpretation::QuickCheck(const VarConstraint &constraint) {
-  if (constraint.lhs.index() != index_) {
+bool PotentialInterpretation::QuickCheck(const VarConstraint &constraint,
+                                         int index,
+                                         const FeatureStructure &fs) {
+  if (constraint.lhs.index() != index) {
     // The constraint doesn't apply to the new feature structure.
     return true;
   }
@@ -107,9 +142,9 @@ bool PotentialInterpretation::QuickCheck(const VarConstraint &constraint) {
   assert(!path.empty());
   const VarTerm::ProbabilityMap &prob_map = constraint.rhs.probabilities();
 
-  boost::shared_ptr<const FeatureStructure> val = fs_->Get(path.begin(),
-                                                           path.end());
-  if (!val) {
+  const FeatureStructure *val = fs.Find(path.begin(), path.end());
+  // An empty value could still become atomic through unification.
+  if (!val || val->IsEmpty()) {
     return true;
   }
   if (!val->IsAtomic()) {
@@ -119,11 +154,14 @@ bool PotentialInterpretation::QuickCheck(const VarConstraint &constraint) {
   return prob_map.find(atom) != prob_map.end();
 }
 
-bool PotentialInterpretation::QuickCheck(const RelConstraint &constraint) {
+bool PotentialInterpretation::QuickCheck(const RelConstraint &constraint,
+                                         QuasiDestructiveUnifier &unifier) {
+  typedef QuasiDestructiveUnifier::Node Node;
+
   int lhs_index = constraint.lhs.index();
   int rhs_index = constraint.rhs.index();
-  boost::shared_ptr<const FeatureStructure> lhs_root;
-  boost::shared_ptr<const FeatureStructure> rhs_root;
+  Node lhs_root;
+  Node rhs_root;
   if (index_ == lhs_index) {
     Interpretation::Map::const_iterator p = prev_.values_.find(rhs_index);
     if (p == prev_.values_.end()) {
@@ -131,8 +169,8 @@ bool PotentialInterpretation::QuickCheck(const RelConstraint &constraint) {
       // range of this interpretation.  Pass by default.
       return true;
     }
-    rhs_root = p->second;
-    lhs_root = fs_;
+    rhs_root = Node(*p->second, kPrevInstance);
+    lhs_root = Node(*fs_, kNewInstance);
   } else if (index_ == rhs_index) {
     Interpretation::Map::const_iterator p = prev_.values_.find(lhs_index);
     if (p == prev_.values_.end()) {
@@ -140,8 +178,8 @@ bool PotentialInterpretation::QuickCheck(const RelConstraint &constraint) {
       // range of this interpretation.  Pass by default.
       return true;
     }
-    lhs_root = p->second;
-    rhs_root = fs_;
+    lhs_root = Node(*p->second, kPrevInstance);
+    rhs_root = Node(*fs_, kNewInstance);
   } else {
     // The constraint doesn't involve the new feature structure.
     return true;
@@ -150,30 +188,18 @@ bool PotentialInterpretation::QuickCheck(const RelConstraint &constraint) {
   const FeaturePath &lhs_path = constraint.lhs.path();
   const FeaturePath &rhs_path = constraint.rhs.path();
 
-  boost::shared_ptr<const FeatureStructure> lhs;
-  if (lhs_path.empty()) {
-    lhs = lhs_root;
-  } else {
-    lhs = lhs_root->Get(lhs_path.begin(), lhs_path.end());
-    if (!lhs) {
-      // Full evaluation will create an empty value here and then unification
-      // is guaranteed to succeed.
-      return true;
-    }
+  // Full evaluation will create an empty value at a missing path and then
+  // unification is guaranteed to succeed.  Skipping the constraint can only
+  // make the remaining constraints easier to satisfy, so this is safe.
+  Node lhs = unifier.Get(lhs_root, lhs_path.begin(), lhs_path.end());
+  if (!lhs.fs) {
+    return true;
   }
-
-  boost::shared_ptr<const FeatureStructure> rhs;
-  if (rhs_path.empty()) {
-    rhs = rhs_root;
-  } else {
-    rhs = rhs_root->Get(rhs_path.begin(), rhs_path.end());
-    if (!rhs) {
-      // Full evaluation will create an empty value here and then unification
-      // is guaranteed to succeed.
-      return true;
-    }
+  Node rhs = unifier.Get(rhs_root, rhs_path.begin(), rhs_path.end());
+  if (!rhs.fs) {
+    return true;
   }
-  return lhs->PossiblyUnifiable(rhs);
+  return unifier.Unify(lhs, rhs);
 }
 
 Interpretation::Interpretation(int index,
@@ -184,6 +210,24 @@ Interpretation::Interpretation(int index,
 
 Interpretation::Interpretation(const PotentialInterpretation &pi)
     : probability_(pi.prev().probability_) {
+  Extend(pi, pi.fs()->Clone());
+}
+
+Interpretation::Interpretation(const PotentialInterpretation &pi,
+                               const FeatureTree &tree)
+    : probability_(pi.prev().probability_) {
+  // If the previous interpretation already contains a feature structure at the
+  // new index then the two will be unified in full, so a full clone is
+  // required.
+  if (pi.prev().values_.find(pi.index()) != pi.prev().values_.end()) {
+    Extend(pi, pi.fs()->Clone());
+  } else {
+    Extend(pi, pi.fs()->PartialClone(tree));
+  }
+}
+
+void Interpretation::Extend(const PotentialInterpretation &pi,
+                            boost::shared_ptr<FeatureStructure> clone) {
   // Populate values_ by first cloning the feature structures from the
   // previous interpretation.  MultiClone is used to ensure that if a value is
   // shared between feature structures in the previous interpretation then the
@@ -195,8 +239,6 @@ Interpretation::Interpretation(const PotentialInterpretation &pi)
   FeatureStructure::MultiClone(MappedValueIterator(prev_values.begin()),
                                MappedValueIterator(prev_values.end()),
                                MappedValueInserter(prev_values, values_));
-  // Make a clone of the new feature structure for insertion / merging.
-  boost::shared_ptr<FeatureStructure> clone = pi.fs()->Clone();
   // If the previous interpretation already contained a feature structure
   // at the new index then attempt to unify the old and new FS.  Otherwise
   // insert the clone.
@@ -254,6 +296,116 @@ bool Interpretation::Eval(const ConstraintSet &cs) {
   return true;
 }
 
+bool Interpretation::Eval(const CompiledConstraintSet &cs) {
+  typedef CompiledConstraintSet::Instruction Instruction;
+  typedef CompiledConstraintSet::PathNode PathNode;
+
+  // Reset probability_ since we'll recalculate it in full.
+  probability_ = 1.0f;
+
+  // Only values that exist are remembered: a value reached by an earlier
+  // walk stays valid after unification (it forwards to the merged value), but
+  // a path that was missing may since have been created.
+  std::vector<boost::shared_ptr<FeatureStructure> > cache(cs.nodes_.size());
+
+  for (std::vector<Instruction>::const_iterator p = cs.program_.begin();
+       p != cs.program_.end(); ++p) {
+    const Instruction &instruction = *p;
+    const PathNode &lhs_node = cs.nodes_[instruction.lhs];
+    boost::shared_ptr<FeatureStructure> lhs_root =
+        Resolve(cs, lhs_node.root, cache);
+    if (!lhs_root) {
+      continue;  // Passes by default.
+    }
+    switch (instruction.opcode) {
+      case CompiledConstraintSet::kRel: {
+        const PathNode &rhs_node = cs.nodes_[instruction.rhs];
+        boost::shared_ptr<FeatureStructure> rhs_root =
+            Resolve(cs, rhs_node.root, cache);
+        if (!rhs_root) {
+          continue;  // Passes by default.
+        }
+        boost::shared_ptr<FeatureStructure> lhs =
+            Resolve(cs, instruction.lhs, cache);
+        if (!lhs) {
+          lhs = lhs_root->CreateEmptyValue(lhs_node.path.begin(),
+                                           lhs_node.path.end());
+          cache[instruction.lhs] = lhs;
+        }
+        boost::shared_ptr<FeatureStructure> rhs =
+            Resolve(cs, instruction.rhs, cache);
+        if (!rhs) {
+          rhs = rhs_root->CreateEmptyValue(rhs_node.path.begin(),
+                                           rhs_node.path.end());
+          cache[instruction.rhs] = rhs;
+        }
+        if (!FeatureStructure::Unify(lhs, rhs)) {
+          return false;
+        }
+        break;
+      }
+      case CompiledConstraintSet::kAbs: {
+        boost::shared_ptr<FeatureStructure> val =
+            Resolve(cs, instruction.lhs, cache);
+        if (!val) {
+          cache[instruction.lhs] = lhs_root->CreateAtomicValue(
+              lhs_node.path.begin(), lhs_node.path.end(), instruction.value);
+        } else if (!val->IsAtomic() ||
+                   val->GetAtomicValue() != instruction.value) {
+          return false;
+        }
+        break;
+      }
+      case CompiledConstraintSet::kVar: {
+        const VarTerm &var = *instruction.var;
+        boost::shared_ptr<FeatureStructure> val =
+            Resolve(cs, instruction.lhs, cache);
+        if (!val) {
+          // There's no value to score: use the most favourable probability.
+          probability_ *= var.MaxProbability();
+          break;
+        }
+        if (!val->IsAtomic()) {
+          return false;
+        }
+        VarTerm::ProbabilityMap::const_iterator q =
+            var.probabilities().find(val->GetAtomicValue());
+        if (q == var.probabilities().end()) {
+          probability_ = 0.0f;
+          return false;
+        }
+        probability_ *= q->second;
+        break;
+      }
+    }
+  }
+
+  return true;
+}
+
+boost::shared_ptr<FeatureStructure> Interpretation::Resolve(
+    const CompiledConstraintSet &cs,
+    int id,
+    std::vector<boost::shared_ptr<FeatureStructure> > &cache) const {
+  boost::shared_ptr<FeatureStructure> &value = cache[id];
+  if (value) {
+    return value;
+  }
+  const CompiledConstraintSet::PathNode &node = cs.nodes_[id];
+  if (node.parent == -1) {
+    Map::const_iterator p = values_.find(node.index);
+    if (p != values_.end()) {
+      value = p->second;
+    }
+    return value;
+  }
+  boost::shared_ptr<FeatureStructure> parent = Resolve(cs, node.parent, cache);
+  if (parent) {
+    value = parent->Get(node.feature);
+  }
+  return value;
+}
+
 bool Interpretation::Eval(const AbsConstraint &constraint) {
   int index = constraint.lhs.index();
   const FeaturePath &path = constraint.lhs.path();
@@ -354,4 +506,52 @@ bool Interpretation::Eval(const VarConstraint &constraint) {
   }
 }
 
+InterpretationSignature::InterpretationSignature(
+    const Interpretation &interpretation,
+    const FeatureTree &tree) {
+  ProjectionEncoder encoder;
+  Init(interpretation, tree, encoder);
+}
+
+InterpretationSignature::InterpretationSignature(
+    const Interpretation &interpretation,
+    const FeatureTree &tree,
+    ProjectionEncoder &encoder) {
+  Init(interpretation, tree, encoder);
+}
+
+void InterpretationSignature::Init(const Interpretation &interpretation,
+                                   const FeatureTree &tree,
+                                   ProjectionEncoder &encoder) {
+  encoder.Reset();
+  boost::shared_ptr<const FeatureStructure> root = interpretation.GetFS(0);
+  if (root) {
+    encoder.Add(*root, tree);
+  }
+  const ProjectionEncoder::Encoding &encoding = encoder.encoding();
+  bytes_.clear();
+  bytes_.reserve(encoding.size() + 1);
+  // A leading byte distinguishes a missing root from an empty one.
+  bytes_.push_back(root ? 1 : 0);
+  for (ProjectionEncoder::Encoding::const_iterator p = encoding.begin();
+       p != encoding.end(); ++p) {
+    boost::uint32_t n = *p;
+    while (n >= 0x80) {
+      bytes_.push_back(static_cast<char>((n & 0x7f) | 0x80));
+      n >>= 7;
+    }
+    bytes_.push_back(static_cast<char>(n));
+  }
+  hash_ = Hash(bytes_);
+}
+
+boost::uint64_t InterpretationSignature::Hash(const std::string &bytes) {
+  boost::uint64_t hash = 14695981039346656037ULL;
+  for (std::string::const_iterator p = bytes.begin(); p != bytes.end(); ++p) {
+    hash ^= static_cast<unsigned char>(*p);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
 }  // namespace taco
@@ -1,9 +1,13 @@
 #ifndef TACO_SRC_TACO_INTERPRETATION_H_
 #define TACO_SRC_TACO_INTERPRETATION_H_
 
+#include <cstddef>
 #include <map>
+#include <string>
+#include <vector>
 
 #include <boost/container/flat_map.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
 
 #include "taco/constraint.h"
@@ -12,6 +16,7 @@
 
 namespace taco {
 
+class CompiledConstraintSet;
 class Interpretation;
 
 // Stores the information necessary to create a full interpretation and
@@ -34,14 +39,14 @@ class Interpretation;
 // be constructed or not, conditional upon this result.  The check produces
 // false positives but never produces false negatives.
 //
-// As an example of a false positive, consider the extension of an
-// interpretation over elements 0, 3, 4, 5 to cover element 6 where the
-// constraint set contains the rules <4 AGR> = <6 AGR> and <5 AGR> = <6 AGR>.
-// If the AGR values of 4 and 6 are unifiable and the AGR values of 5 and 6
-// are also unifiable then QuickCheck() will report success.  Whether this is
-// correct or not depends on whether the unified AGR value of 4 and 6 can be
-// unified with the AGR value of 5, something that QuickCheck() cannot
-// determine.
+// The relational constraints that involve the new feature structure are
+// tested together using quasi-destructive unification, so, for example, if
+// an interpretation over elements 0, 3, 4, 5 is extended to cover element 6
+// where the constraint set contains the rules <4 AGR> = <6 AGR> and
+// <5 AGR> = <6 AGR> then QuickCheck() will fail unless the AGR values of all
+// three elements are unifiable.  False positives arise from constraints whose
+// paths do not (yet) exist, which are skipped, and from interactions between
+// constraints of different types.
 class PotentialInterpretation {
  public:
   PotentialInterpretation(const Interpretation &prev, int index,
@@ -50,14 +55,30 @@ class PotentialInterpretation {
 
   bool QuickCheck(const ConstraintSet &);
 
+  // As above, but uses the given unifier instead of creating one.  This avoids
+  // repeatedly allocating the unifier's table when checking many candidates.
+  bool QuickCheck(const ConstraintSet &, QuasiDestructiveUnifier &);
+
+  // Performs only the part of QuickCheck() that depends on the previous
+  // interpretation.  The remaining checks depend only on the new feature
+  // structure, so a caller that extends many interpretations with the same
+  // feature structure can perform them once, in advance, using
+  // QuickCheckOption().
+  bool QuickCheckRelations(const ConstraintSet &, QuasiDestructiveUnifier &);
+
+  // Performs the part of QuickCheck() that depends only on the new feature
+  // structure (the absolute and variable constraints).
+  static bool QuickCheckOption(const ConstraintSet &, int,
+                               const FeatureStructure &);
+
   const Interpretation &prev() const { return prev_; }
   int index() const { return index_; }
   boost::shared_ptr<const FeatureStructure> fs() const { return fs_; }
 
  private:
-  bool QuickCheck(const AbsConstraint &);
-  bool QuickCheck(const RelConstraint &);
-  bool QuickCheck(const VarConstraint &);
+  static bool QuickCheck(const AbsConstraint &, int, const FeatureStructure &);
+  bool QuickCheck(const RelConstraint &, QuasiDestructiveUnifier &);
+  static bool QuickCheck(const VarConstraint &, int, const FeatureStructure &);
 
   const Interpretation &prev_;
   int index_;
@@ -82,6 +103,14 @@ class Interpretation {
   // will be empty.
   Interpretation(const PotentialInterpretation &);
 
+  // As above, except that the new feature structure is copied using
+  // FeatureStructure::PartialClone() instead of being cloned in full.  The
+  // FeatureTree must contain every path at which constraint evaluation may
+  // modify the new feature structure (see ConstraintSet::GetModifiablePaths).
+  // Values outside of the tree remain shared with the original feature
+  // structure and must not be modified.
+  Interpretation(const PotentialInterpretation &, const FeatureTree &);
+
   // I'm not sure why, but the assignment operator must be defined when Map is
   // a typedef to boost::container::flat_map (but not std::map).  The generated
   // one (which takes Interpretation & not const Interpretation &) isn't
@@ -110,6 +139,10 @@ class Interpretation {
   // true if they all pass and the resulting probability is non-zero.
   bool Eval(const ConstraintSet &);
 
+  // As above, but evaluates a compiled constraint set.  The result is the same
+  // as for the ConstraintSet from which it was compiled.
+  bool Eval(const CompiledConstraintSet &);
+
   // Evaluates a single absolute constraint.  Returns true if the constraint
   // is satisfied.  If the element indexed by the constraint doesn't occur in
   // this interpretation then the constraint is satisifed by default.
@@ -135,10 +168,82 @@ class Interpretation {
   friend class MappedValueInserter;
   friend class PotentialInterpretation;
 
+  // Implements the PotentialInterpretation constructors.  The second argument
+  // is the copy of the new feature structure.
+  void Extend(const PotentialInterpretation &,
+              boost::shared_ptr<FeatureStructure>);
+
+  // Returns the value at a path node of a compiled constraint set, or a null
+  // pointer if there isn't one.  Values are remembered in the vector, which
+  // has an element for each node.
+  boost::shared_ptr<FeatureStructure> Resolve(
+      const CompiledConstraintSet &, int,
+      std::vector<boost::shared_ptr<FeatureStructure> > &) const;
+
   Map values_;
   float probability_;
 };
 
+// A compact summary of an interpretation's root feature structure (the one
+// with index 0) restricted to the paths of a FeatureTree, such as the tree of
+// a FeatureSelectionRule::Rule_Select rule that selects the features exported
+// by a hypothesis.  Two signatures made with the same tree are equal iff the
+// root feature structures have the same values at those paths, including the
+// same reentrancy between them, so a signature can serve as a recombination
+// key in place of a comparison of the feature structures.  An empty tree
+// stands for the whole feature structure.  An interpretation without a root
+// feature structure has a signature of its own.
+//
+// The signature is a ProjectionEncoder encoding in which each number is
+// written in as few bytes as possible (seven bits per byte), so a typical
+// signature is a few dozen bytes.  It can be stored and compared later, but
+// the feature and value numbers in it are only meaningful together with the
+// vocabularies of the feature structures.  The 64-bit hash is computed from
+// the bytes.
+class InterpretationSignature {
+ public:
+  // Creates the signature of an interpretation without a root feature
+  // structure.
+  InterpretationSignature() : bytes_(1, '\0'), hash_(Hash(bytes_)) {}
+
+  InterpretationSignature(const Interpretation &, const FeatureTree &);
+
+  // As above, but uses the given encoder instead of creating one.
+  InterpretationSignature(const Interpretation &, const FeatureTree &,
+                          ProjectionEncoder &);
+
+  // Recreates a signature from the result of bytes().
+  explicit InterpretationSignature(const std::string &bytes)
+      : bytes_(bytes)
+      , hash_(Hash(bytes)) {}
+
+  const std::string &bytes() const { return bytes_; }
+  boost::uint64_t hash() const { return hash_; }
+
+  bool operator==(const InterpretationSignature &other) const {
+    return hash_ == other.hash_ && bytes_ == other.bytes_;
+  }
+  bool operator!=(const InterpretationSignature &other) const {
+    return !(*this == other);
+  }
+  bool operator<(const InterpretationSignature &other) const {
+    return bytes_ < other.bytes_;
+  }
+
+ private:
+  void Init(const Interpretation &, const FeatureTree &, ProjectionEncoder &);
+
+  // The 64-bit FNV-1a hash of the bytes.
+  static boost::uint64_t Hash(const std::string &);
+
+  std::string bytes_;
+  boost::uint64_t hash_;
+};
+
+inline std::size_t hash_value(const InterpretationSignature &signature) {
+  return static_cast<std::size_t>(signature.hash());
+}
+
 }  // namespace taco
 
 #endif
@@ -11,7 +11,13 @@
 
 namespace taco {
 
-void BasicLexiconLoader::Load(std::istream &input, Lexicon<size_t> &lexicon) {
+void BasicLexiconLoader::Load(std::istream &input, Lexicon<size_t> &lexicon,
+                              FeatureStructureInterner *interner) {
+  FeatureStructureInterner local_interner;
+  if (!interner) {
+    interner = &local_interner;
+  }
+
   // TODO Use boost::unordered_map
   std::map<FeatureStructureSpec,
            boost::shared_ptr<FeatureStructure> > spec_to_fs;
@@ -24,7 +30,7 @@ void BasicLexiconLoader::Load(std::istream &input, Lexicon<size_t> &lexicon) {
     fs_parser_.Parse(entry.fs, spec);
     boost::shared_ptr<FeatureStructure> &fs = spec_to_fs[spec];
     if (!fs.get()) {
-      fs.reset(new FeatureStructure(spec));
+      fs = interner->Intern(FeatureStructure(spec));
     }
     lexicon.Insert(word_id, fs);
   }
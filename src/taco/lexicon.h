@@ -11,6 +11,7 @@
 
 #include "taco/base/exception.h"
 #include "taco/feature_structure.h"
+#include "taco/feature_structure_interner.h"
 #include "taco/text-formats/feature_structure_parser.h"
 #include "taco/text-formats/feature_structure_writer.h"
 #include "taco/text-formats/lexicon_parser.h"
@@ -56,13 +57,22 @@ class Lexicon {
   Map map_;
 };
 
+// Loads lexicon entries from a stream.  The feature structures are interned,
+// so values that occur in more than one entry (for example, identical
+// inflection values) are shared.  The lexicon's feature structures must
+// therefore not be modified.
 class BasicLexiconLoader {
  public:
   BasicLexiconLoader(FeatureStructureParser &fs_parser, Vocabulary &vocab)
       : fs_parser_(fs_parser)
       , vocabulary_(vocab) {}
 
-  void Load(std::istream &, Lexicon<size_t> &);
+  // Loads the entries into the lexicon.  By default the interning table is
+  // discarded once loading is complete, so it does not hold a second
+  // reference to every value.  To share values between lexicons, pass the
+  // same interner to each call (the caller then decides when to clear it).
+  void Load(std::istream &, Lexicon<size_t> &,
+            FeatureStructureInterner *interner = 0);
 
  private:
   FeatureStructureParser &fs_parser_;
@@ -104,12 +114,13 @@ bool Lexicon<K>::Lookup(const K &k, const FeatureStructure &x,
     return false;
   }
   bool ret_val = false;
+  // Quasi-destructive unification leaves x and the values unchanged, so
+  // there is no need to clone them.
+  QuasiDestructiveUnifier unifier;
   for (MappedType::const_iterator q = p->second.begin(); q != p->second.end();
        ++q) {
-    boost::shared_ptr<FeatureStructure> y = *q;
-    boost::shared_ptr<FeatureStructure> x2 = x.Clone();
-    boost::shared_ptr<FeatureStructure> y2 = y->Clone();
-    if (FeatureStructure::Unify(x2, y2)) {
+    const boost::shared_ptr<FeatureStructure> &y = *q;
+    if (unifier.IsUnifiable(x, *y)) {
       ret_val = true;
       *result++ = y;
     }
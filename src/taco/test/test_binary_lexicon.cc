@@ -0,0 +1,150 @@
+#include <boost/test/unit_test.hpp>
+
+#include "taco/binary_lexicon.h"
+
+#include "taco/base/exception.h"
+#include "taco/feature_structure.h"
+#include "taco/feature_structure_spec.h"
+#include "taco/lexicon.h"
+#include "taco/text-formats/feature_structure_parser.h"
+#include "taco/base/vocabulary.h"
+
+#include <boost/assign/std/vector.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Tests that a lexicon written by BinaryLexiconWriter can be looked up in
+// place and gives the same feature structures as the text lexicon.
+BOOST_AUTO_TEST_CASE(TestBinaryLexicon) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+
+  Vocabulary words;
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser parser(feature_set, value_set);
+
+  std::istringstream text(
+      "Haus ||| [POS:NN;AGR:[CASE:nom;NUM:sg;GEN:n]]\n"
+      "Haus ||| [POS:NN;AGR:[CASE:acc;NUM:sg;GEN:n]]\n"
+      "Hauses ||| [POS:NN;AGR:[CASE:gen;NUM:sg;GEN:n]]\n"
+      "der ||| [POS:ART;AGR:[CASE:nom;NUM:sg;GEN:m]]\n"
+      "der ||| [POS:ART;AGR:[CASE:gen;NUM:pl]]\n"
+      "pq ||| [P:[F:a];Q:[G:d]]\n"
+      "qp ||| [P:[G:c];Q:[F:a]]\n");
+  Lexicon<std::size_t> lexicon;
+  BasicLexiconLoader loader(parser, words);
+  loader.Load(text, lexicon);
+
+  // Add an entry with reentrancy: <A> and <B> share a value.
+  {
+    FeaturePath path_a, path_b, path_x;
+    path_a += feature_set.Insert("A");
+    path_b += feature_set.Insert("B");
+    path_x = path_a;
+    path_x += feature_set.Insert("X");
+    FeatureStructureSpec spec;
+    spec.content_pairs.insert(std::make_pair(path_x, value_set.Insert("y")));
+    spec.equiv_pairs.insert(std::make_pair(path_a, path_b));
+    lexicon.Insert(words.Insert("xy"), SPFS(new FeatureStructure(spec)));
+  }
+
+  std::ostringstream out;
+  BinaryLexiconWriter writer(words, feature_set, value_set);
+  writer.Write(lexicon, out);
+  const std::string data = out.str();
+
+  BinaryLexicon binary(data.data(), data.size());
+  BOOST_CHECK_EQUAL(binary.Size(), 6);
+  BOOST_CHECK_EQUAL(binary.NumEntries(), 8);
+
+  Vocabulary binary_features;
+  Vocabulary binary_values;
+  binary.ReadVocabularies(binary_features, binary_values);
+  BOOST_CHECK_EQUAL(binary_features.Size(), feature_set.Size());
+  BOOST_CHECK_EQUAL(binary_values.Size(), value_set.Size());
+
+  BadFeatureStructureEqualityPred equal;
+  for (Lexicon<std::size_t>::ConstIterator p = lexicon.Begin();
+       p != lexicon.End(); ++p) {
+    const std::string &word = words.Lookup(p->first);
+    std::size_t index = binary.Find(word);
+    BOOST_REQUIRE(index != BinaryLexicon::kNotFound);
+    BOOST_CHECK(binary.GetWord(index) == StringPiece(word));
+    BinaryLexicon::MappedType values;
+    BOOST_REQUIRE(binary.Lookup(word, values));
+    BOOST_REQUIRE_EQUAL(values.size(), p->second.size());
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      BOOST_CHECK(equal(*values[i], *p->second[i]));
+    }
+  }
+
+  BinaryLexicon::MappedType values;
+  BOOST_CHECK(binary.Find("Hause") == BinaryLexicon::kNotFound);
+  BOOST_CHECK(!binary.Lookup("Hause", values));
+  BOOST_CHECK(values.empty());
+
+  // Reentrancy is preserved and equal values are shared between entries.
+  BOOST_REQUIRE(binary.Lookup("xy", values));
+  BOOST_REQUIRE_EQUAL(values.size(), 1);
+  BOOST_CHECK(values[0]->Get(feature_set.Lookup("A")) ==
+              values[0]->Get(feature_set.Lookup("B")));
+  {
+    BinaryLexicon::MappedType values1, values2;
+    BOOST_REQUIRE(binary.Lookup("Haus", values1));
+    BOOST_REQUIRE(binary.Lookup("Hauses", values2));
+    Feature pos = feature_set.Lookup("POS");
+    BOOST_CHECK(values1[0]->Get(pos) == values2[0]->Get(pos));
+  }
+
+  // Filtering by unifiability.
+  {
+    SPFS filter = parser.Parse("[AGR:[CASE:gen]]");
+    std::vector<SPFS> results;
+    BOOST_CHECK(binary.Lookup("der", *filter, std::back_inserter(results)));
+    BOOST_CHECK_EQUAL(results.size(), 1);
+    BOOST_CHECK(!binary.Lookup("Haus", *filter, std::back_inserter(results)));
+  }
+
+  // Filtering with a query that shares a value with the entry: the shared
+  // [F:a] is unified with [G:c] on the query's side and with [G:d] on the
+  // entry's side, which only fails if the two copies are confused.
+  {
+    BinaryLexicon::MappedType pq, qp;
+    BOOST_REQUIRE(binary.Lookup("pq", pq));
+    BOOST_REQUIRE(binary.Lookup("qp", qp));
+    BOOST_REQUIRE(pq[0]->Get(feature_set.Lookup("P")) ==
+                  qp[0]->Get(feature_set.Lookup("Q")));
+    std::vector<SPFS> results;
+    BOOST_CHECK(binary.Lookup("pq", *qp[0], std::back_inserter(results)));
+    BOOST_CHECK_EQUAL(results.size(), 1);
+  }
+
+  // Mapping the file.
+  const char *path = "test_binary_lexicon.tmp";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file.write(data.data(), data.size());
+  }
+  {
+    BinaryLexicon mapped(path);
+    BOOST_CHECK(mapped.Lookup("der", values));
+    BOOST_CHECK_EQUAL(values.size(), 2);
+  }
+  std::remove(path);
+
+  // Invalid input.
+  BOOST_CHECK_THROW(BinaryLexicon(data.data(), data.size() - 8), Exception);
+  std::string bad = data;
+  bad[0] = 'X';
+  BOOST_CHECK_THROW(BinaryLexicon(bad.data(), bad.size()), Exception);
+  BOOST_CHECK_THROW(BinaryLexicon("no-such-file"), Exception);
+}
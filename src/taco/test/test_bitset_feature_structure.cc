@@ -0,0 +1,91 @@
+#include <boost/test/unit_test.hpp>
+
+#include "taco/bitset_feature_structure.h"
+
+#include "taco/feature_structure.h"
+#include "taco/text-formats/feature_structure_parser.h"
+#include "taco/base/vocabulary.h"
+
+#include <boost/assign/std/set.hpp>
+#include <boost/assign/std/vector.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(TestBitsetFeatureStructure) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  std::vector<std::string> strings;
+  strings += "[CASE:nom;NUM:sg;GEND:masc]",
+             "[CASE:acc;NUM:sg]",
+             "[CASE:dat;NUM:pl;GEND:fem]",
+             "[NUM:pl]",
+             "[]",
+             "[CASE:nom;AGR:[PERS:3]]",
+             "[CASE:gen;AGR:[]]",
+             "[X:[PERS:3]]";
+
+  std::vector<SPFS> fs_vec;
+  for (std::vector<std::string>::const_iterator p = strings.begin();
+       p != strings.end(); ++p) {
+    fs_vec.push_back(fs_parser.Parse(*p));
+  }
+
+  BitsetLayout layout(fs_vec.begin(), fs_vec.end());
+  BOOST_CHECK(layout.NumFields() == 5);
+  BOOST_CHECK(layout.NumWords() == 1);
+
+  // The bitset test agrees with full unification for every pair.
+  std::vector<BitsetFeatureStructure> bits(fs_vec.size());
+  for (std::size_t i = 0; i < fs_vec.size(); ++i) {
+    BOOST_CHECK(layout.Encode(*fs_vec[i], bits[i]));
+  }
+  QuasiDestructiveUnifier unifier;
+  for (std::size_t i = 0; i < fs_vec.size(); ++i) {
+    for (std::size_t j = 0; j < fs_vec.size(); ++j) {
+      bool expected = unifier.IsUnifiable(*fs_vec[i], *fs_vec[j]);
+      BOOST_CHECK(layout.IsUnifiable(bits[i], bits[j]) == expected);
+    }
+  }
+
+  // Unification of encodings matches encoding of the unified result.
+  {
+    BitsetFeatureStructure result = bits[0];
+    BOOST_CHECK(layout.Unify(result, bits[5]));
+    SPFS unified = unifier.UnifyAndCopy(*fs_vec[0], *fs_vec[5]);
+    BitsetFeatureStructure expected;
+    BOOST_CHECK(layout.Encode(*unified, expected));
+    BOOST_CHECK(result == expected);
+    result = bits[0];
+    BOOST_CHECK(!layout.Unify(result, bits[1]));
+  }
+
+  // Feature structures that can't be encoded.
+  {
+    BitsetFeatureStructure tmp;
+    // Value outside the inventory.
+    BOOST_CHECK(!layout.Encode(*fs_parser.Parse("[CASE:voc]"), tmp));
+    // Path without a field.
+    BOOST_CHECK(!layout.Encode(*fs_parser.Parse("[DECL:weak]"), tmp));
+    // Complex value at an atomic path.
+    BOOST_CHECK(!layout.Encode(*fs_parser.Parse("[NUM:[X:y]]"), tmp));
+    // Reentrancy.
+    FeaturePath path1, path2, path3;
+    path1 += feature_set.Lookup("AGR");
+    path2 += feature_set.Lookup("X");
+    path3 += feature_set.Lookup("AGR"), feature_set.Lookup("PERS");
+    FeatureStructureSpec spec;
+    spec.content_pairs += std::make_pair(path3, value_set.Lookup("3"));
+    BOOST_CHECK(layout.Encode(FeatureStructure(spec), tmp));
+    spec.equiv_pairs += std::make_pair(path1, path2);
+    BOOST_CHECK(!layout.Encode(FeatureStructure(spec), tmp));
+  }
+}
@@ -0,0 +1,156 @@
+#include <boost/test/unit_test.hpp>
+
+#include "taco/constraint_evaluation_cache.h"
+
+#include "taco/compiled_constraint_set.h"
+#include "taco/constraint_evaluator.h"
+#include "taco/constraint_set.h"
+#include "taco/interpretation.h"
+#include "taco/option_table.h"
+#include "taco/text-formats/constraint_set_parser.h"
+#include "taco/text-formats/feature_structure_parser.h"
+#include "taco/base/vocabulary.h"
+
+#include <boost/assign/std/vector.hpp>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+void AddColumn(const std::vector<std::string> &fs_strings,
+               taco::FeatureStructureParser &fs_parser,
+               size_t index,
+               taco::OptionTable &option_table) {
+  taco::OptionColumn col;
+  for (std::vector<std::string>::const_iterator p = fs_strings.begin();
+       p != fs_strings.end(); ++p) {
+    col.Add(fs_parser.Parse(*p));
+  }
+  option_table.AddColumn(index, col);
+}
+
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluationCache) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser fs_parser(feature_set, value_set);
+  ConstraintSetParser parser(feature_set, value_set);
+
+  boost::shared_ptr<ConstraintSet> cs = parser.Parse(
+      "<0\"N\"> = <1\"N\"> <1\"C\"> = \"nom\"");
+  CompiledConstraintSet compiled(*cs);
+  ConstraintEvaluator evaluator;
+
+  // Three sets of child interpretations for index 0.  The first two differ
+  // only in an unconstrained value.
+  std::vector<std::vector<Interpretation> > children(3);
+  const char *child_options[] = {
+    "[N:sg;L:a]", "[N:sg;L:b]", "[N:pl;L:a]"
+  };
+  for (int i = 0; i < 3; ++i) {
+    OptionTable table;
+    std::vector<std::string> options;
+    options += child_options[i];
+    AddColumn(options, fs_parser, 0, table);
+    BOOST_REQUIRE(evaluator.Eval(table, *cs, children[i]));
+  }
+
+  OptionTable table;
+  {
+    std::vector<std::string> options;
+    options += "[N:sg;C:nom]", "[N:pl;C:nom]", "[N:sg;C:acc]";
+    AddColumn(options, fs_parser, 1, table);
+  }
+
+  ConstraintEvaluationCache cache(2);
+  std::vector<Interpretation> expected;
+  std::vector<Interpretation> results;
+
+  BOOST_CHECK(evaluator.Eval(children[0], table, compiled, expected));
+  BOOST_CHECK(cache.Eval(evaluator, 7, children[0], table, compiled,
+                         results));
+  BOOST_CHECK_EQUAL(cache.NumHits(), 0);
+  BOOST_CHECK_EQUAL(cache.NumMisses(), 1);
+  BOOST_CHECK_EQUAL(results.size(), expected.size());
+
+  results.clear();
+  BOOST_CHECK(cache.Eval(evaluator, 7, children[0], table, compiled,
+                         results));
+  BOOST_CHECK_EQUAL(cache.NumHits(), 1);
+  BOOST_CHECK_EQUAL(results.size(), expected.size());
+
+  // Only the constrained values are part of the signature.
+  BOOST_CHECK(cache.Eval(evaluator, 7, children[1], table, compiled,
+                         results));
+  BOOST_CHECK_EQUAL(cache.NumHits(), 2);
+
+  // A different constraint set ID or constrained value is a miss.
+  BOOST_CHECK(cache.Eval(evaluator, 8, children[0], table, compiled,
+                         results));
+  BOOST_CHECK(cache.Eval(evaluator, 7, children[2], table, compiled,
+                         results));
+  BOOST_CHECK_EQUAL(cache.NumHits(), 2);
+  BOOST_CHECK_EQUAL(cache.NumMisses(), 3);
+  BOOST_CHECK(evaluator.Eval(children[2], table, compiled, expected));
+  BOOST_CHECK_EQUAL(results.size(), expected.size());
+
+  // The capacity is two, so the least recently used entry (ID 7 with the
+  // first children) has been evicted.
+  BOOST_CHECK_EQUAL(cache.Size(), 2);
+  BOOST_CHECK(cache.Eval(evaluator, 7, children[0], table, compiled,
+                         results));
+  BOOST_CHECK_EQUAL(cache.NumMisses(), 4);
+  BOOST_CHECK(cache.Eval(evaluator, 7, children[2], table, compiled,
+                         results));
+  BOOST_CHECK_EQUAL(cache.NumHits(), 3);
+}
+
+// Tests that an option on an index that the interpretations already cover is
+// compared in full, since it is unified with the earlier value at the root.
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluationCacheCoveredIndex) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser fs_parser(feature_set, value_set);
+  ConstraintSetParser parser(feature_set, value_set);
+
+  boost::shared_ptr<ConstraintSet> cs = parser.Parse("<0\"N\"> = <1\"N\">");
+  CompiledConstraintSet compiled(*cs);
+  ConstraintEvaluator evaluator;
+
+  // Two sets of interpretations that differ only in the unconstrained L.
+  std::vector<std::vector<Interpretation> > prev(2);
+  const char *prev_options[] = { "[N:sg;L:a]", "[N:sg;L:b]" };
+  for (int i = 0; i < 2; ++i) {
+    OptionTable table;
+    std::vector<std::string> options0, options1;
+    options0 += prev_options[i];
+    options1 += "[N:sg]";
+    AddColumn(options0, fs_parser, 0, table);
+    AddColumn(options1, fs_parser, 1, table);
+    BOOST_REQUIRE(evaluator.Eval(table, *cs, prev[i]));
+  }
+
+  OptionTable table;
+  {
+    std::vector<std::string> options;
+    options += "[L:a]";
+    AddColumn(options, fs_parser, 0, table);
+  }
+
+  ConstraintEvaluationCache cache(4);
+  std::vector<Interpretation> results;
+  BOOST_CHECK(evaluator.Eval(prev[0], table, compiled, results));
+  BOOST_CHECK(!evaluator.Eval(prev[1], table, compiled, results));
+  BOOST_CHECK(cache.Eval(evaluator, 1, prev[0], table, compiled, results));
+  BOOST_CHECK(!cache.Eval(evaluator, 1, prev[1], table, compiled, results));
+  BOOST_CHECK_EQUAL(cache.NumHits(), 0);
+  BOOST_CHECK_EQUAL(cache.NumMisses(), 2);
+}
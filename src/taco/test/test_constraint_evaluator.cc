@@ -2,8 +2,12 @@
 
 #include "taco/constraint_evaluator.h"
 
+#include "taco/bitset_feature_structure.h"
+#include "taco/compiled_constraint_set.h"
 #include "taco/constraint.h"
+#include "taco/constraint_evaluator_stats.h"
 #include "taco/constraint_set.h"
+#include "taco/constraint_set_set.h"
 #include "taco/feature_structure.h"
 #include "taco/interpretation.h"
 #include "taco/option_table.h"
@@ -14,6 +18,8 @@
 #include <boost/assign/std/set.hpp>
 #include <boost/assign/std/vector.hpp>
 
+#include <iterator>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -583,3 +589,699 @@ BOOST_AUTO_TEST_CASE(TestConstraintEvaluator8) {
     BOOST_CHECK(interpretations.size() == 1);
   }
 }
+
+// Checks that evaluation does not modify the option feature structures, which
+// may be shared with the resulting interpretations.
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorOptionsUnchanged) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  OptionTable option_table;
+
+  {
+    std::vector<std::string> options;
+    options += "[AGR:[CASE:nom;DECL:weak;NUMBER:pl];LEMMA:die;POS:ART]",
+               "[AGR:[CASE:acc;DECL:weak;GENDER:f;NUMBER:sg];LEMMA:die;POS:ART]";
+    size_t index = 1;
+    ParseAndAddOptions(options, fs_parser, index, option_table);
+  }
+
+  {
+    std::vector<std::string> options;
+    options += "[AGR:[CASE:acc;GENDER:f;NUMBER:sg];LEMMA:Katze;POS:NN]",
+               "[AGR:[CASE:nom;GENDER:f;NUMBER:sg];LEMMA:Katze;POS:NN]";
+    size_t index = 2;
+    ParseAndAddOptions(options, fs_parser, index, option_table);
+  }
+
+  option_table.AddWildcardColumn(0);
+
+  // Take copies of the options for comparison.
+  std::vector<boost::shared_ptr<FeatureStructure> > copies;
+  for (OptionTable::const_iterator p = option_table.begin();
+       p != option_table.end(); ++p) {
+    for (OptionColumn::const_iterator q = p->second.begin();
+         q != p->second.end(); ++q) {
+      copies.push_back((*q)->Clone());
+    }
+  }
+
+  std::string s = std::string("<0\"AGR\">=<1\"AGR\">")
+                + std::string("<0\"AGR\">=<2\"AGR\">")
+                + std::string("<1\"AGR\"\"DECL\">=\"weak\"")
+                + std::string("<2\"POS\">=\"NN\"");
+
+  ConstraintSetParser parser(feature_set, value_set);
+  boost::shared_ptr<ConstraintSet> cs = parser.Parse(s);
+
+  ConstraintEvaluator evaluator;
+  std::vector<Interpretation> interpretations;
+  BOOST_CHECK(evaluator.Eval(option_table, *cs, interpretations));
+  BOOST_CHECK(interpretations.size() == 1);
+
+  std::vector<Interpretation> extended;
+  OptionTable new_table;
+  new_table.AddWildcardColumn(3);
+  BOOST_CHECK(evaluator.Eval(interpretations, new_table, *cs, extended));
+  BOOST_CHECK(extended.size() == 1);
+
+  BadFeatureStructureEqualityPred equal;
+  std::vector<boost::shared_ptr<FeatureStructure> >::const_iterator r =
+      copies.begin();
+  for (OptionTable::const_iterator p = option_table.begin();
+       p != option_table.end(); ++p) {
+    for (OptionColumn::const_iterator q = p->second.begin();
+         q != p->second.end(); ++q) {
+      BOOST_CHECK(equal(**q, **r++));
+    }
+  }
+}
+
+// Tests that setting a bitset layout does not change the results.
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorBitsetLayout) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  OptionTable option_table;
+  {
+    std::vector<std::string> options;
+    options += "[AGR:[CASE:nom;NUM:sg]]",
+               "[AGR:[CASE:acc;NUM:sg]]",
+               "[AGR:[CASE:dat;NUM:pl]]";
+    ParseAndAddOptions(options, fs_parser, 0, option_table);
+  }
+  {
+    std::vector<std::string> options;
+    options += "[AGR:[CASE:nom]]",
+               "[AGR:[CASE:dat]]",
+               "[AGR:[CASE:gen;NUM:pl]]";
+    ParseAndAddOptions(options, fs_parser, 1, option_table);
+  }
+  {
+    std::vector<std::string> options;
+    options += "[AGR:[NUM:sg]]",
+               "[AGR:[NUM:pl;X:[Y:z]]]",
+               "[]";
+    ParseAndAddOptions(options, fs_parser, 2, option_table);
+  }
+
+  Feature AGR = feature_set.Lookup("AGR");
+  FeaturePath path(1, AGR);
+  std::vector<boost::shared_ptr<const FeatureStructure> > values;
+  for (OptionTable::const_iterator p = option_table.begin();
+       p != option_table.end(); ++p) {
+    for (OptionColumn::const_iterator q = p->second.begin();
+         q != p->second.end(); ++q) {
+      boost::shared_ptr<const FeatureStructure> value = (*q)->Get(AGR);
+      if (value) {
+        values.push_back(value);
+      }
+    }
+  }
+  boost::shared_ptr<const BitsetLayout> layout(
+      new BitsetLayout(values.begin(), values.end()));
+
+  ConstraintSetParser parser(feature_set, value_set);
+  boost::shared_ptr<ConstraintSet> constraint_set =
+      parser.Parse("<0\"AGR\"> = <1\"AGR\"> <2\"AGR\"> = <0\"AGR\">");
+
+  ConstraintEvaluator evaluator1;
+  ConstraintEvaluator evaluator2;
+  evaluator2.SetBitsetLayout(path, layout);
+
+  std::vector<Interpretation> interpretations1;
+  std::vector<Interpretation> interpretations2;
+  BOOST_CHECK(evaluator1.Eval(option_table, *constraint_set,
+                              interpretations1));
+  BOOST_CHECK(evaluator2.Eval(option_table, *constraint_set,
+                              interpretations2));
+  BOOST_CHECK(interpretations1.size() == 4);
+  BOOST_CHECK(interpretations2.size() == interpretations1.size());
+}
+
+// Tests absolute constraints on option values that are atomic, complex,
+// empty or missing.  An empty value can be made atomic by a relational
+// constraint and must not be rejected in advance.
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorOptionValues) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  OptionTable option_table;
+  {
+    std::vector<std::string> options;
+    options += "[CASE:nom]";
+    ParseAndAddOptions(options, fs_parser, 0, option_table);
+  }
+  {
+    std::vector<std::string> options;
+    options += "[CASE:nom]",
+               "[CASE:acc]",
+               "[CASE:[X:y]]",
+               "[CASE:[]]",
+               "[]";
+    ParseAndAddOptions(options, fs_parser, 1, option_table);
+  }
+
+  ConstraintSetParser parser(feature_set, value_set);
+  ConstraintEvaluator evaluator;
+
+  {
+    boost::shared_ptr<ConstraintSet> constraint_set =
+        parser.Parse("<1\"CASE\"> = \"nom\"");
+    std::vector<Interpretation> interpretations;
+    BOOST_CHECK(evaluator.Eval(option_table, *constraint_set,
+                               interpretations));
+    BOOST_CHECK(interpretations.size() == 2);
+  }
+
+  {
+    boost::shared_ptr<ConstraintSet> constraint_set =
+        parser.Parse("<0\"CASE\"> = <1\"CASE\"> <1\"CASE\"> = \"nom\"");
+    std::vector<Interpretation> interpretations;
+    BOOST_CHECK(evaluator.Eval(option_table, *constraint_set,
+                               interpretations));
+    BOOST_CHECK(interpretations.size() == 3);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorColumnOrder) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  // Whatever order the columns are evaluated in, the interpretations must
+  // cover every column.  Column 5 is unconstrained.
+  OptionTable option_table;
+  {
+    std::vector<std::string> options;
+    options += "[A:x]", "[A:y]", "[A:x]";
+    ParseAndAddOptions(options, fs_parser, 0, option_table);
+  }
+  {
+    std::vector<std::string> options;
+    options += "[A:x;B:p]";
+    ParseAndAddOptions(options, fs_parser, 1, option_table);
+  }
+  {
+    std::vector<std::string> options;
+    options += "[B:p]", "[B:q]";
+    ParseAndAddOptions(options, fs_parser, 2, option_table);
+  }
+  {
+    std::vector<std::string> options;
+    options += "[C:u]", "[C:v]";
+    ParseAndAddOptions(options, fs_parser, 5, option_table);
+  }
+
+  ConstraintSetParser parser(feature_set, value_set);
+  ConstraintEvaluator evaluator;
+
+  {
+    boost::shared_ptr<ConstraintSet> constraint_set =
+        parser.Parse("<0\"A\"> = <1\"A\"> <1\"B\"> = <2\"B\">");
+    std::vector<Interpretation> interpretations;
+    BOOST_CHECK(evaluator.Eval(option_table, *constraint_set,
+                               interpretations));
+    BOOST_CHECK(interpretations.size() == 4);
+    FeaturePath path;
+    path.push_back(feature_set.Lookup("A"));
+    for (std::vector<Interpretation>::const_iterator p =
+         interpretations.begin(); p != interpretations.end(); ++p) {
+      BOOST_CHECK(std::distance(p->begin(), p->end()) == 4);
+      BOOST_REQUIRE(p->GetFS(0));
+      BOOST_CHECK(p->GetFS(0)->Get(path.begin(), path.end())->GetAtomicValue()
+                  == value_set.Lookup("x"));
+    }
+  }
+
+  // No option of column 2 can satisfy the constraints, so evaluation fails
+  // before any interpretation is built.
+  {
+    boost::shared_ptr<ConstraintSet> constraint_set = parser.Parse(
+        "<0\"A\"> = <1\"A\"> <1\"B\"> = <2\"B\"> <2\"B\"> = \"r\"");
+    std::vector<Interpretation> interpretations;
+    BOOST_CHECK(!evaluator.Eval(option_table, *constraint_set,
+                                interpretations));
+    BOOST_CHECK(interpretations.empty());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorFirstSolution) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+  ConstraintSetParser parser(feature_set, value_set);
+  ConstraintEvaluator evaluator;
+
+  boost::shared_ptr<ConstraintSet> constraint_set =
+      parser.Parse("<0\"A\"> = <1\"A\"> <1\"B\"> = <2\"B\">");
+
+  std::vector<std::string> options0, options1;
+  options0 += "[A:y]";
+  options1 += "[A:x;B:q]", "[A:y;B:q]", "[A:y;B:p]";
+
+  // The search must backtrack over the options for element 1.
+  {
+    OptionTable option_table;
+    ParseAndAddOptions(options0, fs_parser, 0, option_table);
+    ParseAndAddOptions(options1, fs_parser, 1, option_table);
+    std::vector<std::string> options2;
+    options2 += "[B:p]";
+    ParseAndAddOptions(options2, fs_parser, 2, option_table);
+    BOOST_CHECK(evaluator.Eval(option_table, *constraint_set));
+    std::vector<Interpretation> interpretations;
+    BOOST_CHECK(evaluator.Eval(option_table, *constraint_set,
+                               interpretations));
+    BOOST_CHECK(interpretations.size() == 1);
+  }
+
+  {
+    OptionTable option_table;
+    ParseAndAddOptions(options0, fs_parser, 0, option_table);
+    ParseAndAddOptions(options1, fs_parser, 1, option_table);
+    std::vector<std::string> options2;
+    options2 += "[B:r]";
+    ParseAndAddOptions(options2, fs_parser, 2, option_table);
+    BOOST_CHECK(!evaluator.Eval(option_table, *constraint_set));
+    std::vector<Interpretation> interpretations;
+    BOOST_CHECK(!evaluator.Eval(option_table, *constraint_set,
+                                interpretations));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorPruning) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  OptionTable option_table;
+  {
+    std::vector<std::string> options;
+    options += "[N:sg]", "[N:pl]";
+    ParseAndAddOptions(options, fs_parser, 0, option_table);
+    ParseAndAddOptions(options, fs_parser, 1, option_table);
+  }
+
+  // The interpretations have probabilities 0.72, 0.18, 0.08, and 0.02.
+  ConstraintSetParser parser(feature_set, value_set);
+  boost::shared_ptr<ConstraintSet> constraint_set = parser.Parse(
+      std::string("<0\"N\"> = {\"sg\":0.9,\"pl\":0.1} ") +
+      std::string("<1\"N\"> = {\"sg\":0.8,\"pl\":0.2}"));
+
+  {
+    ConstraintEvaluator evaluator;
+    std::vector<Interpretation> interpretations;
+    BOOST_CHECK(evaluator.Eval(option_table, *constraint_set,
+                               interpretations));
+    BOOST_CHECK(interpretations.size() == 4);
+  }
+
+  {
+    ConstraintEvaluator evaluator;
+    evaluator.SetMinProbability(0.1f);
+    std::vector<Interpretation> interpretations;
+    BOOST_CHECK(evaluator.Eval(option_table, *constraint_set,
+                               interpretations));
+    BOOST_CHECK(interpretations.size() == 2);
+    for (std::vector<Interpretation>::const_iterator p =
+         interpretations.begin(); p != interpretations.end(); ++p) {
+      BOOST_CHECK(p->probability() >= 0.1f);
+    }
+    evaluator.SetMinProbability(0.7f);
+    BOOST_CHECK(evaluator.Eval(option_table, *constraint_set));
+    evaluator.SetMinProbability(0.75f);
+    BOOST_CHECK(!evaluator.Eval(option_table, *constraint_set));
+  }
+
+  {
+    ConstraintEvaluator evaluator;
+    evaluator.SetBeamWidth(1);
+    std::vector<Interpretation> interpretations;
+    BOOST_CHECK(evaluator.Eval(option_table, *constraint_set,
+                               interpretations));
+    BOOST_REQUIRE(interpretations.size() == 1);
+    BOOST_CHECK_CLOSE(interpretations[0].probability(), 0.72f, 0.001);
+  }
+}
+
+// Tests that the third form of Eval does not count the variable constraints
+// on indices covered by the previous interpretations, whose probabilities
+// already include them, when pruning.
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorPruningPrev) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  OptionTable option_table;
+  {
+    std::vector<std::string> options;
+    options += "[L:a]";
+    ParseAndAddOptions(options, fs_parser, 2, option_table);
+  }
+  {
+    std::vector<std::string> options;
+    options += "[CASE:nom]";
+    ParseAndAddOptions(options, fs_parser, 3, option_table);
+  }
+
+  ConstraintSetParser parser(feature_set, value_set);
+  boost::shared_ptr<ConstraintSet> constraint_set =
+      parser.Parse("<3\"CASE\"> = {\"nom\":0.5,\"acc\":0.1}");
+  CompiledConstraintSet compiled(*constraint_set);
+
+  std::vector<Interpretation> prev;
+  {
+    ConstraintEvaluator evaluator;
+    BOOST_REQUIRE(evaluator.Eval(option_table, *constraint_set, prev));
+    BOOST_REQUIRE(prev.size() == 1);
+    BOOST_CHECK_CLOSE(prev[0].probability(), 0.5f, 0.001);
+  }
+
+  ConstraintEvaluator evaluator;
+  evaluator.SetMinProbability(0.4f);
+  std::vector<Interpretation> interpretations;
+  BOOST_CHECK(evaluator.Eval(prev, option_table, compiled, interpretations));
+  BOOST_REQUIRE(interpretations.size() == 1);
+  BOOST_CHECK_CLOSE(interpretations[0].probability(), 0.5f, 0.001);
+}
+
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorRecombination) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  // The options for element 1 only differ outside of the constrained paths.
+  // Element 2 is unconstrained.
+  OptionTable option_table;
+  {
+    std::vector<std::string> options;
+    options += "[N:sg]", "[N:pl]";
+    ParseAndAddOptions(options, fs_parser, 0, option_table);
+  }
+  {
+    std::vector<std::string> options;
+    options += "[N:sg;L:a]", "[N:sg;L:b]", "[N:[];L:c]";
+    ParseAndAddOptions(options, fs_parser, 1, option_table);
+  }
+  {
+    std::vector<std::string> options;
+    options += "[L:d]", "[L:e]";
+    ParseAndAddOptions(options, fs_parser, 2, option_table);
+  }
+
+  ConstraintSetParser parser(feature_set, value_set);
+  boost::shared_ptr<ConstraintSet> constraint_set = parser.Parse(
+      std::string("<0\"N\"> = <1\"N\"> ") +
+      std::string("<0\"N\"> = {\"sg\":0.9,\"pl\":0.1}"));
+
+  ConstraintEvaluator evaluator;
+  std::vector<Interpretation> interpretations;
+  BOOST_CHECK(evaluator.Eval(option_table, *constraint_set, interpretations));
+  BOOST_CHECK(interpretations.size() == 8);
+
+  // After recombination, there is one interpretation with <0 N> = sg and one
+  // with <0 N> = pl.
+  evaluator.SetRecombination(true);
+  BOOST_CHECK(evaluator.Eval(option_table, *constraint_set, interpretations));
+  BOOST_REQUIRE(interpretations.size() == 2);
+  float total = interpretations[0].probability() +
+                interpretations[1].probability();
+  BOOST_CHECK_CLOSE(total, 1.0f, 0.001);
+}
+
+// Tests that recombination in the third form of Eval does not merge
+// interpretations whose values at an index still to be unified with an option
+// differ outside of the constrained paths.
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorRecombinationPrev) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  ConstraintSetParser parser(feature_set, value_set);
+  boost::shared_ptr<ConstraintSet> constraint_set =
+      parser.Parse("<0\"N\"> = <1\"N\">");
+  CompiledConstraintSet compiled(*constraint_set);
+
+  // The previous interpretations only differ in the value of <0 L>.
+  std::vector<Interpretation> prev;
+  {
+    OptionTable option_table;
+    std::vector<std::string> options0;
+    options0 += "[N:sg;L:a]", "[N:sg;L:b]";
+    ParseAndAddOptions(options0, fs_parser, 0, option_table);
+    std::vector<std::string> options1;
+    options1 += "[N:sg]";
+    ParseAndAddOptions(options1, fs_parser, 1, option_table);
+    ConstraintEvaluator evaluator;
+    BOOST_REQUIRE(evaluator.Eval(option_table, *constraint_set, prev));
+    BOOST_REQUIRE(prev.size() == 2);
+  }
+
+  // Only the interpretation with <0 L> = b is consistent with the options.
+  // Column 0 has more options, so it is evaluated after column 1.
+  OptionTable option_table;
+  {
+    std::vector<std::string> options;
+    options += "[L:b]", "[L:c]";
+    ParseAndAddOptions(options, fs_parser, 0, option_table);
+  }
+  {
+    std::vector<std::string> options;
+    options += "[N:sg]";
+    ParseAndAddOptions(options, fs_parser, 1, option_table);
+  }
+
+  ConstraintEvaluator evaluator;
+  std::vector<Interpretation> interpretations;
+  BOOST_CHECK(evaluator.Eval(prev, option_table, compiled, interpretations));
+  BOOST_CHECK(interpretations.size() == 1);
+
+  evaluator.SetRecombination(true);
+  BOOST_CHECK(evaluator.Eval(prev, option_table, compiled, interpretations));
+  BOOST_CHECK(interpretations.size() == 1);
+}
+
+// Tests that a multi-threaded evaluator finds the same interpretations, in
+// the same order, as a single-threaded one.
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorThreads) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  OptionTable option_table;
+  {
+    std::vector<std::string> options;
+    options += "[N:sg;G:m]", "[N:sg;G:f]", "[N:sg;G:n]", "[N:sg]",
+               "[N:pl;G:m]", "[N:pl;G:f]", "[N:pl;G:n]", "[N:pl]",
+               "[N:du;G:m]", "[N:du;G:f]", "[N:du;G:n]", "[N:du]";
+    ParseAndAddOptions(options, fs_parser, 0, option_table);
+    ParseAndAddOptions(options, fs_parser, 1, option_table);
+    ParseAndAddOptions(options, fs_parser, 2, option_table);
+  }
+
+  ConstraintSetParser parser(feature_set, value_set);
+  boost::shared_ptr<ConstraintSet> cs1 = parser.Parse(
+      std::string("<0\"N\"> = <1\"N\"> <1\"G\"> = <2\"G\"> ") +
+      std::string("<2\"N\"> = {\"sg\":0.5,\"pl\":0.3,\"du\":0.2}"));
+  boost::shared_ptr<ConstraintSet> cs2 = parser.Parse(
+      std::string("<0\"N\"> = \"pl\" <1\"G\"> = <2\"G\">"));
+
+  ConstraintEvaluator serial;
+  ConstraintEvaluator parallel;
+  parallel.SetNumThreads(4);
+
+  BadFeatureStructureEqualityPred equal;
+
+  std::vector<Interpretation> expected;
+  std::vector<Interpretation> actual;
+  BOOST_CHECK(serial.Eval(option_table, *cs1, expected));
+  BOOST_CHECK(parallel.Eval(option_table, *cs1, actual));
+  BOOST_REQUIRE(!expected.empty());
+  BOOST_REQUIRE(actual.size() == expected.size());
+  for (std::size_t i = 0; i < actual.size(); ++i) {
+    BOOST_CHECK_EQUAL(actual[i].probability(), expected[i].probability());
+    for (int index = 0; index < 3; ++index) {
+      BOOST_CHECK(equal(*actual[i].GetFS(index), *expected[i].GetFS(index)));
+    }
+  }
+
+  std::vector<ConstraintEvaluator::Query> queries;
+  queries += std::make_pair(&option_table, cs1.get()),
+             std::make_pair(&option_table, cs2.get());
+  std::vector<std::vector<Interpretation> > results;
+  std::vector<bool> found;
+  parallel.EvalBatch(queries, results, found);
+  BOOST_REQUIRE(results.size() == 2);
+  BOOST_REQUIRE(found.size() == 2);
+  BOOST_CHECK(found[0] && found[1]);
+  BOOST_CHECK(results[0].size() == expected.size());
+  BOOST_CHECK(serial.Eval(option_table, *cs2, expected));
+  BOOST_CHECK(results[1].size() == expected.size());
+}
+
+// Tests that evaluating a ConstraintSetSet gives the same results as
+// evaluating each constraint set separately.
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorEvalBatch) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  OptionTable option_table;
+  {
+    std::vector<std::string> options;
+    options += "[N:sg;C:nom]", "[N:pl;C:nom]", "[N:sg;C:acc]";
+    ParseAndAddOptions(options, fs_parser, 0, option_table);
+    ParseAndAddOptions(options, fs_parser, 1, option_table);
+  }
+
+  ConstraintSetParser parser(feature_set, value_set);
+  ConstraintSetSet constraint_sets;
+  constraint_sets.insert(parser.Parse("<0\"N\"> = <1\"N\">"));
+  constraint_sets.insert(parser.Parse("<0\"C\"> = \"dat\""));
+  constraint_sets.insert(parser.Parse(
+      "<0\"C\"> = \"dat\" <0\"N\"> = <1\"N\">"));
+  constraint_sets.insert(parser.Parse(
+      "<0\"N\"> = <1\"N\"> <1\"C\"> = \"acc\""));
+  constraint_sets.insert(parser.Parse(
+      "<0\"N\"> = {\"sg\":0.6,\"pl\":0.4} <1\"C\"> = \"nom\""));
+
+  for (int num_threads = 1; num_threads <= 2; ++num_threads) {
+    ConstraintEvaluator evaluator;
+    evaluator.SetNumThreads(num_threads);
+    std::vector<std::vector<Interpretation> > results;
+    std::vector<bool> found;
+    evaluator.EvalBatch(option_table, constraint_sets, results, found);
+    BOOST_REQUIRE(results.size() == constraint_sets.size());
+    BOOST_REQUIRE(found.size() == constraint_sets.size());
+    std::size_t i = 0;
+    for (ConstraintSetSet::const_iterator p = constraint_sets.begin();
+         p != constraint_sets.end(); ++p, ++i) {
+      std::vector<Interpretation> expected;
+      BOOST_CHECK_EQUAL(found[i], evaluator.Eval(option_table, **p,
+                                                 expected));
+      BOOST_REQUIRE_EQUAL(results[i].size(), expected.size());
+      for (std::size_t j = 0; j < expected.size(); ++j) {
+        BOOST_CHECK_EQUAL(results[i][j].probability(),
+                          expected[j].probability());
+      }
+    }
+  }
+}
+
+// Tests the counts recorded by ConstraintEvaluatorStats, with and without
+// threads.
+BOOST_AUTO_TEST_CASE(TestConstraintEvaluatorStats) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  OptionTable option_table;
+  {
+    std::vector<std::string> options;
+    options += "[N:sg;C:nom]", "[N:pl;C:nom]", "[N:sg;C:acc]";
+    ParseAndAddOptions(options, fs_parser, 0, option_table);
+    ParseAndAddOptions(options, fs_parser, 1, option_table);
+  }
+
+  ConstraintSetParser parser(feature_set, value_set);
+  boost::shared_ptr<ConstraintSet> cs = parser.Parse(
+      "<0\"C\"> = \"nom\" <0\"N\"> = <1\"N\">");
+
+  for (int num_threads = 1; num_threads <= 2; ++num_threads) {
+    ConstraintEvaluator evaluator;
+    evaluator.SetNumThreads(num_threads);
+    ConstraintEvaluatorStats stats;
+    evaluator.SetStats(&stats);
+
+    std::vector<Interpretation> results;
+    BOOST_CHECK(evaluator.Eval(option_table, *cs, results));
+    BOOST_CHECK_EQUAL(results.size(), 3);
+
+    // Column 0 is evaluated first since the absolute constraint leaves it
+    // with two options.  Each is paired with all three options of column 1.
+    BOOST_CHECK_EQUAL(stats.num_evals, 1);
+    BOOST_CHECK_EQUAL(stats.num_plan_failures, 0);
+    BOOST_CHECK_EQUAL(stats.num_columns, 2);
+    BOOST_CHECK_EQUAL(stats.num_abs_rejections, 1);
+    BOOST_CHECK_EQUAL(stats.num_var_rejections, 0);
+    BOOST_CHECK_EQUAL(stats.num_candidates, 2 + 6);
+    BOOST_CHECK_EQUAL(stats.num_quick_unifications, 6);
+    BOOST_CHECK_EQUAL(stats.num_rel_rejections, 3);
+    BOOST_CHECK_EQUAL(stats.num_clones, 2 + 3);
+    BOOST_CHECK_EQUAL(stats.num_eval_failures, 0);
+    BOOST_CHECK_EQUAL(stats.num_pruned, 0);
+    BOOST_REQUIRE_EQUAL(stats.max_results.size(), 2);
+    BOOST_CHECK_EQUAL(stats.max_results[0], 2);
+    BOOST_CHECK_EQUAL(stats.max_results[1], 3);
+
+    // Disabling the stats leaves the counts alone.
+    evaluator.SetStats(0);
+    BOOST_CHECK(evaluator.Eval(option_table, *cs, results));
+    BOOST_CHECK_EQUAL(stats.num_evals, 1);
+
+    ConstraintEvaluatorStats total;
+    total.Merge(stats);
+    total.Merge(stats);
+    BOOST_CHECK_EQUAL(total.num_candidates, 2 * stats.num_candidates);
+    BOOST_CHECK_EQUAL(total.max_results[1], 3);
+
+    std::ostringstream out;
+    stats.Dump(out);
+    BOOST_CHECK(out.str().find("candidates: 8\n") != std::string::npos);
+
+    stats.Clear();
+    BOOST_CHECK_EQUAL(stats.num_candidates, 0);
+    BOOST_CHECK(stats.max_results.empty());
+  }
+}
@@ -43,3 +43,46 @@ BOOST_AUTO_TEST_CASE(TestConstraintSet) {
   BOOST_CHECK(!orderer(cs1, cs2));
   BOOST_CHECK(!orderer(cs2, cs1));
 }
+
+BOOST_AUTO_TEST_CASE(TestConstraintSetModifiablePaths) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+
+  Feature A = feature_set.Insert("A");
+  Feature B = feature_set.Insert("B");
+  Feature C = feature_set.Insert("C");
+
+  FeaturePath path1, path2, path3;
+  path1 += A;
+  path2 += A, B;
+  path3 += C, B;
+
+  ConstraintSet cs;
+  cs.abs_set().Insert(boost::shared_ptr<AbsConstraint>(
+      new AbsConstraint(PathTerm(1, path3), ValueTerm(0))));
+  cs.rel_set().Insert(boost::shared_ptr<RelConstraint>(
+      new RelConstraint(PathTerm(1, path2), PathTerm(2, path1))));
+  cs.rel_set().Insert(boost::shared_ptr<RelConstraint>(
+      new RelConstraint(PathTerm(1, path1), PathTerm(2, FeaturePath()))));
+
+  // Index 1: the value at A is unified in full (so A B is pruned) and C B can
+  // have a value added.
+  {
+    FeatureTree tree;
+    cs.GetModifiablePaths(1, tree);
+    BOOST_CHECK(tree.children_.size() == 2);
+    BOOST_CHECK(tree.children_.count(A) == 1);
+    BOOST_CHECK(tree.children_[A]->Empty());
+    BOOST_CHECK(tree.children_.count(C) == 1);
+    BOOST_CHECK(tree.children_[C]->children_.count(B) == 1);
+  }
+
+  // Index 2: the whole feature structure is unified.
+  {
+    FeatureTree tree;
+    cs.GetModifiablePaths(2, tree);
+    BOOST_CHECK(tree.Empty());
+  }
+}
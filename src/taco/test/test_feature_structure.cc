@@ -1,6 +1,7 @@
 #include <boost/test/unit_test.hpp>
 
 #include "taco/feature_structure.h"
+#include "taco/feature_structure_interner.h"
 
 #include "taco/base/utility.h"
 #include "taco/base/vocabulary.h"
@@ -1062,3 +1063,582 @@ BOOST_AUTO_TEST_CASE(TestMultiClone) {
     BOOST_CHECK(w2 == v2);
   }
 }
+
+// Tests that a clone preserves reentrancy and is independent of the original.
+BOOST_AUTO_TEST_CASE(TestCloneIndependence) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  const Feature A = feature_set.Insert("A");
+  const Feature B = feature_set.Insert("B");
+  const Feature C = feature_set.Insert("C");
+  const Feature D = feature_set.Insert("D");
+
+  const AtomicValue x = value_set.Insert("x");
+  const AtomicValue y = value_set.Insert("y");
+
+  FeatureStructureSpec spec;
+  {
+    FeaturePath path1, path2, path3;
+    path1 += B, C;
+    path2 += A;
+    path3 += B;
+    spec.content_pairs += std::make_pair(path1, x);
+    spec.equiv_pairs += std::make_pair(path2, path3);
+  }
+
+  SPFS fs(new FeatureStructure(spec));
+  SPFS clone = fs->Clone();
+
+  FeaturePath path1, path2, path3;
+  path1 += A;
+  path2 += B;
+  path3 += B, D;
+
+  // The clone's A and B values should be shared with each other but not with
+  // the original.
+  SPFS v1 = clone->Get(path1.begin(), path1.end());
+  SPFS v2 = clone->Get(path2.begin(), path2.end());
+  BOOST_CHECK(v1);
+  BOOST_CHECK(v1 == v2);
+  BOOST_CHECK(v1 != fs->Get(path1.begin(), path1.end()));
+
+  // Adding a value to the clone should affect both of its paths but leave
+  // the original unchanged.
+  v1->CreateAtomicValue(path3.begin() + 1, path3.end(), y);
+  SPFS w1 = clone->Get(path3.begin(), path3.end());
+  BOOST_CHECK(w1);
+  BOOST_CHECK(w1->IsAtomic());
+  BOOST_CHECK(w1->GetAtomicValue() == y);
+  BOOST_CHECK(!fs->Get(path3.begin(), path3.end()));
+}
+
+// Tests that PartialClone copies values on the tree's paths and shares the
+// others, and that it falls back to a full clone if there is reentrancy.
+BOOST_AUTO_TEST_CASE(TestPartialClone) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  const Feature A = feature_set.Insert("A");
+  const Feature B = feature_set.Insert("B");
+  const Feature C = feature_set.Insert("C");
+  const Feature D = feature_set.Insert("D");
+
+  const AtomicValue x = value_set.Insert("x");
+  const AtomicValue y = value_set.Insert("y");
+  const AtomicValue z = value_set.Insert("z");
+
+  // Tree containing the path A C.
+  FeatureTree tree;
+  tree.children_[A].reset(new FeatureTree());
+  tree.children_[A]->children_[C].reset(new FeatureTree());
+
+  FeaturePath path1, path2, path3, path4;
+  path1 += A;
+  path2 += A, C;
+  path3 += A, D;
+  path4 += B;
+
+  {
+    FeatureStructureSpec spec;
+    spec.content_pairs += std::make_pair(path2, x),
+                          std::make_pair(path3, y),
+                          std::make_pair(path4, z);
+    SPFS fs(new FeatureStructure(spec));
+    SPFS copy = fs->PartialClone(tree);
+
+    BOOST_CHECK(copy != fs);
+    BOOST_CHECK(copy->Get(path1.begin(), path1.end()) !=
+                fs->Get(path1.begin(), path1.end()));
+    BOOST_CHECK(copy->Get(path2.begin(), path2.end()) !=
+                fs->Get(path2.begin(), path2.end()));
+    BOOST_CHECK(copy->Get(path3.begin(), path3.end()) ==
+                fs->Get(path3.begin(), path3.end()));
+    BOOST_CHECK(copy->Get(path4.begin(), path4.end()) ==
+                fs->Get(path4.begin(), path4.end()));
+
+    BadFeatureStructureEqualityPred equal;
+    BOOST_CHECK(equal(*copy, *fs));
+
+    // Sharing values with the first copy doesn't prevent sharing with the
+    // second.
+    SPFS copy2 = fs->PartialClone(tree);
+    BOOST_CHECK(copy2->Get(path2.begin(), path2.end()) !=
+                fs->Get(path2.begin(), path2.end()));
+    BOOST_CHECK(copy2->Get(path3.begin(), path3.end()) ==
+                fs->Get(path3.begin(), path3.end()));
+    BOOST_CHECK(copy2->Get(path4.begin(), path4.end()) ==
+                fs->Get(path4.begin(), path4.end()));
+  }
+
+  // An interned feature structure shares its values with other interned
+  // feature structures, but is not reentrant.
+  {
+    FeatureStructureSpec spec;
+    spec.content_pairs += std::make_pair(path2, x),
+                          std::make_pair(path3, y),
+                          std::make_pair(path4, y);
+    FeatureStructureInterner interner;
+    SPFS fs = interner.Intern(FeatureStructure(spec));
+    SPFS other = interner.Intern(FeatureStructure(spec));
+    BOOST_CHECK(fs == other);
+    for (int i = 0; i < 2; ++i) {
+      SPFS copy = fs->PartialClone(tree);
+      BOOST_CHECK(copy->Get(path2.begin(), path2.end()) !=
+                  fs->Get(path2.begin(), path2.end()));
+      BOOST_CHECK(copy->Get(path3.begin(), path3.end()) ==
+                  fs->Get(path3.begin(), path3.end()));
+      BOOST_CHECK(copy->Get(path4.begin(), path4.end()) ==
+                  fs->Get(path4.begin(), path4.end()));
+    }
+  }
+
+  {
+    FeatureStructureSpec spec;
+    spec.content_pairs += std::make_pair(path2, x),
+                          std::make_pair(path3, y);
+    spec.equiv_pairs += std::make_pair(path1, path4);
+    SPFS fs(new FeatureStructure(spec));
+    SPFS copy = fs->PartialClone(tree);
+
+    BOOST_CHECK(copy->Get(path3.begin(), path3.end()) !=
+                fs->Get(path3.begin(), path3.end()));
+    BOOST_CHECK(copy->Get(path4.begin(), path4.end()) !=
+                fs->Get(path4.begin(), path4.end()));
+    BOOST_CHECK(copy->Get(path1.begin(), path1.end()) ==
+                copy->Get(path4.begin(), path4.end()));
+  }
+}
+
+// Tests that UnifyOrRollback restores both feature structures (including
+// their reentrancies) when unification fails part way through, and that
+// a trail can undo a successful unification.
+BOOST_AUTO_TEST_CASE(TestUnifyOrRollback) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  const Feature A = feature_set.Insert("A");
+  const Feature B = feature_set.Insert("B");
+  const Feature C = feature_set.Insert("C");
+  const Feature D = feature_set.Insert("D");
+  const Feature E = feature_set.Insert("E");
+
+  const AtomicValue x = value_set.Insert("x");
+  const AtomicValue y = value_set.Insert("y");
+  const AtomicValue z = value_set.Insert("z");
+  const AtomicValue w = value_set.Insert("w");
+
+  FeaturePath path_a, path_b, path_bc, path_be, path_d, path_dc;
+  path_a += A;
+  path_b += B;
+  path_bc += B, C;
+  path_be += B, E;
+  path_d += D;
+  path_dc += D, C;
+
+  // fs1 = [A:x, B:#1[C:y], D:#1]
+  FeatureStructureSpec spec1;
+  spec1.content_pairs += std::make_pair(path_a, x),
+                         std::make_pair(path_bc, y);
+  spec1.equiv_pairs += std::make_pair(path_b, path_d);
+
+  // fs2 = [B:[C:y, E:z], D:[C:w]]
+  FeatureStructureSpec spec2;
+  spec2.content_pairs += std::make_pair(path_bc, y),
+                         std::make_pair(path_be, z),
+                         std::make_pair(path_dc, w);
+
+  BadFeatureStructureEqualityPred equal;
+
+  // The features A and B are unified before the clash at D.
+  {
+    SPFS fs1(new FeatureStructure(spec1));
+    SPFS fs2(new FeatureStructure(spec2));
+    SPFS orig1 = fs1->Clone();
+    SPFS orig2 = fs2->Clone();
+
+    BOOST_CHECK(!FeatureStructure::UnifyOrRollback(fs1, fs2));
+
+    BOOST_CHECK(equal(*fs1, *orig1));
+    BOOST_CHECK(equal(*fs2, *orig2));
+    BOOST_CHECK(fs1->Get(path_b.begin(), path_b.end()) ==
+                fs1->Get(path_d.begin(), path_d.end()));
+    BOOST_CHECK(!fs1->Get(path_be.begin(), path_be.end()));
+    BOOST_CHECK(!fs2->Get(path_a.begin(), path_a.end()));
+    BOOST_CHECK(fs2->Get(path_b.begin(), path_b.end()) !=
+                fs2->Get(path_d.begin(), path_d.end()));
+  }
+
+  // Successful unification, then rollback to a checkpoint.
+  {
+    spec2.content_pairs.erase(std::make_pair(path_dc, w));
+    SPFS fs1(new FeatureStructure(spec1));
+    SPFS fs2(new FeatureStructure(spec2));
+    SPFS fs3(new FeatureStructure(spec1));
+    SPFS fs4(new FeatureStructure(spec2));
+    SPFS orig1 = fs1->Clone();
+    SPFS orig2 = fs2->Clone();
+
+    UnificationTrail trail;
+    std::size_t checkpoint = trail.Checkpoint();
+    BOOST_CHECK(FeatureStructure::Unify(fs1, fs2, trail));
+    BOOST_CHECK(!trail.IsEmpty());
+    BOOST_CHECK(FeatureStructure::Unify(fs3, fs4));
+    BOOST_CHECK(equal(*fs1, *fs3));
+    BOOST_CHECK(equal(*fs2, *fs4));
+
+    trail.Rollback(checkpoint);
+    BOOST_CHECK(trail.IsEmpty());
+    BOOST_CHECK(equal(*fs1, *orig1));
+    BOOST_CHECK(equal(*fs2, *orig2));
+
+    // The feature structures can be unified again after the rollback.
+    BOOST_CHECK(FeatureStructure::UnifyOrRollback(fs1, fs2));
+    BOOST_CHECK(equal(*fs1, *fs3));
+    BOOST_CHECK(fs1->Get(path_be.begin(), path_be.end()) ==
+                fs1->Get(path_d.begin(), path_d.end())->Get(E));
+  }
+}
+
+// Tests that QuasiDestructiveUnifier agrees with destructive unification
+// without modifying its inputs, and that distinct instances of a feature
+// structure are treated as distinct copies.
+BOOST_AUTO_TEST_CASE(TestQuasiDestructiveUnifier) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+  typedef QuasiDestructiveUnifier::Node Node;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  const Feature A = feature_set.Insert("A");
+  const Feature B = feature_set.Insert("B");
+  const Feature C = feature_set.Insert("C");
+  const Feature D = feature_set.Insert("D");
+  const Feature E = feature_set.Insert("E");
+
+  const AtomicValue x = value_set.Insert("x");
+  const AtomicValue y = value_set.Insert("y");
+  const AtomicValue z = value_set.Insert("z");
+  const AtomicValue w = value_set.Insert("w");
+
+  FeaturePath path_a, path_b, path_bc, path_be, path_d, path_dc;
+  path_a += A;
+  path_b += B;
+  path_bc += B, C;
+  path_be += B, E;
+  path_d += D;
+  path_dc += D, C;
+
+  // fs1 = [A:x, B:#1[C:y], D:#1]
+  FeatureStructureSpec spec1;
+  spec1.content_pairs += std::make_pair(path_a, x),
+                         std::make_pair(path_bc, y);
+  spec1.equiv_pairs += std::make_pair(path_b, path_d);
+
+  // fs2 = [B:[C:y, E:z], D:[C:w]]
+  FeatureStructureSpec spec2;
+  spec2.content_pairs += std::make_pair(path_bc, y),
+                         std::make_pair(path_be, z),
+                         std::make_pair(path_dc, w);
+
+  BadFeatureStructureEqualityPred equal;
+  QuasiDestructiveUnifier unifier;
+
+  // Failure: the clash at D is found after A and B have been unified.
+  {
+    SPFS fs1(new FeatureStructure(spec1));
+    SPFS fs2(new FeatureStructure(spec2));
+    SPFS orig1 = fs1->Clone();
+    SPFS orig2 = fs2->Clone();
+    BOOST_CHECK(!unifier.IsUnifiable(*fs1, *fs2));
+    BOOST_CHECK(!unifier.IsUnifiable(*fs2, *fs1));
+    BOOST_CHECK(!unifier.UnifyAndCopy(*fs1, *fs2));
+    BOOST_CHECK(equal(*fs1, *orig1));
+    BOOST_CHECK(equal(*fs2, *orig2));
+    BOOST_CHECK(!FeatureStructure::Unify(orig1, orig2));
+  }
+
+  // Success: the copied result matches the result of destructive unification.
+  {
+    spec2.content_pairs.erase(std::make_pair(path_dc, w));
+    SPFS fs1(new FeatureStructure(spec1));
+    SPFS fs2(new FeatureStructure(spec2));
+    SPFS orig1 = fs1->Clone();
+    SPFS orig2 = fs2->Clone();
+    BOOST_CHECK(unifier.IsUnifiable(*fs2, *fs1));
+    SPFS result = unifier.UnifyAndCopy(*fs1, *fs2);
+    BOOST_CHECK(result);
+    BOOST_CHECK(equal(*fs1, *orig1));
+    BOOST_CHECK(equal(*fs2, *orig2));
+    BOOST_CHECK(FeatureStructure::Unify(orig1, orig2));
+    BOOST_CHECK(equal(*result, *orig2));
+    BOOST_CHECK(result->Get(path_b.begin(), path_b.end()) ==
+                result->Get(path_d.begin(), path_d.end()));
+    BOOST_CHECK(result->Get(path_a.begin(), path_a.end()) !=
+                fs1->Get(path_a.begin(), path_a.end()));
+  }
+
+  // Instances: the value of A in fs5 = [A:[]] is unified with [C:x] in one
+  // instance and with [C:y] in another.
+  {
+    FeatureStructureSpec spec3;
+    spec3.content_pairs += std::make_pair(path_dc, x);
+    SPFS fs3 = SPFS(new FeatureStructure(spec3))->Get(D);
+    FeatureStructureSpec spec4;
+    spec4.content_pairs += std::make_pair(path_dc, y);
+    SPFS fs4 = SPFS(new FeatureStructure(spec4))->Get(D);
+    SPFS fs5(new FeatureStructure(FeatureStructureSpec()));
+    fs5->CreateEmptyValue(path_a.begin(), path_a.end());
+
+    unifier.Reset();
+    Node a0 = unifier.Get(Node(*fs5, 0), path_a.begin(), path_a.end());
+    Node a1 = unifier.Get(Node(*fs5, 1), path_a.begin(), path_a.end());
+    BOOST_CHECK(a0.fs && a1.fs);
+    BOOST_CHECK(unifier.Unify(a0, Node(*fs3)));
+    BOOST_CHECK(unifier.Unify(a1, Node(*fs4)));
+    BOOST_CHECK(!unifier.Unify(Node(*fs5, 0), Node(*fs5, 1)));
+
+    unifier.Reset();
+    BOOST_CHECK(unifier.Unify(a0, Node(*fs3)));
+    BOOST_CHECK(!unifier.Unify(a0, Node(*fs4)));
+    BOOST_CHECK(fs5->Get(A)->IsEmpty());
+  }
+
+  // Values that the two operands physically share are not reentrant:
+  // x = [A:[B:x];C:[D:y]] and y = [A:[D:z];C:[B:x]] share [B:x] once
+  // interned.
+  {
+    FeaturePath path_ab, path_ad, path_cb, path_cd;
+    path_ab += A, B;
+    path_ad += A, D;
+    path_cb += C, B;
+    path_cd += C, D;
+    FeatureStructureSpec spec_x;
+    spec_x.content_pairs += std::make_pair(path_ab, x),
+                            std::make_pair(path_cd, y);
+    FeatureStructureSpec spec_y;
+    spec_y.content_pairs += std::make_pair(path_ad, z),
+                            std::make_pair(path_cb, x);
+    FeatureStructureInterner interner;
+    SPFS fs_x = interner.Intern(FeatureStructure(spec_x));
+    SPFS fs_y = interner.Intern(FeatureStructure(spec_y));
+    BOOST_REQUIRE(fs_x->Get(A) == fs_y->Get(C));
+
+    BOOST_CHECK(unifier.IsUnifiable(*fs_x, *fs_y));
+    BOOST_CHECK(unifier.IsUnifiable(*fs_y, *fs_x));
+    SPFS result = unifier.UnifyAndCopy(*fs_x, *fs_y);
+    BOOST_REQUIRE(result);
+    SPFS clone_x = fs_x->Clone();
+    SPFS clone_y = fs_y->Clone();
+    BOOST_CHECK(FeatureStructure::Unify(clone_x, clone_y));
+    BOOST_CHECK(equal(*result, *clone_y));
+    BOOST_CHECK(result->Get(A) != result->Get(C));
+  }
+}
+
+// Tests that ProjectionEncoder ignores values outside of the tree but
+// distinguishes reentrancy.
+BOOST_AUTO_TEST_CASE(TestProjectionEncoder) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  const Feature A = feature_set.Insert("A");
+  const Feature B = feature_set.Insert("B");
+  const Feature C = feature_set.Insert("C");
+  const Feature D = feature_set.Insert("D");
+
+  const AtomicValue x = value_set.Insert("x");
+  const AtomicValue y = value_set.Insert("y");
+
+  // [A:[C:x];B:[C:x];D:x] and [A:[C:x];B:[C:x];D:y]
+  SPFS fs1, fs2;
+  {
+    FeatureStructureSpec spec;
+    FeaturePath path1, path2, path3;
+    path1 += A, C;
+    path2 += B, C;
+    path3 += D;
+    spec.content_pairs += std::make_pair(path1, x);
+    spec.content_pairs += std::make_pair(path2, x);
+    spec.content_pairs += std::make_pair(path3, x);
+    fs1.reset(new FeatureStructure(spec));
+    spec.content_pairs.clear();
+    spec.content_pairs += std::make_pair(path1, x);
+    spec.content_pairs += std::make_pair(path2, x);
+    spec.content_pairs += std::make_pair(path3, y);
+    fs2.reset(new FeatureStructure(spec));
+  }
+
+  // [A:#1[C:x];B:#1;D:x]
+  SPFS fs3 = fs1->Clone();
+  {
+    SPFS a = fs3->Get(A);
+    SPFS b = fs3->Get(B);
+    BOOST_REQUIRE(FeatureStructure::Unify(a, b));
+  }
+
+  FeatureTree whole;
+  FeatureTree tree;
+  tree.children_[A].reset(new FeatureTree());
+  tree.children_[B].reset(new FeatureTree());
+
+  ProjectionEncoder encoder1, encoder2, encoder3;
+  encoder1.Add(*fs1, whole);
+  encoder2.Add(*fs2, whole);
+  BOOST_CHECK(encoder1.encoding() != encoder2.encoding());
+
+  encoder1.Reset();
+  encoder2.Reset();
+  encoder1.Add(*fs1, tree);
+  encoder2.Add(*fs2, tree);
+  encoder3.Add(*fs3, tree);
+  BOOST_CHECK(encoder1.encoding() == encoder2.encoding());
+  BOOST_CHECK(encoder1.encoding() != encoder3.encoding());
+
+  // Reentrancy between feature structures is also distinguished.
+  encoder1.Reset();
+  encoder3.Reset();
+  encoder1.Add(*fs1->Get(A), whole);
+  encoder1.Add(*fs1->Get(B), whole);
+  encoder3.Add(*fs3->Get(A), whole);
+  encoder3.Add(*fs3->Get(B), whole);
+  BOOST_CHECK(encoder1.encoding() != encoder3.encoding());
+}
+
+// Tests that FeatureStructureHasher and FeatureStructureEqualityPred
+// distinguish feature structures that differ only in structure sharing.
+BOOST_AUTO_TEST_CASE(TestFeatureStructureEqualityPred) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  const Feature A = feature_set.Insert("A");
+  const Feature B = feature_set.Insert("B");
+  const Feature C = feature_set.Insert("C");
+
+  const AtomicValue x = value_set.Insert("x");
+
+  // [A:#1[C:x];B:#1]
+  FeatureStructureSpec spec1;
+  {
+    FeaturePath path1, path2, path3;
+    path1 += A, C;
+    path2 += A;
+    path3 += B;
+    spec1.content_pairs += std::make_pair(path1, x);
+    spec1.equiv_pairs += std::make_pair(path2, path3);
+  }
+
+  // [A:[C:x];B:[C:x]]
+  FeatureStructureSpec spec2;
+  {
+    FeaturePath path1, path2;
+    path1 += A, C;
+    path2 += B, C;
+    spec2.content_pairs += std::make_pair(path1, x);
+    spec2.content_pairs += std::make_pair(path2, x);
+  }
+
+  SPFS fs1(new FeatureStructure(spec1));
+  SPFS fs2(new FeatureStructure(spec2));
+  SPFS clone1 = fs1->Clone();
+  SPFS clone2 = fs2->Clone();
+
+  BadFeatureStructureEqualityPred bad_equal;
+  FeatureStructureEqualityPred equal;
+  FeatureStructureHasher hasher;
+  CachingFeatureStructureHasher caching_hasher;
+
+  BOOST_CHECK(bad_equal(*fs1, *fs2));
+  BOOST_CHECK(!equal(*fs1, *fs2));
+  BOOST_CHECK(!equal(*fs2, *fs1));
+  BOOST_CHECK(hasher(*fs1) != hasher(*fs2));
+
+  BOOST_CHECK(equal(*fs1, *clone1));
+  BOOST_CHECK(equal(*fs2, *clone2));
+  BOOST_CHECK(hasher(*fs1) == hasher(*clone1));
+  BOOST_CHECK(hasher(*fs2) == hasher(*clone2));
+
+  BOOST_CHECK(caching_hasher(*fs1) == hasher(*fs1));
+  BOOST_CHECK(caching_hasher(*fs1) == hasher(*fs1));
+  BOOST_CHECK(caching_hasher(*fs2) == hasher(*fs2));
+
+  // Values that have been unified are also shared.
+  SPFS a = clone2->Get(A);
+  SPFS b = clone2->Get(B);
+  BOOST_REQUIRE(FeatureStructure::Unify(a, b));
+  BOOST_CHECK(equal(*fs1, *clone2));
+  BOOST_CHECK(hasher(*fs1) == hasher(*clone2));
+}
+
+// Tests the non-owning Find(), including lookups through reentrant values.
+BOOST_AUTO_TEST_CASE(TestFeatureStructureFind) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  const Feature A = feature_set.Insert("A");
+  const Feature B = feature_set.Insert("B");
+  const Feature C = feature_set.Insert("C");
+
+  const AtomicValue x = value_set.Insert("x");
+
+  // [A:#1[C:x];B:#1]
+  SPFS fs;
+  {
+    FeatureStructureSpec spec;
+    FeaturePath path1, path2, path3;
+    path1 += A, C;
+    path2 += A;
+    path3 += B;
+    spec.content_pairs += std::make_pair(path1, x);
+    spec.equiv_pairs += std::make_pair(path2, path3);
+    fs.reset(new FeatureStructure(spec));
+  }
+
+  FeaturePath ac, bc, bcc, c;
+  ac += A, C;
+  bc += B, C;
+  bcc += B, C, C;
+  c += C;
+
+  const FeatureStructure *value = fs->Find(ac.begin(), ac.end());
+  BOOST_REQUIRE(value);
+  BOOST_CHECK(value == fs->Find(bc.begin(), bc.end()));
+  BOOST_CHECK(value == fs->Get(ac.begin(), ac.end()).get());
+  BOOST_CHECK(value->IsAtomic() && value->GetAtomicValue() == x);
+  BOOST_CHECK(fs->Find(c.begin(), c.end()) == 0);
+  BOOST_CHECK_THROW(fs->Find(c.begin(), c.begin()), Exception);
+  BOOST_CHECK_THROW(fs->Find(bcc.begin(), bcc.end()), Exception);
+}
@@ -0,0 +1,150 @@
+#include <boost/test/unit_test.hpp>
+
+#include "taco/feature_structure_interner.h"
+
+#include "taco/feature_structure.h"
+#include "taco/lexicon.h"
+#include "taco/text-formats/feature_structure_parser.h"
+#include "taco/base/vocabulary.h"
+
+#include <boost/assign/std/set.hpp>
+#include <boost/assign/std/vector.hpp>
+
+#include <sstream>
+#include <utility>
+#include <vector>
+
+// Tests that equal values are shared between interned feature structures but
+// not within them.
+BOOST_AUTO_TEST_CASE(TestFeatureStructureInterner) {
+  using namespace taco;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser parser(feature_set, value_set);
+
+  const Feature A = feature_set.Insert("A");
+  const Feature B = feature_set.Insert("B");
+  const Feature X = feature_set.Insert("X");
+  const Feature AGR = feature_set.Insert("AGR");
+
+  FeatureStructureInterner interner;
+  BadFeatureStructureEqualityPred equal;
+
+  SPFS fs1 = parser.Parse("[AGR:[NUM:sg;CASE:nom];LEMMA:a]");
+  SPFS fs2 = parser.Parse("[AGR:[NUM:sg;CASE:nom];LEMMA:b]");
+  SPFS fs3 = parser.Parse("[AGR:[NUM:sg;CASE:nom];LEMMA:a]");
+
+  SPFS i1 = interner.Intern(*fs1);
+  SPFS i2 = interner.Intern(*fs2);
+  SPFS i3 = interner.Intern(*fs3);
+
+  BOOST_CHECK(equal(*i1, *fs1));
+  BOOST_CHECK(equal(*i2, *fs2));
+  BOOST_CHECK(i1->Get(AGR) == i2->Get(AGR));
+  BOOST_CHECK(i1 != i2);
+  BOOST_CHECK(i1 == i3);
+
+  // Equal values within one feature structure must not become reentrant.
+  SPFS fs4 = parser.Parse("[A:[X:x];B:[X:x]]");
+  SPFS i4 = interner.Intern(*fs4);
+  BOOST_CHECK(equal(*i4, *fs4));
+  BOOST_CHECK(i4->Get(A) != i4->Get(B));
+  BOOST_CHECK(i4->Get(A)->Get(X) != i4->Get(B)->Get(X));
+}
+
+// Tests that reentrancy is preserved and distinguishes canonical values.
+BOOST_AUTO_TEST_CASE(TestFeatureStructureInternerReentrancy) {
+  using namespace taco;
+  using namespace boost::assign;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser parser(feature_set, value_set);
+
+  const Feature A = feature_set.Insert("A");
+  const Feature B = feature_set.Insert("B");
+  const Feature C = feature_set.Insert("C");
+  const Feature X = feature_set.Insert("X");
+
+  const AtomicValue x = value_set.Insert("x");
+
+  // [C:[A:#1[X:x];B:#1]]
+  FeatureStructureSpec spec;
+  {
+    FeaturePath path1, path2, path3;
+    path1 += C, A, X;
+    path2 += C, A;
+    path3 += C, B;
+    spec.content_pairs += std::make_pair(path1, x);
+    spec.equiv_pairs += std::make_pair(path2, path3);
+  }
+  SPFS fs1(new FeatureStructure(spec));
+  SPFS fs2 = parser.Parse("[C:[A:[X:x];B:[X:x]]]");
+
+  FeatureStructureInterner interner;
+  SPFS i1 = interner.Intern(*fs1);
+  SPFS i2 = interner.Intern(*fs2);
+
+  BOOST_CHECK(i1->Get(C)->Get(A) == i1->Get(C)->Get(B));
+  BOOST_CHECK(i2->Get(C)->Get(A) != i2->Get(C)->Get(B));
+  BOOST_CHECK(i1 != i2);
+  BOOST_CHECK(i1->Get(C) != i2->Get(C));
+
+  // Interning again yields the same canonical nodes.
+  BOOST_CHECK(interner.Intern(*fs1) == i1);
+  BOOST_CHECK(interner.Intern(*fs2) == i2);
+}
+
+// Tests that BasicLexiconLoader shares values within a load and, given a
+// caller-owned interner, between loads.
+BOOST_AUTO_TEST_CASE(TestLexiconLoaderInterning) {
+  using namespace taco;
+
+  typedef Lexicon<std::size_t>::MappedType MappedType;
+
+  Vocabulary words;
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser parser(feature_set, value_set);
+  BasicLexiconLoader loader(parser, words);
+  const Feature agr = feature_set.Insert("AGR");
+  const Feature num = feature_set.Insert("NUM");
+  const char *text = "Haus ||| [POS:NN;AGR:[NUM:sg]]\n"
+                     "Hauses ||| [POS:NN;AGR:[NUM:sg;CASE:gen]]\n";
+
+  Lexicon<std::size_t> lexicon1, lexicon2, lexicon3;
+  {
+    std::istringstream input(text);
+    loader.Load(input, lexicon1);
+  }
+  {
+    std::istringstream input(text);
+    loader.Load(input, lexicon2);
+  }
+  const MappedType *a1 = lexicon1.Lookup(words.Lookup("Haus"));
+  const MappedType *b1 = lexicon1.Lookup(words.Lookup("Hauses"));
+  const MappedType *a2 = lexicon2.Lookup(words.Lookup("Haus"));
+  BOOST_REQUIRE(a1 && b1 && a2);
+  BOOST_CHECK((*a1)[0]->Get(agr)->Get(num) == (*b1)[0]->Get(agr)->Get(num));
+  BOOST_CHECK((*a1)[0] != (*a2)[0]);
+
+  FeatureStructureInterner interner;
+  {
+    std::istringstream input(text);
+    loader.Load(input, lexicon3, &interner);
+  }
+  BOOST_CHECK(interner.Size() > 0);
+  {
+    std::istringstream input(text);
+    loader.Load(input, lexicon2, &interner);
+  }
+  const MappedType *a3 = lexicon3.Lookup(words.Lookup("Haus"));
+  const MappedType *a4 = lexicon2.Lookup(words.Lookup("Haus"));
+  BOOST_REQUIRE(a3 && a4);
+  BOOST_CHECK((*a3)[0] == a4->back());
+}
@@ -2,9 +2,11 @@
 
 #include "taco/interpretation.h"
 
+#include "taco/compiled_constraint_set.h"
 #include "taco/constraint.h"
 #include "taco/constraint_set.h"
 #include "taco/feature_structure.h"
+#include "taco/text-formats/constraint_set_parser.h"
 #include "taco/text-formats/feature_structure_parser.h"
 #include "taco/base/vocabulary.h"
 
@@ -201,3 +203,148 @@ BOOST_AUTO_TEST_CASE(TestInterpretation_EvalAbsConstraint) {
     BOOST_CHECK(v2 == v1);
   }
 }
+
+// Tests that QuickCheck() considers the relational constraints on the new
+// feature structure together rather than individually.
+BOOST_AUTO_TEST_CASE(TestPotentialInterpretation_QuickCheck) {
+  using namespace taco;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser fs_parser(feature_set, value_set);
+  ConstraintSetParser cs_parser(feature_set, value_set);
+
+  boost::shared_ptr<FeatureStructure> fs4, fs5, fs6;
+  fs4 = fs_parser.Parse("[AGR:[NUM:sg]]");
+  fs5 = fs_parser.Parse("[AGR:[NUM:pl]]");
+  fs6 = fs_parser.Parse("[AGR:[CASE:nom]]");
+
+  Interpretation interpretation1(4, fs4);
+  PotentialInterpretation tmp(interpretation1, 5, fs5);
+  Interpretation interpretation2(tmp);
+
+  boost::shared_ptr<ConstraintSet> cs;
+  cs = cs_parser.Parse("<4\"AGR\">=<6\"AGR\"> <5\"AGR\">=<6\"AGR\">");
+  {
+    PotentialInterpretation candidate(interpretation2, 6, fs6);
+    BOOST_CHECK(!candidate.QuickCheck(*cs));
+  }
+  cs = cs_parser.Parse(std::string("<4\"AGR\">=<6\"AGR\"> ") +
+                       std::string("<5\"AGR\"\"CASE\">=<6\"AGR\"\"CASE\">"));
+  {
+    PotentialInterpretation candidate(interpretation2, 6, fs6);
+    BOOST_CHECK(candidate.QuickCheck(*cs));
+  }
+
+  // The new feature structure is treated as a copy even if it is physically
+  // shared with a value in the previous interpretation.
+  boost::shared_ptr<FeatureStructure> fs7;
+  fs7 = fs_parser.Parse("[P:[];Q:[C:sg];R:[C:pl]]");
+  cs = cs_parser.Parse("<4\"P\">=<6\"Q\"> <6\"P\">=<4\"R\">");
+  {
+    Interpretation interpretation3(4, fs7);
+    PotentialInterpretation candidate(interpretation3, 6, fs7);
+    BOOST_CHECK(candidate.QuickCheck(*cs));
+    Interpretation interpretation4(candidate);
+    BOOST_CHECK(interpretation4.Eval(*cs));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestInterpretation_EvalCompiledConstraintSet) {
+  using namespace taco;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser fs_parser(feature_set, value_set);
+  ConstraintSetParser cs_parser(feature_set, value_set);
+
+  const char *fs_strings[][2] = {
+    {"[AGR:[NUM:sg]]", "[AGR:[]]"},
+    {"[AGR:[]]", "[AGR:[CASE:acc]]"},
+    {"[AGR:[NUM:pl]]", "[AGR:[NUM:sg]]"},
+    {"[AGR:[NUM:sg;PERS:3]]", "[]"},
+  };
+
+  // Shares the prefix <1 AGR> and tests paths that only exist once the
+  // relative constraint has been evaluated.
+  boost::shared_ptr<ConstraintSet> cs = cs_parser.Parse(
+      std::string("<0\"AGR\">=<1\"AGR\"> <1\"AGR\"\"CASE\">=\"nom\" ") +
+      std::string("<1\"AGR\"\"NUM\">={\"sg\":0.5,\"pl\":0.25} ") +
+      std::string("<1\"AGR\"\"PERS\">={\"3\":0.5}"));
+  CompiledConstraintSet compiled(*cs);
+  BOOST_CHECK(compiled.NumInstructions() == 4);
+  BOOST_CHECK(compiled.NumPathNodes() == 7);
+
+  const bool expected[] = {true, false, false, true};
+  const float expected_probability[] = {0.25f, 0.0f, 0.0f, 0.25f};
+
+  for (int i = 0; i < 4; ++i) {
+    Interpretation base0(0, fs_parser.Parse(fs_strings[i][0]));
+    PotentialInterpretation tmp0(base0, 1, fs_parser.Parse(fs_strings[i][1]));
+    Interpretation interpretation0(tmp0);
+
+    Interpretation base1(0, fs_parser.Parse(fs_strings[i][0]));
+    PotentialInterpretation tmp1(base1, 1, fs_parser.Parse(fs_strings[i][1]));
+    Interpretation interpretation1(tmp1);
+
+    BOOST_CHECK(interpretation0.Eval(*cs) == expected[i]);
+    BOOST_CHECK(interpretation1.Eval(compiled) == expected[i]);
+    if (expected[i]) {
+      BOOST_CHECK_CLOSE(interpretation0.probability(),
+                        expected_probability[i], 0.001);
+      BOOST_CHECK_CLOSE(interpretation1.probability(),
+                        expected_probability[i], 0.001);
+      // The value created at <1 AGR CASE> is shared with element 0.
+      FeaturePath path;
+      path.push_back(feature_set.Lookup("AGR"));
+      path.push_back(feature_set.Lookup("CASE"));
+      boost::shared_ptr<const FeatureStructure> val =
+          interpretation1.GetFS(0)->Get(path.begin(), path.end());
+      BOOST_REQUIRE(val);
+      BOOST_CHECK(val->GetAtomicValue() == value_set.Lookup("nom"));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestInterpretationSignature) {
+  using namespace taco;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser parser(feature_set, value_set);
+
+  const Feature AGR = feature_set.Insert("AGR");
+
+  // Select <AGR>.
+  FeatureTree tree;
+  tree.children_[AGR].reset(new FeatureTree());
+
+  Interpretation i1(0, parser.Parse("[AGR:[NUM:sg;PER:3];LEMMA:x]"));
+  Interpretation i2(0, parser.Parse("[AGR:[NUM:sg;PER:3];LEMMA:y]"));
+  Interpretation i3(0, parser.Parse("[AGR:[NUM:pl;PER:3];LEMMA:x]"));
+  Interpretation i4(1, parser.Parse("[AGR:[NUM:sg;PER:3];LEMMA:x]"));
+  Interpretation i5(0, parser.Parse("[]"));
+
+  InterpretationSignature s1(i1, tree);
+  InterpretationSignature s2(i2, tree);
+  InterpretationSignature s3(i3, tree);
+  InterpretationSignature s4(i4, tree);
+  InterpretationSignature s5(i5, tree);
+
+  BOOST_CHECK(s1 == s2);
+  BOOST_CHECK_EQUAL(s1.hash(), s2.hash());
+  BOOST_CHECK(s1 != s3);
+  BOOST_CHECK(s1.hash() != s3.hash());
+  BOOST_CHECK(s4 != s5);
+  BOOST_CHECK(s4 == InterpretationSignature());
+  BOOST_CHECK(s1.bytes().size() < 16);
+
+  // The whole feature structure.
+  BOOST_CHECK(InterpretationSignature(i1, FeatureTree()) !=
+              InterpretationSignature(i2, FeatureTree()));
+
+  // Signatures can be recreated from their bytes.
+  InterpretationSignature copy(s3.bytes());
+  BOOST_CHECK(copy == s3);
+  BOOST_CHECK_EQUAL(copy.hash(), s3.hash());
+}
@@ -0,0 +1,67 @@
+#include <boost/test/unit_test.hpp>
+
+#include "taco/base/line_reader.h"
+
+#include "taco/base/string_piece.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> ReadLines(const std::string &text,
+                                   std::size_t block_size) {
+  std::istringstream input(text);
+  taco::LineReader reader(input, block_size);
+  std::vector<std::string> lines;
+  taco::StringPiece line;
+  while (reader.Next(line)) {
+    lines.push_back(line.as_string());
+  }
+  return lines;
+}
+
+std::vector<std::string> GetLines(const std::string &text) {
+  std::istringstream input(text);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(input, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+}  // namespace
+
+// Tests that LineReader splits lines as std::getline does, including lines
+// that straddle or are longer than the block size.
+BOOST_AUTO_TEST_CASE(TestLineReader) {
+  std::vector<std::string> texts;
+  texts.push_back("");
+  texts.push_back("\n");
+  texts.push_back("a");
+  texts.push_back("a\n");
+  texts.push_back("a\n\nbc\r\n");
+  texts.push_back("der ||| 1\ndes ||| 2\nHaus ||| 3");
+  texts.push_back(std::string(100, 'x') + "\n" + std::string(37, 'y') +
+                  "\n\n" + std::string(5, 'z'));
+
+  const std::size_t block_sizes[] = {
+      1, 2, 3, 7, 64, taco::LineReader::kDefaultBlockSize};
+  for (std::size_t i = 0; i < texts.size(); ++i) {
+    for (std::size_t j = 0; j < sizeof(block_sizes) / sizeof(block_sizes[0]);
+         ++j) {
+      BOOST_CHECK(ReadLines(texts[i], block_sizes[j]) == GetLines(texts[i]));
+    }
+  }
+
+  // Once the input is exhausted, Next() keeps returning false.
+  std::istringstream input("a\n");
+  taco::LineReader reader(input);
+  taco::StringPiece line;
+  BOOST_CHECK(reader.Next(line));
+  BOOST_CHECK(line == "a");
+  BOOST_CHECK(!reader.Next(line));
+  BOOST_CHECK(!reader.Next(line));
+}
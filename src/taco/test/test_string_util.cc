@@ -0,0 +1,66 @@
+#include <boost/test/unit_test.hpp>
+
+#include "taco/base/string_util.h"
+
+#include "taco/base/string_piece.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Returns a random string over a small alphabet that makes separators,
+// near-separators and runs of whitespace likely.
+std::string RandomString(std::size_t length) {
+  const char alphabet[] = "||| \tab";
+  std::string s;
+  for (std::size_t i = 0; i < length; ++i) {
+    s += alphabet[std::rand() % (sizeof(alphabet) - 1)];
+  }
+  return s;
+}
+
+}  // namespace
+
+// Tests that the vectorized separator search and splitting agree with the
+// straightforward versions for strings that straddle the 16-byte blocks.
+BOOST_AUTO_TEST_CASE(TestFieldSplitting) {
+  using namespace taco;
+
+  std::srand(1);
+  for (int i = 0; i < 2000; ++i) {
+    const std::string s = RandomString(i % 70);
+    const StringPiece str(s);
+
+    for (std::size_t pos = 0; pos <= s.size(); ++pos) {
+      BOOST_CHECK_EQUAL(FindFieldSeparator(str, pos), s.find("|||", pos));
+    }
+
+    std::vector<StringPiece> fields;
+    SplitFields(fields, str);
+    std::vector<StringPiece> expected;
+    std::size_t begin = 0;
+    for (std::size_t pos = s.find("|||"); pos != std::string::npos;
+         pos = s.find("|||", begin)) {
+      expected.push_back(str.substr(begin, pos - begin));
+      Trim(expected.back());
+      begin = pos + 3;
+    }
+    expected.push_back(str.substr(begin));
+    Trim(expected.back());
+    BOOST_CHECK(fields == expected);
+
+    // The default delimiters take the fast path; the same delimiters in a
+    // different order do not.
+    std::vector<StringPiece> tokens;
+    Tokenize(tokens, str);
+    expected.clear();
+    Tokenize(expected, str, "\t ");
+    BOOST_CHECK(tokens == expected);
+  }
+
+  BOOST_CHECK_EQUAL(FindFieldSeparator("a ||"), std::string::npos);
+  BOOST_CHECK_EQUAL(FindFieldSeparator("a ||||", 3), 3);
+  BOOST_CHECK_EQUAL(FindFieldSeparator("a ||| b", 10), std::string::npos);
+}
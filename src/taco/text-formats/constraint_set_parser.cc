@@ -2,11 +2,228 @@
 
 #include <cassert>
 #include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
 
 #include "taco/base/exception.h"
 
 namespace taco {
+namespace {
+
+inline bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Implements ConstraintSetParser::ParseDirect().  The tokens are those of
+// ConstraintTokeniser except that a token's value is a StringPiece into the
+// input.  Every function returns false if the parser gives up, which it does
+// at the first irregularity (including strings that contain escaped
+// characters, since their values would need to be copied).
+class DirectConstraintSetParser {
+ public:
+  DirectConstraintSetParser(const StringPiece &s, VocabularyCache &features,
+                            VocabularyCache &values)
+      : p_(s.data())
+      , end_(s.data() + s.size())
+      , features_(features)
+      , values_(values) {}
+
+  bool Parse(ConstraintSet &cs) {
+    if (!Next()) {
+      return false;
+    }
+    do {
+      if (!ParseConstraint(cs)) {
+        return false;
+      }
+    } while (type_ == internal::ConstraintToken_STRING ||
+             type_ == internal::ConstraintToken_LANGLE ||
+             type_ == internal::ConstraintToken_LCURLY);
+    return type_ == internal::ConstraintToken_EOS;
+  }
+
+ private:
+  // Scans the next token into type_ and value_.
+  bool Next() {
+    while (p_ != end_ && (*p_ == ' ' || *p_ == '\t')) {
+      ++p_;
+    }
+    if (p_ == end_) {
+      type_ = internal::ConstraintToken_EOS;
+      return true;
+    }
+    const char *start = p_;
+    switch (*p_++) {
+      case ':': type_ = internal::ConstraintToken_COLON; return true;
+      case ',': type_ = internal::ConstraintToken_COMMA; return true;
+      case '=': type_ = internal::ConstraintToken_EQUALS; return true;
+      case '<': type_ = internal::ConstraintToken_LANGLE; return true;
+      case '>': type_ = internal::ConstraintToken_RANGLE; return true;
+      case '{': type_ = internal::ConstraintToken_LCURLY; return true;
+      case '}': type_ = internal::ConstraintToken_RCURLY; return true;
+      case '"': {
+        const char *close = static_cast<const char *>(
+            std::memchr(p_, '"', end_ - p_));
+        if (!close || std::memchr(p_, '\\', close - p_)) {
+          return false;
+        }
+        type_ = internal::ConstraintToken_STRING;
+        value_.set(p_, close - p_);
+        p_ = close + 1;
+        return true;
+      }
+      default:
+        break;
+    }
+    if (!IsDigit(*start)) {
+      return false;
+    }
+    type_ = internal::ConstraintToken_DIGITSEQ;
+    while (p_ != end_ && IsDigit(*p_)) {
+      ++p_;
+    }
+    if (p_ != end_ && *p_ == '.') {
+      type_ = internal::ConstraintToken_PROBABILITY;
+      do {
+        ++p_;
+      } while (p_ != end_ && IsDigit(*p_));
+    }
+    value_.set(start, p_ - start);
+    return true;
+  }
+
+  bool Match(internal::ConstraintTokenType expected_type) {
+    return type_ == expected_type && Next();
+  }
+
+  bool ParseConstraint(ConstraintSet &cs) {
+    if (type_ == internal::ConstraintToken_LANGLE) {
+      int lhs_index;
+      FeaturePath lhs_path;
+      if (!ParsePathTerm(lhs_index, lhs_path) ||
+          !Match(internal::ConstraintToken_EQUALS)) {
+        return false;
+      }
+      PathTerm lhs(lhs_index, lhs_path);
+      if (type_ == internal::ConstraintToken_STRING) {
+        AtomicValue value = values_.Insert(value_);
+        if (!Next()) {
+          return false;
+        }
+        cs.Insert(boost::shared_ptr<Constraint>(
+            new AbsConstraint(lhs, ValueTerm(value))), kAbsConstraint);
+      } else if (type_ == internal::ConstraintToken_LANGLE) {
+        int rhs_index;
+        FeaturePath rhs_path;
+        if (!ParsePathTerm(rhs_index, rhs_path)) {
+          return false;
+        }
+        cs.Insert(boost::shared_ptr<Constraint>(new RelConstraint(
+            lhs, PathTerm(rhs_index, rhs_path))), kRelConstraint);
+      } else {
+        VarTerm::ProbabilityMap prob_map;
+        if (!ParseVarTerm(prob_map)) {
+          return false;
+        }
+        cs.Insert(boost::shared_ptr<Constraint>(
+            new VarConstraint(lhs, VarTerm(prob_map))), kVarConstraint);
+      }
+      return true;
+    }
+    int rhs_index;
+    FeaturePath rhs_path;
+    if (type_ == internal::ConstraintToken_STRING) {
+      AtomicValue value = values_.Insert(value_);
+      if (!Next() || !Match(internal::ConstraintToken_EQUALS) ||
+          !ParsePathTerm(rhs_index, rhs_path)) {
+        return false;
+      }
+      cs.Insert(boost::shared_ptr<Constraint>(new AbsConstraint(
+          PathTerm(rhs_index, rhs_path), ValueTerm(value))), kAbsConstraint);
+      return true;
+    }
+    VarTerm::ProbabilityMap prob_map;
+    if (!ParseVarTerm(prob_map) || !Match(internal::ConstraintToken_EQUALS) ||
+        !ParsePathTerm(rhs_index, rhs_path)) {
+      return false;
+    }
+    cs.Insert(boost::shared_ptr<Constraint>(new VarConstraint(
+        PathTerm(rhs_index, rhs_path), VarTerm(prob_map))), kVarConstraint);
+    return true;
+  }
+
+  bool ParsePathTerm(int &index, FeaturePath &path) {
+    // Indices of more than nine digits are left to std::atoi().
+    if (!Match(internal::ConstraintToken_LANGLE) ||
+        type_ != internal::ConstraintToken_DIGITSEQ || value_.size() > 9) {
+      return false;
+    }
+    index = 0;
+    for (std::size_t i = 0; i < value_.size(); ++i) {
+      index = index * 10 + (value_[i] - '0');
+    }
+    if (!Next()) {
+      return false;
+    }
+    while (type_ == internal::ConstraintToken_STRING) {
+      path.push_back(features_.Insert(value_));
+      if (!Next()) {
+        return false;
+      }
+    }
+    return Match(internal::ConstraintToken_RANGLE);
+  }
+
+  bool ParseVarTerm(VarTerm::ProbabilityMap &prob_map) {
+    if (!Match(internal::ConstraintToken_LCURLY)) {
+      return false;
+    }
+    if (type_ == internal::ConstraintToken_STRING) {
+      while (true) {
+        AtomicValue value = values_.Insert(value_);
+        float prob;
+        if (!Next() || !Match(internal::ConstraintToken_COLON) ||
+            !ParseProbability(prob)) {
+          return false;
+        }
+        prob_map[value] = prob;
+        if (type_ != internal::ConstraintToken_COMMA) {
+          break;
+        }
+        if (!Next() || type_ != internal::ConstraintToken_STRING) {
+          return false;
+        }
+      }
+    }
+    return Match(internal::ConstraintToken_RCURLY);
+  }
+
+  // Converts a PROBABILITY token as boost::lexical_cast<float> does (by way
+  // of std::strtof), but without constructing a std::string.
+  bool ParseProbability(float &prob) {
+    char buffer[32];
+    if (type_ != internal::ConstraintToken_PROBABILITY ||
+        value_.size() >= sizeof(buffer) ||
+        value_[value_.size()-1] == '.') {
+      return false;
+    }
+    std::memcpy(buffer, value_.data(), value_.size());
+    buffer[value_.size()] = '\0';
+    prob = std::strtof(buffer, 0);
+    return Next();
+  }
+
+  const char *p_;
+  const char *end_;
+  VocabularyCache &features_;
+  VocabularyCache &values_;
+  internal::ConstraintTokenType type_;
+  StringPiece value_;
+};
+
+}  // namespace
+
 namespace internal {
 
 ConstraintSetParserBase::ConstraintSetParserBase() {}
@@ -35,16 +252,32 @@ boost::shared_ptr<ConstraintSet> ConstraintSetParserBase::NTConstraintSet() {
 
 ConstraintSetParser::ConstraintSetParser(Vocabulary &feature_set,
                                          Vocabulary &value_set)
-    : ConstraintSetParserBase(feature_set, value_set) {
+    : ConstraintSetParserBase(feature_set, value_set)
+    , features_(feature_set)
+    , values_(value_set) {
 }
 
 boost::shared_ptr<ConstraintSet> ConstraintSetParser::Parse(
     const StringPiece &s) {
+  boost::shared_ptr<ConstraintSet> cs = ParseDirect(s);
+  if (cs) {
+    return cs;
+  }
   tokeniser_ = internal::ConstraintTokeniser(s);
   lookahead_ = *tokeniser_;
-  boost::shared_ptr<ConstraintSet> cs = NTConstraintSet();
+  cs = NTConstraintSet();
   Match(internal::ConstraintToken_EOS);
   return cs;
 }
 
+boost::shared_ptr<ConstraintSet> ConstraintSetParser::ParseDirect(
+    const StringPiece &s) {
+  boost::shared_ptr<ConstraintSet> cs(new ConstraintSet());
+  DirectConstraintSetParser parser(s, features_, values_);
+  if (!parser.Parse(*cs)) {
+    cs.reset();
+  }
+  return cs;
+}
+
 } // namespace taco
@@ -4,6 +4,7 @@
 #include <string>
 
 #include "taco/base/vocabulary.h"
+#include "taco/base/vocabulary_cache.h"
 #include "taco/constraint.h"
 #include "taco/constraint_set.h"
 #include "taco/text-formats/constraint_parser.h"
@@ -22,6 +23,10 @@ namespace taco {
 // Where a constraint.has the same form as for ConstraintParser.  Whitespace is
 // optional and ignored.
 //
+// ConstraintSetParser::Parse() first tries a single pass over the characters
+// that takes tokens as StringPieces into the input, and only falls back to
+// the predictive parser (which copies each token) if that fails.
+//
 ////////////////////////////////////////////////////////////////////////////////
 namespace internal {
 // The internal ConstraintSetParserBase class implements ConstraintSetParser
@@ -39,6 +44,15 @@ class ConstraintSetParser : public internal::ConstraintSetParserBase {
  public:
   ConstraintSetParser(Vocabulary &, Vocabulary &);
   boost::shared_ptr<ConstraintSet> Parse(const StringPiece &s);
+
+ private:
+  // Parses s in a single pass.  Returns an empty pointer if s is not
+  // well-formed or contains an escaped character, leaving the predictive
+  // parser to produce the result or the error.
+  boost::shared_ptr<ConstraintSet> ParseDirect(const StringPiece &s);
+
+  VocabularyCache features_;
+  VocabularyCache values_;
 };
 
 }  // namespace taco
@@ -8,21 +8,20 @@
 
 namespace taco {
 
-ConstraintTableParser::ConstraintTableParser()
-    : input_(0) {
+ConstraintTableParser::ConstraintTableParser() {
 }
 
 ConstraintTableParser::ConstraintTableParser(std::istream &input)
-    : input_(&input) {
+    : reader_(new LineReader(input)) {
   ++(*this);
 }
 
 ConstraintTableParser &ConstraintTableParser::operator++() {
-  if (!input_) {
+  if (!reader_) {
     return *this;
   }
-  if (!std::getline(*input_, value_.line)) {
-    input_ = 0;
+  if (!reader_->Next(value_.line)) {
+    reader_.reset();
     return *this;
   }
   ParseLine(value_.line);
@@ -37,7 +36,7 @@ ConstraintTableParser ConstraintTableParser::operator++(int) {
 
 void ConstraintTableParser::ParseLine(const StringPiece &line) {
   // ID.
-  size_t pos = line.find("|||");
+  size_t pos = FindFieldSeparator(line);
   if (pos == std::string::npos) {
     throw Exception("missing first delimiter");
   }
@@ -51,7 +50,7 @@ void ConstraintTableParser::ParseLine(const StringPiece &line) {
 
 bool operator==(const ConstraintTableParser &lhs,
                 const ConstraintTableParser &rhs) {
-  return lhs.input_ == rhs.input_;
+  return lhs.reader_ == rhs.reader_;
 }
 
 bool operator!=(const ConstraintTableParser &lhs,
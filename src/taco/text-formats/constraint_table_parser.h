@@ -1,9 +1,12 @@
 #ifndef TACO_SRC_TACO_TEXT_FORMATS_CONSTRAINT_TABLE_PARSER_H_
 #define TACO_SRC_TACO_TEXT_FORMATS_CONSTRAINT_TABLE_PARSER_H_
 
+#include <boost/shared_ptr.hpp>
+
 #include <istream>
 #include <string>
 
+#include "taco/base/line_reader.h"
 #include "taco/base/string_piece.h"
 
 namespace taco {
@@ -11,7 +14,7 @@ namespace taco {
 class ConstraintTableParser {
  public:
   struct Entry {
-    std::string line;
+    StringPiece line;
     StringPiece id;
     StringPiece constraint_set;
   };
@@ -32,7 +35,7 @@ class ConstraintTableParser {
 
  private:
   Entry value_;
-  std::istream *input_;
+  boost::shared_ptr<LineReader> reader_;
 
   void ParseLine(const StringPiece &);
 };
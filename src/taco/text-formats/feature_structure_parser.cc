@@ -1,8 +1,54 @@
 #include "taco/text-formats/feature_structure_parser.h"
 
 #include <cctype>
+#include <utility>
 
 namespace taco {
+namespace {
+
+// Character classes for ParseDirect(), which must agree with FSTokeniser.
+enum FSCharClass { kWordChar, kSeparatorChar, kPunctuationChar };
+
+class FSCharTable {
+ public:
+  FSCharTable() {
+    for (int i = 0; i < 256; ++i) {
+      classes_[i] = kWordChar;
+    }
+    classes_[static_cast<unsigned char>(' ')] = kSeparatorChar;
+    classes_[static_cast<unsigned char>('\t')] = kSeparatorChar;
+    classes_[static_cast<unsigned char>(';')] = kSeparatorChar;
+    classes_[static_cast<unsigned char>('[')] = kPunctuationChar;
+    classes_[static_cast<unsigned char>(']')] = kPunctuationChar;
+    classes_[static_cast<unsigned char>(':')] = kPunctuationChar;
+  }
+
+  FSCharClass operator[](char c) const {
+    return classes_[static_cast<unsigned char>(c)];
+  }
+
+ private:
+  FSCharClass classes_[256];
+};
+
+const FSCharTable kFSCharTable;
+
+inline void SkipSeparators(const char *&p, const char *end) {
+  while (p != end && kFSCharTable[*p] == kSeparatorChar) {
+    ++p;
+  }
+}
+
+inline StringPiece ScanWord(const char *&p, const char *end) {
+  const char *start = p;
+  while (p != end && kFSCharTable[*p] == kWordChar) {
+    ++p;
+  }
+  return StringPiece(start, p - start);
+}
+
+}  // namespace
+
 namespace internal {
 
 FeatureStructureParserBase::FeatureStructureParserBase()
@@ -75,11 +121,17 @@ void FeatureStructureParserBase::NTPairList(FeatureStructureSpec &spec) {
 
 FeatureStructureParser::FeatureStructureParser(Vocabulary &feature_set,
                                                Vocabulary &value_set)
-    : FeatureStructureParserBase(feature_set, value_set) {
+    : FeatureStructureParserBase(feature_set, value_set)
+    , features_(feature_set)
+    , values_(value_set) {
 }
 
 boost::shared_ptr<FeatureStructure> FeatureStructureParser::Parse(
     const StringPiece &s) {
+  boost::shared_ptr<FeatureStructure> fs = ParseDirect(s);
+  if (fs) {
+    return fs;
+  }
   tokeniser_ = internal::FSTokeniser(s);
   lookahead_ = *tokeniser_;
   FeatureStructureSpec spec;
@@ -95,4 +147,56 @@ void FeatureStructureParser::Parse(const StringPiece &s,
   NTFS(spec);
 }
 
+boost::shared_ptr<FeatureStructure> FeatureStructureParser::ParseDirect(
+    const StringPiece &s) {
+  const char *p = s.data();
+  boost::shared_ptr<FeatureStructure> fs = FeatureStructure::NewNode();
+  if (!ParseDirectFS(p, p + s.size(), *fs)) {
+    fs.reset();
+  }
+  return fs;
+}
+
+bool FeatureStructureParser::ParseDirectFS(const char *&p, const char *end,
+                                           FeatureStructure &node) {
+  SkipSeparators(p, end);
+  if (p == end) {
+    return false;
+  }
+  if (kFSCharTable[*p] == kWordChar) {
+    node.content_.a = values_.Insert(ScanWord(p, end));
+    return true;
+  }
+  if (*p != '[') {
+    return false;
+  }
+  ++p;
+  while (true) {
+    SkipSeparators(p, end);
+    if (p == end) {
+      return false;
+    }
+    if (*p == ']') {
+      ++p;
+      return true;
+    }
+    if (kFSCharTable[*p] != kWordChar) {
+      return false;
+    }
+    Feature feature = features_.Insert(ScanWord(p, end));
+    SkipSeparators(p, end);
+    if (p == end || *p != ':') {
+      return false;
+    }
+    ++p;
+    boost::shared_ptr<FeatureStructure> value = FeatureStructure::NewNode();
+    if (!ParseDirectFS(p, end, *value)) {
+      return false;
+    }
+    if (!node.content_.c.insert(std::make_pair(feature, value)).second) {
+      return false;
+    }
+  }
+}
+
 }  // namespace taco
@@ -5,6 +5,7 @@
 
 #include "taco/base/string_piece.h"
 #include "taco/base/vocabulary.h"
+#include "taco/base/vocabulary_cache.h"
 #include "taco/feature_structure.h"
 #include "taco/text-formats/feature_structure_tokeniser.h"
 
@@ -32,6 +33,9 @@ namespace taco {
 //       Feature -> Word
 //
 // Implemented as a predictive parser with one token of lookahead.
+// FeatureStructureParser::Parse() first tries a single pass over the
+// characters that builds the FeatureStructure directly, and only falls back
+// to the predictive parser (and a FeatureStructureSpec) if that fails.
 //
 ////////////////////////////////////////////////////////////////////////////////
 namespace internal {
@@ -62,6 +66,20 @@ class FeatureStructureParser : public internal::FeatureStructureParserBase {
 
   boost::shared_ptr<FeatureStructure> Parse(const StringPiece &);
   void Parse(const StringPiece &, FeatureStructureSpec &);
+
+ private:
+  // Parses s in a single pass, without a tokeniser or FeatureStructureSpec.
+  // Returns an empty pointer if s is not well-formed or if a complex value
+  // repeats a feature, leaving the predictive parser to produce the result
+  // or the error.
+  boost::shared_ptr<FeatureStructure> ParseDirect(const StringPiece &s);
+
+  // Parses the FS starting at p into node, advancing p past it.  Returns
+  // false if ParseDirect() should give up.
+  bool ParseDirectFS(const char *&p, const char *end, FeatureStructure &node);
+
+  VocabularyCache features_;
+  VocabularyCache values_;
 };
 
 }  // namespace taco
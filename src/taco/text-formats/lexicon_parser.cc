@@ -8,22 +8,21 @@
 
 namespace taco {
 
-LexiconParser::LexiconParser()
-    : input_(0) {
+LexiconParser::LexiconParser() {
 }
 
 LexiconParser::LexiconParser(std::istream &input)
-    : input_(&input) {
+    : reader_(new LineReader(input)) {
   ++(*this);
 }
 
 LexiconParser &LexiconParser::operator++() {
-  if (!input_) {
+  if (!reader_) {
     return *this;
   }
   while (true) {
-    if (!std::getline(*input_, value_.line)) {
-      input_ = 0;
+    if (!reader_->Next(value_.line)) {
+      reader_.reset();
       return *this;
     }
     if (!IsBlankLine(value_.line)) {
@@ -40,14 +39,14 @@ LexiconParser LexiconParser::operator++(int) {
   return tmp;
 }
 
-bool LexiconParser::IsBlankLine(const std::string &line) {
+bool LexiconParser::IsBlankLine(const StringPiece &line) {
   std::size_t pos = line.find_first_not_of(" \t");
   return (pos == std::string::npos || line[pos] == '#');
 }
 
 void LexiconParser::ParseLine(const StringPiece &line) {
   // Word.
-  std::size_t pos = line.find("|||");
+  std::size_t pos = FindFieldSeparator(line);
   if (pos == std::string::npos) {
     throw Exception("missing delimiter");
   }
@@ -63,7 +62,7 @@ void LexiconParser::ParseLine(const StringPiece &line) {
 }
 
 bool operator==(const LexiconParser &lhs, const LexiconParser &rhs) {
-  return lhs.input_ == rhs.input_;
+  return lhs.reader_ == rhs.reader_;
 }
 
 bool operator!=(const LexiconParser &lhs, const LexiconParser &rhs) {
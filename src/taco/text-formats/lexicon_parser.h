@@ -1,9 +1,12 @@
 #ifndef TACO_SRC_TACO_TEXT_FORMATS_LEXICON_PARSER_H_
 #define TACO_SRC_TACO_TEXT_FORMATS_LEXICON_PARSER_H_
 
+#include <boost/shared_ptr.hpp>
+
 #include <istream>
 #include <string>
 
+#include "taco/base/line_reader.h"
 #include "taco/base/string_piece.h"
 
 namespace taco {
@@ -19,7 +22,7 @@ namespace taco {
 class LexiconParser {
  public:
   struct Entry {
-    std::string line;
+    StringPiece line;
     std::string word;
     std::string fs;
   };
@@ -37,11 +40,11 @@ class LexiconParser {
   friend bool operator!=(const LexiconParser &, const LexiconParser &);
 
  private:
-  bool IsBlankLine(const std::string &);
+  bool IsBlankLine(const StringPiece &);
   void ParseLine(const StringPiece &);
 
   Entry value_;
-  std::istream *input_;
+  boost::shared_ptr<LineReader> reader_;
 };
 
 }  // namespace taco
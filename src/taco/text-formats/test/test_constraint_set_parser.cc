@@ -2,6 +2,10 @@
 
 #include "taco/text-formats/constraint_set_parser.h"
 
+#include "taco/base/exception.h"
+#include "taco/text-formats/constraint_parser.h"
+
+#include <cstddef>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -67,3 +71,46 @@ BOOST_AUTO_TEST_CASE(TestConstraintSetParser) {
     BOOST_CHECK(cs->rel_set().Find(constraint) != cs->rel_set().End());
   }
 }
+
+// Tests that ConstraintSetParser agrees with ConstraintParser (which uses the
+// predictive parser) constraint by constraint, including for input that the
+// single-pass parser leaves to the predictive parser.
+BOOST_AUTO_TEST_CASE(TestConstraintSetParserAgreement) {
+  using namespace taco;
+
+  std::vector<std::string> constraints;
+  constraints.push_back("<0\"AGR\"> = <1\"AGR\">");
+  constraints.push_back("\"NN\" = <2\"POS\">");
+  constraints.push_back("<12\"AGR\"\"CASE\"> = \"nom\"");
+  constraints.push_back("<0\"NUM\"> = {\"sg\":0.25,\"pl\":0.75}");
+  constraints.push_back("{\"m\":0.5, \"f\":0.125,\"n\":0.375} = <1\"GEN\">");
+  constraints.push_back("<0\"Q\"> = {}");
+  constraints.push_back("<1\"POS\"> = \"\\\"quoted\\\"\"");
+  constraints.push_back("<1\"PROB\"> = {\"x\":1.}");
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  ConstraintParser constraint_parser(feature_set, value_set);
+  ConstraintSetParser set_parser(feature_set, value_set);
+
+  ConstraintSet expected;
+  std::string s;
+  for (std::size_t i = 0; i < constraints.size(); ++i) {
+    ConstraintType type;
+    boost::shared_ptr<Constraint> constraint =
+        constraint_parser.Parse(constraints[i], type);
+    expected.Insert(constraint, type);
+    s += constraints[i] + "\t";
+
+    boost::shared_ptr<ConstraintSet> cs = set_parser.Parse(constraints[i]);
+    BOOST_REQUIRE(cs);
+    BOOST_CHECK_EQUAL(cs->Size(), 1);
+  }
+
+  boost::shared_ptr<ConstraintSet> cs = set_parser.Parse(s);
+  BOOST_REQUIRE(cs);
+  BOOST_CHECK(*cs == expected);
+
+  BOOST_CHECK_THROW(set_parser.Parse("<0\"A\"> = <1\"A\"> >"), Exception);
+  BOOST_CHECK_THROW(set_parser.Parse("<0\"A\"> = {\"x\":1}"), Exception);
+}
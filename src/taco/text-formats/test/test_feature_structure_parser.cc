@@ -2,12 +2,16 @@
 
 #include "taco/text-formats/feature_structure_parser.h"
 
+#include "taco/base/exception.h"
 #include "taco/feature_structure.h"
+#include "taco/feature_structure_spec.h"
 #include "taco/base/vocabulary.h"
 
 #include <boost/assign/std/vector.hpp>
 
+#include <cstddef>
 #include <string>
+#include <vector>
 
 BOOST_AUTO_TEST_CASE(TestFeatureStructureParser) {
   using namespace taco;
@@ -119,3 +123,35 @@ BOOST_AUTO_TEST_CASE(TestFeatureStructureParser) {
     BOOST_CHECK(v7->GetAtomicValue() == w);
   }
 }
+
+// Tests that Parse() builds the same feature structures as the predictive
+// parser, via a FeatureStructureSpec, including for input that the
+// single-pass parser leaves to the predictive parser.
+BOOST_AUTO_TEST_CASE(TestFeatureStructureParserAgreement) {
+  using namespace taco;
+
+  typedef boost::shared_ptr<FeatureStructure> SPFS;
+
+  std::vector<std::string> strings;
+  strings.push_back("x");
+  strings.push_back("[]");
+  strings.push_back(" [ A : x ; B:[C:[]] ]");
+  strings.push_back("[POS:NN;AGR:[CASE:nom;NUM:sg;GEN:n]]\ttrailing");
+  strings.push_back("[A:[B:x];A:[C:y]]");
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  FeatureStructureParser parser(feature_set, value_set);
+  BadFeatureStructureEqualityPred equal;
+  for (std::size_t i = 0; i < strings.size(); ++i) {
+    SPFS fs = parser.Parse(strings[i]);
+    FeatureStructureSpec spec;
+    parser.Parse(strings[i], spec);
+    BOOST_REQUIRE(fs);
+    BOOST_CHECK(equal(*fs, FeatureStructure(spec)));
+  }
+
+  BOOST_CHECK_THROW(parser.Parse(""), Exception);
+  BOOST_CHECK_THROW(parser.Parse("[A:x"), Exception);
+  BOOST_CHECK_THROW(parser.Parse("[A x]"), Exception);
+}
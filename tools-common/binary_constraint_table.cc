@@ -0,0 +1,495 @@
+#include "tools-common/binary_constraint_table.h"
+
+#include "taco/base/exception.h"
+#include "taco/base/utility.h"
+#include "taco/constraint.h"
+#include "taco/constraint_term.h"
+#include "taco/feature_path.h"
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/static_assert.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <utility>
+
+namespace taco {
+namespace tool {
+
+using namespace binary_format;
+
+// The file begins with a header giving the number of elements in and the
+// byte offset of each of the following sections:
+//
+//   features, values          String pools (see AppendStringPool).
+//   buckets, slots            The key index (see PerfectHash).
+//   key offsets, key data     For each key k, the offset of its first
+//                             element in the key data; its elements end at
+//                             the first element of k+1.
+//   key set sets              The ID of each key's constraint set set.
+//   set set offsets, data     Likewise, the IDs of each constraint set set's
+//                             constraint sets.
+//   set offsets, data         Likewise, each constraint set's encoding.
+//
+// A constraint set is encoded as the numbers of absolute, relational and
+// variable constraints followed by the constraints.  A path term is encoded
+// as its index, its length and its features.  An absolute constraint is a
+// path term and a value, a relational constraint is two path terms and a
+// variable constraint is a path term, the number of values and a list of
+// (value, probability) pairs, with each probability stored as the bits of a
+// float.
+struct BinaryConstraintTable::Header {
+  char magic[8];
+  boost::uint32_t version;
+  boost::uint32_t byte_order;
+  boost::uint32_t num_keys;
+  boost::uint32_t num_set_sets;
+  boost::uint32_t num_sets;
+  boost::uint32_t num_key_elements;
+  boost::uint32_t num_set_set_elements;
+  boost::uint32_t num_set_elements;
+  boost::uint32_t num_buckets;
+  boost::uint32_t num_slots;
+  boost::uint64_t features_offset;
+  boost::uint64_t values_offset;
+  boost::uint64_t buckets_offset;
+  boost::uint64_t slots_offset;
+  boost::uint64_t key_offsets_offset;
+  boost::uint64_t key_data_offset;
+  boost::uint64_t key_set_sets_offset;
+  boost::uint64_t set_set_offsets_offset;
+  boost::uint64_t set_set_data_offset;
+  boost::uint64_t set_offsets_offset;
+  boost::uint64_t set_data_offset;
+  boost::uint64_t size;
+};
+
+namespace {
+
+// Keys are hashed and compared as arrays of 32-bit integers.
+BOOST_STATIC_ASSERT(sizeof(unsigned int) == sizeof(boost::uint32_t));
+
+const char kMagic[8] = {'T', 'A', 'C', 'O', 'B', 'C', 'T', '\0'};
+const boost::uint32_t kVersion = 1;
+const boost::uint32_t kByteOrder = 0x01020304;
+
+typedef std::vector<boost::uint32_t> Words;
+
+StringPiece KeyBytes(const boost::uint32_t *key, std::size_t length) {
+  return StringPiece(reinterpret_cast<const char *>(key),
+                     length * sizeof(boost::uint32_t));
+}
+
+void EncodePathTerm(const PathTerm &term, Words &words) {
+  words.push_back(static_cast<boost::uint32_t>(term.index()));
+  words.push_back(term.path().size());
+  words.insert(words.end(), term.path().begin(), term.path().end());
+}
+
+void EncodeConstraintSet(const ConstraintSet &cs, Words &words) {
+  words.push_back(cs.abs_set().Size());
+  words.push_back(cs.rel_set().Size());
+  words.push_back(cs.var_set().Size());
+  for (AbsConstraintSet::ConstIterator p = cs.abs_set().Begin();
+       p != cs.abs_set().End(); ++p) {
+    EncodePathTerm((*p)->lhs, words);
+    words.push_back((*p)->rhs.value());
+  }
+  for (RelConstraintSet::ConstIterator p = cs.rel_set().Begin();
+       p != cs.rel_set().End(); ++p) {
+    EncodePathTerm((*p)->lhs, words);
+    EncodePathTerm((*p)->rhs, words);
+  }
+  for (VarConstraintSet::ConstIterator p = cs.var_set().Begin();
+       p != cs.var_set().End(); ++p) {
+    EncodePathTerm((*p)->lhs, words);
+    const VarTerm::ProbabilityMap &probs = (*p)->rhs.probabilities();
+    words.push_back(probs.size());
+    for (VarTerm::ProbabilityMap::const_iterator q = probs.begin();
+         q != probs.end(); ++q) {
+      boost::uint32_t bits;
+      std::memcpy(&bits, &q->second, sizeof(bits));
+      words.push_back(q->first);
+      words.push_back(bits);
+    }
+  }
+}
+
+// Reads an encoded constraint set, checking that it does not overrun the
+// end of its encoding.
+class ConstraintSetDecoder {
+ public:
+  ConstraintSetDecoder(const boost::uint32_t *begin,
+                       const boost::uint32_t *end)
+      : p_(begin), end_(end) {}
+
+  boost::shared_ptr<ConstraintSet> Decode() {
+    boost::shared_ptr<ConstraintSet> cs(new ConstraintSet());
+    const std::size_t num_abs = Next();
+    const std::size_t num_rel = Next();
+    const std::size_t num_var = Next();
+    cs->abs_set().Reserve(num_abs);
+    cs->rel_set().Reserve(num_rel);
+    cs->var_set().Reserve(num_var);
+    for (std::size_t i = 0; i < num_abs; ++i) {
+      PathTerm lhs = NextPathTerm();
+      ValueTerm rhs(Next());
+      boost::shared_ptr<AbsConstraint> c(new AbsConstraint(lhs, rhs));
+      cs->Insert(c, kAbsConstraint);
+    }
+    for (std::size_t i = 0; i < num_rel; ++i) {
+      PathTerm lhs = NextPathTerm();
+      PathTerm rhs = NextPathTerm();
+      boost::shared_ptr<RelConstraint> c(new RelConstraint(lhs, rhs));
+      cs->Insert(c, kRelConstraint);
+    }
+    for (std::size_t i = 0; i < num_var; ++i) {
+      PathTerm lhs = NextPathTerm();
+      VarTerm::ProbabilityMap probs;
+      const std::size_t n = Next();
+      for (std::size_t j = 0; j < n; ++j) {
+        AtomicValue value = Next();
+        boost::uint32_t bits = Next();
+        float probability;
+        std::memcpy(&probability, &bits, sizeof(probability));
+        probs.insert(probs.end(), std::make_pair(value, probability));
+      }
+      boost::shared_ptr<VarConstraint> c(new VarConstraint(lhs,
+                                                           VarTerm(probs)));
+      cs->Insert(c, kVarConstraint);
+    }
+    if (p_ != end_) {
+      Fail();
+    }
+    return cs;
+  }
+
+ private:
+  boost::uint32_t Next() {
+    if (p_ == end_) {
+      Fail();
+    }
+    return *p_++;
+  }
+
+  PathTerm NextPathTerm() {
+    int index = static_cast<int>(Next());
+    std::size_t length = Next();
+    if (length > static_cast<std::size_t>(end_ - p_)) {
+      Fail();
+    }
+    FeaturePath path(p_, p_ + length);
+    p_ += length;
+    return PathTerm(index, path);
+  }
+
+  static void Fail() {
+    throw Exception("binary constraint table has invalid constraint set");
+  }
+
+  const boost::uint32_t *p_;
+  const boost::uint32_t *end_;
+};
+
+// Assigns IDs to distinct values.
+template<typename T>
+boost::uint32_t Intern(const T &value, std::map<T, boost::uint32_t> &ids,
+                       std::vector<const T *> &values) {
+  typename std::map<T, boost::uint32_t>::iterator p = ids.find(value);
+  if (p != ids.end()) {
+    return p->second;
+  }
+  p = ids.insert(std::make_pair(value, values.size())).first;
+  values.push_back(&p->first);
+  return p->second;
+}
+
+// Appends a list of sequences to offset and data arrays.
+void Flatten(const std::vector<const Words *> &sequences, Words &offsets,
+             Words &data) {
+  for (std::vector<const Words *>::const_iterator p = sequences.begin();
+       p != sequences.end(); ++p) {
+    offsets.push_back(data.size());
+    data.insert(data.end(), (*p)->begin(), (*p)->end());
+    CheckCount(data.size(), "elements");
+  }
+  offsets.push_back(data.size());
+}
+
+const boost::uint32_t *Section(const char *data, boost::uint64_t offset) {
+  return reinterpret_cast<const boost::uint32_t *>(data + offset);
+}
+
+}  // namespace
+
+BinaryConstraintTable::BinaryConstraintTable(const std::string &path) {
+  namespace bi = boost::interprocess;
+  try {
+    bi::file_mapping file(path.c_str(), bi::read_only);
+    region_.reset(new bi::mapped_region(file, bi::read_only));
+  } catch (const bi::interprocess_exception &e) {
+    std::ostringstream msg;
+    msg << "failed to map binary constraint table `" << path << "': "
+        << e.what();
+    throw Exception(msg.str());
+  }
+  Init(static_cast<const char *>(region_->get_address()), region_->get_size());
+}
+
+BinaryConstraintTable::BinaryConstraintTable(const char *data,
+                                             std::size_t size) {
+  Init(data, size);
+}
+
+BinaryConstraintTable::~BinaryConstraintTable() {
+}
+
+void BinaryConstraintTable::Init(const char *data, std::size_t size) {
+  if (size < sizeof(Header)) {
+    throw Exception("binary constraint table is truncated");
+  }
+  const Header &header = *reinterpret_cast<const Header *>(data);
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    throw Exception("not a binary constraint table");
+  }
+  if (header.byte_order != kByteOrder) {
+    throw Exception(
+        "binary constraint table was written with a different byte order");
+  }
+  if (header.version != kVersion) {
+    std::ostringstream msg;
+    msg << "unsupported binary constraint table version: " << header.version;
+    throw Exception(msg.str());
+  }
+  if (header.size != size) {
+    throw Exception("binary constraint table is truncated");
+  }
+
+  num_keys_ = header.num_keys;
+  num_set_sets_ = header.num_set_sets;
+  num_sets_ = header.num_sets;
+
+  const std::size_t n = sizeof(boost::uint32_t);
+  try {
+    features_.Init(data, size, header.features_offset);
+    values_.Init(data, size, header.values_offset);
+    CheckSection(header.buckets_offset, header.num_buckets * n, size,
+                 "bucket");
+    CheckSection(header.slots_offset, header.num_slots * n, size, "slot");
+    CheckSection(header.key_offsets_offset, (num_keys_ + 1) * n, size,
+                 "key offset");
+    CheckSection(header.key_data_offset, header.num_key_elements * n, size,
+                 "key");
+    CheckSection(header.key_set_sets_offset, num_keys_ * n, size,
+                 "key constraint set set");
+    CheckSection(header.set_set_offsets_offset, (num_set_sets_ + 1) * n,
+                 size, "constraint set set offset");
+    CheckSection(header.set_set_data_offset, header.num_set_set_elements * n,
+                 size, "constraint set set");
+    CheckSection(header.set_offsets_offset, (num_sets_ + 1) * n, size,
+                 "constraint set offset");
+    CheckSection(header.set_data_offset, header.num_set_elements * n, size,
+                 "constraint set");
+  } catch (const Exception &e) {
+    throw Exception("binary constraint table has " + e.msg());
+  }
+  if (header.num_buckets == 0 || header.num_slots == 0) {
+    throw Exception("binary constraint table has invalid key index");
+  }
+
+  index_ = PerfectHash(Section(data, header.buckets_offset),
+                       header.num_buckets,
+                       Section(data, header.slots_offset),
+                       header.num_slots);
+  key_offsets_ = Section(data, header.key_offsets_offset);
+  key_data_ = Section(data, header.key_data_offset);
+  key_set_sets_ = Section(data, header.key_set_sets_offset);
+  set_set_offsets_ = Section(data, header.set_set_offsets_offset);
+  set_set_data_ = Section(data, header.set_set_data_offset);
+  set_offsets_ = Section(data, header.set_offsets_offset);
+  set_data_ = Section(data, header.set_data_offset);
+
+  if (key_offsets_[num_keys_] != header.num_key_elements ||
+      set_set_offsets_[num_set_sets_] != header.num_set_set_elements ||
+      set_offsets_[num_sets_] != header.num_set_elements) {
+    throw Exception("binary constraint table is inconsistent");
+  }
+}
+
+void BinaryConstraintTable::ReadVocabularies(Vocabulary &feature_set,
+                                             Vocabulary &value_set) const {
+  features_.ReadVocabulary(feature_set);
+  values_.ReadVocabulary(value_set);
+}
+
+const ConstraintSetSet *BinaryConstraintTable::Lookup(const Key &key) const {
+  const boost::uint32_t *elements =
+      key.empty() ? 0 : reinterpret_cast<const boost::uint32_t *>(&key[0]);
+  boost::uint32_t k = index_.Find(KeyBytes(elements, key.size()));
+  if (k >= num_keys_) {
+    return 0;
+  }
+  const std::size_t begin = key_offsets_[k];
+  const std::size_t end = key_offsets_[k+1];
+  if (end < begin || end - begin != key.size() ||
+      !std::equal(key_data_ + begin, key_data_ + end, elements)) {
+    return 0;
+  }
+
+  boost::uint32_t id = key_set_sets_[k];
+  SetSetCache::const_iterator p = set_set_cache_.find(id);
+  if (p != set_set_cache_.end()) {
+    return p->second.get();
+  }
+  if (id >= num_set_sets_ ||
+      set_set_offsets_[id+1] < set_set_offsets_[id]) {
+    throw Exception("binary constraint table is inconsistent");
+  }
+  boost::shared_ptr<ConstraintSetSet> css(new ConstraintSetSet());
+  for (std::size_t i = set_set_offsets_[id]; i < set_set_offsets_[id+1];
+       ++i) {
+    css->insert(GetConstraintSet(set_set_data_[i]));
+  }
+  set_set_cache_[id] = css;
+  return css.get();
+}
+
+boost::shared_ptr<ConstraintSet> BinaryConstraintTable::GetConstraintSet(
+    boost::uint32_t id) const {
+  SetCache::const_iterator p = set_cache_.find(id);
+  if (p != set_cache_.end()) {
+    return p->second;
+  }
+  if (id >= num_sets_ || set_offsets_[id+1] < set_offsets_[id]) {
+    throw Exception("binary constraint table is inconsistent");
+  }
+  ConstraintSetDecoder decoder(set_data_ + set_offsets_[id],
+                               set_data_ + set_offsets_[id+1]);
+  boost::shared_ptr<ConstraintSet> cs = decoder.Decode();
+  set_cache_[id] = cs;
+  return cs;
+}
+
+void BinaryConstraintTableWriter::Write(const ConstraintTable &table,
+                                        std::ostream &output) const {
+  // Order the keys, so that the output does not depend on the order of the
+  // table's hash table.
+  std::vector<const ConstraintTable::Key *> keys;
+  keys.reserve(table.size());
+  for (ConstraintTable::const_iterator p = table.begin(); p != table.end();
+       ++p) {
+    keys.push_back(&p->first);
+  }
+  std::sort(keys.begin(), keys.end(),
+            DereferencingOrderer<const ConstraintTable::Key *,
+                                 std::less<ConstraintTable::Key> >());
+  CheckCount(keys.size(), "keys");
+
+  // Intern the constraint sets and constraint set sets.
+  std::map<Words, boost::uint32_t> set_ids;
+  std::vector<const Words *> sets;
+  std::map<Words, boost::uint32_t> set_set_ids;
+  std::vector<const Words *> set_sets;
+  Words key_set_sets;
+  Words key_offsets;
+  Words key_data;
+  Words encoding;
+  Words set_set;
+  for (std::vector<const ConstraintTable::Key *>::const_iterator p =
+       keys.begin(); p != keys.end(); ++p) {
+    const ConstraintSetSet &css = *table.Lookup(**p);
+    set_set.clear();
+    for (ConstraintSetSet::const_iterator q = css.begin(); q != css.end();
+         ++q) {
+      encoding.clear();
+      EncodeConstraintSet(**q, encoding);
+      set_set.push_back(Intern(encoding, set_ids, sets));
+    }
+    key_set_sets.push_back(Intern(set_set, set_set_ids, set_sets));
+    key_offsets.push_back(key_data.size());
+    key_data.insert(key_data.end(), (*p)->begin(), (*p)->end());
+    CheckCount(key_data.size(), "key elements");
+  }
+  key_offsets.push_back(key_data.size());
+  CheckCount(sets.size() + 1, "constraint sets");
+  CheckCount(set_sets.size() + 1, "constraint set sets");
+
+  Words set_set_offsets;
+  Words set_set_data;
+  Flatten(set_sets, set_set_offsets, set_set_data);
+  Words set_offsets;
+  Words set_data;
+  Flatten(sets, set_offsets, set_data);
+
+  // Build the key index.
+  std::vector<StringPiece> key_bytes;
+  key_bytes.reserve(keys.size());
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    key_bytes.push_back(KeyBytes(&key_data[0] + key_offsets[i],
+                                 key_offsets[i+1] - key_offsets[i]));
+  }
+  Words buckets;
+  Words slots;
+  PerfectHash::Build(key_bytes, buckets, slots);
+
+  // Lay out the sections.
+  std::string body;
+  BinaryConstraintTable::Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byte_order = kByteOrder;
+  header.num_keys = keys.size();
+  header.num_set_sets = set_sets.size();
+  header.num_sets = sets.size();
+  header.num_key_elements = key_data.size();
+  header.num_set_set_elements = set_set_data.size();
+  header.num_set_elements = set_data.size();
+  header.num_buckets = buckets.size();
+  header.num_slots = slots.size();
+  body.resize(Align(sizeof(header)));
+  header.features_offset = body.size();
+  AppendStringPool(feature_set_, body);
+  AlignBuffer(body);
+  header.values_offset = body.size();
+  AppendStringPool(value_set_, body);
+  AlignBuffer(body);
+  header.buckets_offset = body.size();
+  Append(buckets, body);
+  AlignBuffer(body);
+  header.slots_offset = body.size();
+  Append(slots, body);
+  AlignBuffer(body);
+  header.key_offsets_offset = body.size();
+  Append(key_offsets, body);
+  AlignBuffer(body);
+  header.key_data_offset = body.size();
+  Append(key_data, body);
+  AlignBuffer(body);
+  header.key_set_sets_offset = body.size();
+  Append(key_set_sets, body);
+  AlignBuffer(body);
+  header.set_set_offsets_offset = body.size();
+  Append(set_set_offsets, body);
+  AlignBuffer(body);
+  header.set_set_data_offset = body.size();
+  Append(set_set_data, body);
+  AlignBuffer(body);
+  header.set_offsets_offset = body.size();
+  Append(set_offsets, body);
+  AlignBuffer(body);
+  header.set_data_offset = body.size();
+  Append(set_data, body);
+  AlignBuffer(body);
+  header.size = body.size();
+  std::memcpy(&body[0], &header, sizeof(header));
+
+  output.write(body.data(), body.size());
+}
+
+}  // namespace tool
+}  // namespace taco
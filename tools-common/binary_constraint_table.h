@@ -0,0 +1,136 @@
+#ifndef TACO_TOOLS_COMMON_BINARY_CONSTRAINT_TABLE_H_
+#define TACO_TOOLS_COMMON_BINARY_CONSTRAINT_TABLE_H_
+
+#include "tools-common/constraint_table.h"
+
+#include "taco/base/binary_format.h"
+#include "taco/base/vocabulary.h"
+#include "taco/constraint_set.h"
+#include "taco/constraint_set_set.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace boost {
+namespace interprocess {
+class mapped_region;
+}
+}
+
+namespace taco {
+namespace tool {
+
+// A read-only ConstraintTable that is used in place, from a file written by
+// BinaryConstraintTableWriter, instead of being loaded from the text
+// constraint map and constraint table.  The file is memory-mapped, so
+// opening it takes constant time and the pages are shared between processes.
+//
+// The file holds the feature and value vocabularies, a perfect hash index
+// from keys to constraint set sets, and the constraint set sets and
+// constraint sets themselves.  Equal constraint sets and equal constraint set
+// sets are stored once.  Lookup() builds a key's ConstraintSetSet (and its
+// ConstraintSets) on first use and keeps it, sharing constraint sets between
+// constraint set sets as BasicConstraintTableLoader does.  Lookup() is
+// therefore not thread-safe.
+//
+// The feature and value IDs are those of the vocabularies that the file was
+// written with (see ReadVocabularies).
+class BinaryConstraintTable {
+ public:
+  typedef ConstraintTable::Key Key;
+
+  // Maps the named file.  Throws Exception if the file cannot be mapped or
+  // is not a valid binary constraint table.
+  explicit BinaryConstraintTable(const std::string &path);
+
+  // Uses a binary constraint table that has already been loaded or mapped
+  // by the caller.  The memory must be aligned to 8 bytes and must outlive
+  // the table.
+  BinaryConstraintTable(const char *data, std::size_t size);
+
+  ~BinaryConstraintTable();
+
+  std::size_t size() const { return num_keys_; }
+  bool empty() const { return num_keys_ == 0; }
+
+  // Returns the numbers of distinct constraint sets and constraint set sets.
+  std::size_t NumConstraintSets() const { return num_sets_; }
+  std::size_t NumConstraintSetSets() const { return num_set_sets_; }
+
+  // Inserts the file's features and values into the vocabularies, in ID
+  // order, so that IDs in the two agree.  Throws Exception if a vocabulary
+  // already assigns a different ID to one of them.
+  void ReadVocabularies(Vocabulary &feature_set, Vocabulary &value_set) const;
+
+  // As ConstraintTable::Lookup().  The pointer remains valid for the
+  // lifetime of the table.
+  const ConstraintSetSet *Lookup(const Key &) const;
+
+ private:
+  friend class BinaryConstraintTableWriter;
+
+  // The file header (see binary_constraint_table.cc).
+  struct Header;
+
+  typedef boost::unordered_map<boost::uint32_t,
+                               boost::shared_ptr<ConstraintSet> > SetCache;
+  typedef boost::unordered_map<boost::uint32_t,
+                               boost::shared_ptr<ConstraintSetSet> >
+      SetSetCache;
+
+  // Copying is not allowed
+  BinaryConstraintTable(const BinaryConstraintTable &);
+  BinaryConstraintTable &operator=(const BinaryConstraintTable &);
+
+  void Init(const char *, std::size_t);
+
+  // Returns the constraint set with the given ID, building it if necessary.
+  boost::shared_ptr<ConstraintSet> GetConstraintSet(boost::uint32_t) const;
+
+  boost::scoped_ptr<boost::interprocess::mapped_region> region_;
+  std::size_t num_keys_;
+  std::size_t num_set_sets_;
+  std::size_t num_sets_;
+  binary_format::StringPool features_;
+  binary_format::StringPool values_;
+  binary_format::PerfectHash index_;
+  const boost::uint32_t *key_offsets_;
+  const boost::uint32_t *key_data_;
+  const boost::uint32_t *key_set_sets_;
+  const boost::uint32_t *set_set_offsets_;
+  const boost::uint32_t *set_set_data_;
+  const boost::uint32_t *set_offsets_;
+  const boost::uint32_t *set_data_;
+  mutable SetCache set_cache_;
+  mutable SetSetCache set_set_cache_;
+};
+
+// Writes a ConstraintTable in the binary format read by
+// BinaryConstraintTable.
+class BinaryConstraintTableWriter {
+ public:
+  BinaryConstraintTableWriter(const Vocabulary &feature_set,
+                              const Vocabulary &value_set)
+      : feature_set_(feature_set)
+      , value_set_(value_set) {}
+
+  // Writes the table.  Throws Exception if the table is too large for the
+  // format's 32-bit offsets.
+  void Write(const ConstraintTable &, std::ostream &) const;
+
+ private:
+  const Vocabulary &feature_set_;
+  const Vocabulary &value_set_;
+};
+
+}  // namespace tool
+}  // namespace taco
+
+#endif
@@ -13,22 +13,21 @@ namespace taco {
 namespace tool {
 namespace moses {
 
-RuleTableParser::RuleTableParser()
-    : input_(0) {
+RuleTableParser::RuleTableParser() {
 }
 
 RuleTableParser::RuleTableParser(std::istream &input, int fields)
     : fields_(fields)
-    , input_(&input) {
+    , reader_(new LineReader(input)) {
   ++(*this);
 }
 
 RuleTableParser &RuleTableParser::operator++() {
-  if (!input_) {
+  if (!reader_) {
     return *this;
   }
-  if (!std::getline(*input_, value_.line)) {
-    input_ = 0;
+  if (!reader_->Next(value_.line)) {
+    reader_.reset();
     return *this;
   }
   ParseLine(value_.line);
@@ -46,7 +45,7 @@ RuleTableParser RuleTableParser::operator++(int) {
 void RuleTableParser::ParseLine(StringPiece line) {
 
   // Source symbols
-  std::size_t pos = line.find("|||");
+  std::size_t pos = FindFieldSeparator(line);
   if (pos == std::string::npos) {
     throw Exception("missing first delimiter");
   }
@@ -66,7 +65,7 @@ void RuleTableParser::ParseLine(StringPiece line) {
 
   // Target symbols
   std::size_t begin = pos+3;
-  pos = line.find("|||", begin);
+  pos = FindFieldSeparator(line, begin);
   if (pos == std::string::npos) {
     throw Exception("missing second delimiter");
   }
@@ -147,7 +146,7 @@ void RuleTableParser::ParseLine(StringPiece line) {
 std::size_t RuleTableParser::ParseField(StringPiece line, std::size_t begin,
                                         int field_num, bool require_delim,
                                         bool store, StringPiece &dest) {
-  std::size_t pos = line.find("|||", begin);
+  std::size_t pos = FindFieldSeparator(line, begin);
   if (require_delim && pos == std::string::npos) {
     throw Exception("missing " + Ordinal(field_num) + " delimiter");
   }
@@ -166,7 +165,7 @@ std::size_t RuleTableParser::ParseField(StringPiece line, std::size_t begin,
                                         int field_num, bool require_delim,
                                         bool store,
                                         std::vector<StringPiece> &dest) {
-  std::size_t pos = line.find("|||", begin);
+  std::size_t pos = FindFieldSeparator(line, begin);
   if (require_delim && pos == std::string::npos) {
     throw Exception("missing " + Ordinal(field_num) + " delimiter");
   }
@@ -188,7 +187,7 @@ std::size_t RuleTableParser::ParseField(
     bool store,
     void (*Split)(const StringPiece &, std::pair<StringPiece,StringPiece> &),
     std::vector<std::pair<StringPiece, StringPiece> > &dest) {
-  std::size_t pos = line.find("|||", begin);
+  std::size_t pos = FindFieldSeparator(line, begin);
   if (require_delim && pos == std::string::npos) {
     throw Exception("missing " + Ordinal(field_num) + " delimiter");
   }
@@ -287,7 +286,7 @@ void RuleTableParser::SplitConstraintId(
 }
 
 bool operator==(const RuleTableParser &lhs, const RuleTableParser &rhs) {
-  return lhs.input_ == rhs.input_;
+  return lhs.reader_.get() == rhs.reader_.get();
 }
 
 bool operator!=(const RuleTableParser &lhs, const RuleTableParser &rhs) {
@@ -1,8 +1,11 @@
 #ifndef TACO_TOOLS_COMMON_COMPAT_MOSES_RULE_TABLE_PARSER_H_
 #define TACO_TOOLS_COMMON_COMPAT_MOSES_RULE_TABLE_PARSER_H_
 
+#include "taco/base/line_reader.h"
 #include "taco/base/string_piece.h"
 
+#include <boost/scoped_ptr.hpp>
+
 #include <istream>
 #include <string>
 #include <vector>
@@ -43,8 +46,9 @@ class RuleTableParser {
   };
 
   // The parser processes a line at a time, storing the result in an Entry
-  // value.  An Entry contains a full copy of the line plus StringPiece values
-  // for the various fields.
+  // value.  An Entry contains the line plus StringPiece values for the
+  // various fields, all of which point into the parser's read buffer and
+  // remain valid until the parser is next incremented.
   struct Entry {
    public:
     Entry() {}
@@ -60,7 +64,7 @@ class RuleTableParser {
     StringPiece key_value_pairs;  // TODO Split?
     std::vector<std::pair<StringPiece,StringPiece> > constraint_ids;
     StringPiece feature_selection_id;
-    std::string line;
+    StringPiece line;
    private:
     // Copying is not allowed
     Entry(const Entry &);
@@ -110,7 +114,7 @@ class RuleTableParser {
 
   int fields_;
   Entry value_;
-  std::istream *input_;
+  boost::scoped_ptr<LineReader> reader_;
   std::vector<StringPiece> tmp_vec_;
 };
 
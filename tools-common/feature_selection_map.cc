@@ -1,6 +1,7 @@
 #include "tools-common/feature_selection_map.h"
 
 #include "taco/base/exception.h"
+#include "taco/base/string_util.h"
 #include "taco/text-formats/feature_tree_parser.h"
 
 #include <boost/algorithm/string.hpp>
@@ -32,22 +33,21 @@ bool FeatureSelectionMap::lookup(const KeyType &key, int &index) const {
   return false;
 }
 
-FeatureSelectionMapParser::FeatureSelectionMapParser()
-    : m_input(0) {
+FeatureSelectionMapParser::FeatureSelectionMapParser() {
 }
 
 FeatureSelectionMapParser::FeatureSelectionMapParser(std::istream &input)
-    : m_input(&input) {
+    : m_reader(new LineReader(input)) {
   ++(*this);
 }
 
 FeatureSelectionMapParser &FeatureSelectionMapParser::operator++() {
-  if (!m_input) {
+  if (!m_reader) {
     return *this;
   }
-  std::string line;
-  if (!std::getline(*m_input, line)) {
-    m_input = 0;
+  StringPiece line;
+  if (!m_reader->Next(line)) {
+    m_reader.reset();
     return *this;
   }
   parseLine(line);
@@ -60,13 +60,13 @@ FeatureSelectionMapParser FeatureSelectionMapParser::operator++(int) {
   return tmp;
 }
 
-void FeatureSelectionMapParser::parseLine(const std::string &line) {
+void FeatureSelectionMapParser::parseLine(const StringPiece &line) {
   // Label
-  size_t pos = line.find("|||");
+  size_t pos = FindFieldSeparator(line);
   if (pos == std::string::npos) {
     throw Exception("missing delimiter");
   }
-  std::string text = line.substr(0, pos);
+  std::string text = line.substr(0, pos).as_string();
   boost::trim(text);
 
   std::vector<std::string> parts;
@@ -77,7 +77,7 @@ void FeatureSelectionMapParser::parseLine(const std::string &line) {
   m_value.label.second = (parts.size() == 2) ? parts[1] : "";
 
   // Index
-  text = line.substr(pos+3);
+  text = line.substr(pos+3).as_string();
   boost::trim(text);
   // TODO Error handling
   m_value.index = boost::lexical_cast<int>(text);
@@ -86,7 +86,7 @@ void FeatureSelectionMapParser::parseLine(const std::string &line) {
 bool operator==(const FeatureSelectionMapParser &lhs,
                 const FeatureSelectionMapParser &rhs) {
   // TODO Is this right?  Compare values of istreams if non-zero?
-  return lhs.m_input == rhs.m_input;
+  return lhs.m_reader == rhs.m_reader;
 }
 
 bool operator!=(const FeatureSelectionMapParser &lhs,
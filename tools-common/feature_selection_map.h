@@ -2,6 +2,8 @@
 #define TACO_TOOLS_COMMON_FEATURE_SELECTION_MAP_H_
 
 #include "taco/text-formats/feature_tree_parser.h"
+#include "taco/base/line_reader.h"
+#include "taco/base/string_piece.h"
 
 #include <boost/shared_ptr.hpp>
 
@@ -54,9 +56,9 @@ class FeatureSelectionMapParser {
 
 private:
   Entry m_value;
-  std::istream *m_input;
+  boost::shared_ptr<LineReader> m_reader;
 
-  void parseLine(const std::string &);
+  void parseLine(const StringPiece &);
 };
 
 }  // namespace tool
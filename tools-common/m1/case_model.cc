@@ -1,6 +1,7 @@
 #include "tools-common/m1/case_model.h"
 
 #include "taco/base/exception.h"
+#include "taco/base/string_util.h"
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
@@ -69,12 +70,12 @@ void CaseTableWriter::WriteLine(const CaseTable::Key &key,
 }
 
 CaseTableParser &CaseTableParser::operator++() {
-  if (!input_) {
+  if (!reader_) {
     return *this;
   }
-  std::string line;
-  if (!std::getline(*input_, line)) {
-    input_ = 0;
+  StringPiece line;
+  if (!reader_->Next(line)) {
+    reader_.reset();
     return *this;
   }
   ParseLine(line);
@@ -87,22 +88,22 @@ CaseTableParser CaseTableParser::operator++(int) {
   return tmp;
 }
 
-void CaseTableParser::ParseLine(const std::string &line) {
+void CaseTableParser::ParseLine(const StringPiece &line) {
   // Grammatical function
-  size_t pos = line.find("|||");
+  size_t pos = FindFieldSeparator(line);
   if (pos == std::string::npos) {
     throw Exception("missing first delimiter");
   }
-  value_.func = line.substr(0, pos);
+  value_.func = line.substr(0, pos).as_string();
   boost::trim(value_.func);
 
   // Probability distribution
   size_t begin = pos+3;
-  pos = line.find("|||", begin);
+  pos = FindFieldSeparator(line, begin);
   if (pos == std::string::npos) {
     throw Exception("missing second delimiter");
   }
-  std::string prob_string = line.substr(begin, pos-begin);
+  std::string prob_string = line.substr(begin, pos-begin).as_string();
   boost::trim(prob_string);
   std::vector<std::string> pairs;
   boost::split(pairs, prob_string, boost::algorithm::is_space(),
@@ -121,7 +122,7 @@ void CaseTableParser::ParseLine(const std::string &line) {
   }
 
   // Count
-  std::string count_text = line.substr(pos+3);
+  std::string count_text = line.substr(pos+3).as_string();
   boost::trim(count_text);
   value_.count = boost::lexical_cast<float>(count_text);
   // TODO Handle error if can't convert.
@@ -129,7 +130,7 @@ void CaseTableParser::ParseLine(const std::string &line) {
 
 bool operator==(const CaseTableParser &lhs, const CaseTableParser &rhs) {
   // TODO Is this right?  Compare values of istreams if non-zero?
-  return lhs.input_ == rhs.input_;
+  return lhs.reader_ == rhs.reader_;
 }
 
 bool operator!=(const CaseTableParser &lhs, const CaseTableParser &rhs) {
@@ -2,9 +2,12 @@
 #define TACO_TOOLS_COMMON_M1_CASE_MODEL_H_
 
 #include "taco/feature_structure.h"
+#include "taco/base/line_reader.h"
+#include "taco/base/string_piece.h"
 #include "taco/base/vocabulary.h"
 
 #include <boost/container/flat_map.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/unordered_map.hpp>
 
 #include <map>
@@ -60,8 +63,9 @@ class CaseTableParser {
     float count;
   };
 
-  CaseTableParser() : input_(0) {}
-  CaseTableParser(std::istream &input) : input_(&input) { ++(*this); }
+  CaseTableParser() {}
+  CaseTableParser(std::istream &input)
+      : reader_(new LineReader(input)) { ++(*this); }
 
   const Entry &operator*() const { return value_; }
   const Entry *operator->() const { return &value_; }
@@ -73,10 +77,10 @@ class CaseTableParser {
   friend bool operator!=(const CaseTableParser &, const CaseTableParser &);
 
  private:
-  void ParseLine(const std::string &);
+  void ParseLine(const StringPiece &);
 
   Entry value_;
-  std::istream *input_;
+  boost::shared_ptr<LineReader> reader_;
 };
 
 class CaseTableLoader {
@@ -6,6 +6,7 @@
 #include "tools-common/relation/relation.h"
 #include "tools-common/relation/relation_tree_ops.h"
 
+#include "taco/bitset_feature_structure.h"
 #include "taco/constraint.h"
 #include "taco/constraint_evaluator.h"
 #include "taco/constraint_set.h"
@@ -44,7 +45,9 @@ class RelationEvaluator {
       , vocab_(vocab)
       , value_set_(value_set)
       , infl_feature_path_(1, infl_feature)
-      , cat_feature_path_(1, cat_feature) {}
+      , cat_feature_path_(1, cat_feature) {
+    BuildBitsetLayout();
+  }
 
   bool Evaluate(const R &);
 
@@ -66,6 +69,7 @@ class RelationEvaluator {
     std::vector<boost::shared_ptr<FeatureStructure> > fs_vec;
   };
 
+  void BuildBitsetLayout();
   void BuildLeafIndexMap(const R &);
   void BuildConstraintSet(const R &);
   void BuildOptionTable(const R &);
@@ -105,6 +109,28 @@ bool RelationEvaluator<T,R,N>::Evaluate(
   return result;
 }
 
+template<typename T, typename R, int N>
+void RelationEvaluator<T,R,N>::BuildBitsetLayout() {
+  // The constraints all relate INFL values, which have small closed value
+  // sets, so the evaluator can pre-check candidates using encoded values.
+  std::vector<boost::shared_ptr<const FeatureStructure> > values;
+  for (Lexicon<std::size_t>::ConstIterator p = lexicon_.Begin();
+       p != lexicon_.End(); ++p) {
+    const Lexicon<std::size_t>::MappedType &entries = p->second;
+    for (Lexicon<std::size_t>::MappedType::const_iterator q = entries.begin();
+         q != entries.end(); ++q) {
+      boost::shared_ptr<const FeatureStructure> value =
+          (*q)->Get(infl_feature_path_.begin(), infl_feature_path_.end());
+      if (value) {
+        values.push_back(value);
+      }
+    }
+  }
+  boost::shared_ptr<const BitsetLayout> layout(
+      new BitsetLayout(values.begin(), values.end()));
+  evaluator_.SetBitsetLayout(infl_feature_path_, layout);
+}
+
 template<typename T, typename R, int N>
 void RelationEvaluator<T,R,N>::BuildLeafIndexMap(const R &relation) {
   // Assign a distinct index to each leaf in the relation.  These are used as
@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/assign/std/vector.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "taco/base/exception.h"
+#include "taco/base/vocabulary.h"
+#include "taco/constraint_set.h"
+#include "taco/constraint_set_set.h"
+#include "taco/text-formats/constraint_set_parser.h"
+
+#include "tools-common/binary_constraint_table.h"
+#include "tools-common/constraint_table.h"
+
+// Tests that a table written by BinaryConstraintTableWriter can be looked up
+// in place and gives the same constraint sets as the original table.
+BOOST_AUTO_TEST_CASE(TestBinaryConstraintTable) {
+  using namespace taco;
+  using namespace taco::tool;
+  using namespace boost::assign;
+
+  Vocabulary feature_set;
+  Vocabulary value_set;
+  ConstraintSetParser parser(feature_set, value_set);
+
+  boost::shared_ptr<ConstraintSet> cs1 = parser.Parse(
+      "<0\"AGR\">=<1\"AGR\"> <1\"POS\">=\"ART\"");
+  boost::shared_ptr<ConstraintSet> cs2 = parser.Parse(
+      "<0\"AGR\"\"CASE\">={\"nom\":0.25,\"acc\":0.75} <0>=<2>");
+  boost::shared_ptr<ConstraintSet> cs3(new ConstraintSet());
+
+  boost::shared_ptr<ConstraintSetSet> css1(new ConstraintSetSet());
+  css1->insert(cs1);
+  css1->insert(cs2);
+  boost::shared_ptr<ConstraintSetSet> css2(new ConstraintSetSet());
+  css2->insert(cs2);
+  css2->insert(cs3);
+
+  ConstraintTable::Key key1, key2, key3, key4;
+  key1 += 0, 1, 2;
+  key2 += 0, 1, 2, 3, 2;
+  key3 += 4;
+  key4 += 0, 1;
+
+  ConstraintTable table;
+  table.Insert(key1, css1);
+  table.Insert(key2, css2);
+  table.Insert(key3, css1);
+
+  std::ostringstream out;
+  BinaryConstraintTableWriter writer(feature_set, value_set);
+  writer.Write(table, out);
+  const std::string data = out.str();
+
+  BinaryConstraintTable binary(data.data(), data.size());
+  BOOST_CHECK_EQUAL(binary.size(), 3);
+  BOOST_CHECK_EQUAL(binary.NumConstraintSetSets(), 2);
+  BOOST_CHECK_EQUAL(binary.NumConstraintSets(), 3);
+
+  Vocabulary binary_features;
+  Vocabulary binary_values;
+  binary.ReadVocabularies(binary_features, binary_values);
+  BOOST_CHECK_EQUAL(binary_features.Size(), feature_set.Size());
+  BOOST_CHECK_EQUAL(binary_values.Size(), value_set.Size());
+
+  for (ConstraintTable::const_iterator p = table.begin(); p != table.end();
+       ++p) {
+    const ConstraintSetSet *css = binary.Lookup(p->first);
+    BOOST_REQUIRE(css);
+    BOOST_REQUIRE_EQUAL(css->size(), p->second->size());
+    ConstraintSetSet::const_iterator q = css->begin();
+    ConstraintSetSet::const_iterator r = p->second->begin();
+    for (; q != css->end(); ++q, ++r) {
+      BOOST_CHECK(**q == **r);
+    }
+  }
+  BOOST_CHECK(binary.Lookup(key4) == 0);
+  BOOST_CHECK(binary.Lookup(ConstraintTable::Key()) == 0);
+
+  // Constraint set sets are built once and constraint sets are shared.
+  const ConstraintSetSet *css1_binary = binary.Lookup(key1);
+  BOOST_CHECK(binary.Lookup(key3) == css1_binary);
+  const ConstraintSetSet *css2_binary = binary.Lookup(key2);
+  BOOST_CHECK(css2_binary->find(cs2) != css2_binary->end());
+  BOOST_CHECK(*css1_binary->find(cs2) == *css2_binary->find(cs2));
+
+  // Mapping the file.
+  const char *path = "test_binary_constraint_table.tmp";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file.write(data.data(), data.size());
+  }
+  {
+    BinaryConstraintTable mapped(path);
+    const ConstraintSetSet *css = mapped.Lookup(key2);
+    BOOST_REQUIRE(css);
+    BOOST_CHECK_EQUAL(css->size(), 2);
+  }
+  std::remove(path);
+
+  // Invalid input.
+  BOOST_CHECK_THROW(BinaryConstraintTable(data.data(), data.size() - 8),
+                    Exception);
+  std::string bad = data;
+  bad[0] = 'X';
+  BOOST_CHECK_THROW(BinaryConstraintTable(bad.data(), bad.size()), Exception);
+  BOOST_CHECK_THROW(BinaryConstraintTable("no-such-file"), Exception);
+}
@@ -9,28 +9,28 @@
 namespace taco {
 namespace tool {
 
-ConstraintExtractParser::ConstraintExtractParser()
-    : input_(0) {
+ConstraintExtractParser::ConstraintExtractParser() {
 }
 
 ConstraintExtractParser::ConstraintExtractParser(std::istream &input)
-    : input_(&input) {
+    : reader_(new LineReader(input)) {
   ++(*this);
 }
 
 ConstraintExtractParser &ConstraintExtractParser::operator++() {
-  if (!input_) {
+  if (!reader_) {
     return *this;
   }
-  if (!std::getline(*input_, value_.tmp_line)) {
-    input_ = 0;
+  StringPiece line;
+  if (!reader_->Next(line)) {
+    reader_.reset();
     return *this;
   }
   // Optimisation for sorted extract files.
   // TODO Add option to disable this in case file is unsorted?
-  value_.is_identical_to_previous = (value_.tmp_line == value_.line);
+  value_.is_identical_to_previous = (line == value_.line);
   if (!value_.is_identical_to_previous) {
-    value_.line.swap(value_.tmp_line);
+    value_.line.assign(line.data(), line.size());
     ParseLine(value_.line);
   }
   return *this;
@@ -38,7 +38,7 @@ ConstraintExtractParser &ConstraintExtractParser::operator++() {
 
 void ConstraintExtractParser::ParseLine(const StringPiece &line) {
   // LHS.
-  size_t pos = line.find("|||");
+  size_t pos = FindFieldSeparator(line);
   if (pos == std::string::npos) {
     throw Exception("missing first delimiter");
   }
@@ -47,7 +47,7 @@ void ConstraintExtractParser::ParseLine(const StringPiece &line) {
 
   // RHS.
   size_t begin = pos+3;
-  pos = line.find("|||", begin);
+  pos = FindFieldSeparator(line, begin);
   if (pos == std::string::npos) {
     throw Exception("missing second delimiter");
   }
@@ -63,7 +63,7 @@ void ConstraintExtractParser::ParseLine(const StringPiece &line) {
 bool operator==(const ConstraintExtractParser &lhs,
                 const ConstraintExtractParser &rhs) {
   // TODO Is this right?  Compare values of istreams if non-zero?
-  return lhs.input_ == rhs.input_;
+  return lhs.reader_.get() == rhs.reader_.get();
 }
 
 bool operator!=(const ConstraintExtractParser &lhs,
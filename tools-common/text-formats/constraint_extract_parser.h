@@ -1,8 +1,11 @@
 #ifndef TACO_TOOLS_COMMON_TEXT_FORMATS_CONSTRAINT_EXTRACT_PARSER_H_
 #define TACO_TOOLS_COMMON_TEXT_FORMATS_CONSTRAINT_EXTRACT_PARSER_H_
 
+#include "taco/base/line_reader.h"
 #include "taco/base/string_piece.h"
 
+#include <boost/scoped_ptr.hpp>
+
 #include <istream>
 #include <string>
 #include <vector>
@@ -33,7 +36,6 @@ class ConstraintExtractParser {
     std::vector<StringPiece> rhs;
     StringPiece constraint_sets;
     bool is_identical_to_previous;
-    std::string tmp_line;
    private:
     // Copying is not allowed
     Entry(const Entry &);
@@ -59,7 +61,7 @@ class ConstraintExtractParser {
   ConstraintExtractParser &operator=(const ConstraintExtractParser &);
 
   Entry value_;
-  std::istream *input_;
+  boost::scoped_ptr<LineReader> reader_;
 
   void ParseLine(const StringPiece &);
 };
@@ -10,7 +10,7 @@ namespace taco {
 namespace tool {
 
 ConstraintMapParser::ConstraintMapParser(const ConstraintMapParser &other) {
-  input_ = other.input_;
+  reader_ = other.reader_;
   value_.line = other.value_.line;
   if (!value_.line.empty()) {
     ParseLine(value_.line);
@@ -19,7 +19,7 @@ ConstraintMapParser::ConstraintMapParser(const ConstraintMapParser &other) {
 
 ConstraintMapParser &ConstraintMapParser::operator=(
     const ConstraintMapParser &other) {
-  input_ = other.input_;
+  reader_ = other.reader_;
   value_.line = other.value_.line;
   if (!value_.line.empty()) {
     ParseLine(value_.line);
@@ -27,21 +27,20 @@ ConstraintMapParser &ConstraintMapParser::operator=(
   return *this;
 }
 
-ConstraintMapParser::ConstraintMapParser()
-    : input_(0) {
+ConstraintMapParser::ConstraintMapParser() {
 }
 
 ConstraintMapParser::ConstraintMapParser(std::istream &input)
-    : input_(&input) {
+    : reader_(new LineReader(input)) {
   ++(*this);
 }
 
 ConstraintMapParser &ConstraintMapParser::operator++() {
-  if (!input_) {
+  if (!reader_) {
     return *this;
   }
-  if (!std::getline(*input_, value_.line)) {
-    input_ = 0;
+  if (!reader_->Next(value_.line)) {
+    reader_.reset();
     return *this;
   }
   ParseLine(value_.line);
@@ -50,7 +49,7 @@ ConstraintMapParser &ConstraintMapParser::operator++() {
 
 void ConstraintMapParser::ParseLine(const StringPiece &line) {
   // Key
-  size_t pos = line.find("|||");
+  size_t pos = FindFieldSeparator(line);
   if (pos == std::string::npos) {
     throw Exception("missing delimiter");
   }
@@ -64,7 +63,7 @@ void ConstraintMapParser::ParseLine(const StringPiece &line) {
 }
 
 bool operator==(const ConstraintMapParser &lhs, const ConstraintMapParser &rhs) {
-  return lhs.input_ == rhs.input_;
+  return lhs.reader_ == rhs.reader_;
 }
 
 bool operator!=(const ConstraintMapParser &lhs, const ConstraintMapParser &rhs) {
@@ -1,8 +1,11 @@
 #ifndef TACO_TOOLS_COMMON_TEXT_FORMATS_CONSTRAINT_MAP_PARSER_H_
 #define TACO_TOOLS_COMMON_TEXT_FORMATS_CONSTRAINT_MAP_PARSER_H_
 
+#include "taco/base/line_reader.h"
 #include "taco/base/string_piece.h"
 
+#include <boost/shared_ptr.hpp>
+
 #include <istream>
 #include <string>
 #include <vector>
@@ -24,7 +27,7 @@ class ConstraintMapParser {
  public:
   struct Entry {
     Entry() {}
-    std::string line;
+    StringPiece line;
     StringPiece key;
     std::vector<StringPiece> ids;
    private:
@@ -52,7 +55,7 @@ class ConstraintMapParser {
 
  private:
   Entry value_;
-  std::istream *input_;
+  boost::shared_ptr<LineReader> reader_;
   std::vector<StringPiece> tmp_vec_;
 
   void ParseLine(const StringPiece &);
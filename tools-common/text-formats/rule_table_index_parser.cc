@@ -12,7 +12,7 @@ namespace taco {
 namespace tool {
 
 RuleTableIndexParser::RuleTableIndexParser(const RuleTableIndexParser &other) {
-  input_ = other.input_;
+  reader_ = other.reader_;
   value_.line = other.value_.line;
   if (!value_.line.empty()) {
     ParseLine(value_.line);
@@ -21,7 +21,7 @@ RuleTableIndexParser::RuleTableIndexParser(const RuleTableIndexParser &other) {
 
 RuleTableIndexParser &RuleTableIndexParser::operator=(
     const RuleTableIndexParser &other) {
-  input_ = other.input_;
+  reader_ = other.reader_;
   value_.line = other.value_.line;
   if (!value_.line.empty()) {
     ParseLine(value_.line);
@@ -29,21 +29,20 @@ RuleTableIndexParser &RuleTableIndexParser::operator=(
   return *this;
 }
 
-RuleTableIndexParser::RuleTableIndexParser()
-    : input_(0) {
+RuleTableIndexParser::RuleTableIndexParser() {
 }
 
 RuleTableIndexParser::RuleTableIndexParser(std::istream &input)
-    : input_(&input) {
+    : reader_(new LineReader(input)) {
   ++(*this);
 }
 
 RuleTableIndexParser &RuleTableIndexParser::operator++() {
-  if (!input_) {
+  if (!reader_) {
     return *this;
   }
-  if (!std::getline(*input_, value_.line)) {
-    input_ = 0;
+  if (!reader_->Next(value_.line)) {
+    reader_.reset();
     return *this;
   }
   ParseLine(value_.line);
@@ -52,7 +51,7 @@ RuleTableIndexParser &RuleTableIndexParser::operator++() {
 
 void RuleTableIndexParser::ParseLine(StringPiece line) {
   // Key
-  size_t pos = line.find("|||");
+  size_t pos = FindFieldSeparator(line);
   if (pos == std::string::npos) {
     throw Exception("missing delimiter");
   }
@@ -66,7 +65,7 @@ void RuleTableIndexParser::ParseLine(StringPiece line) {
 
 bool operator==(const RuleTableIndexParser &lhs,
                 const RuleTableIndexParser &rhs) {
-  return lhs.input_ == rhs.input_;
+  return lhs.reader_ == rhs.reader_;
 }
 
 bool operator!=(const RuleTableIndexParser &lhs,
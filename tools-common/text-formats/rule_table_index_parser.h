@@ -1,8 +1,11 @@
 #ifndef TACO_TOOLS_COMMON_TEXT_FORMATS_RULE_TABLE_INDEX_PARSER_H_
 #define TACO_TOOLS_COMMON_TEXT_FORMATS_RULE_TABLE_INDEX_PARSER_H_
 
+#include "taco/base/line_reader.h"
 #include "taco/base/string_piece.h"
 
+#include <boost/shared_ptr.hpp>
+
 #include <istream>
 #include <string>
 #include <vector>
@@ -20,7 +23,7 @@ class RuleTableIndexParser {
  public:
   struct Entry {
     Entry() {}
-    std::string line;
+    StringPiece line;
     StringPiece key;
     int line_num;
    private:
@@ -47,7 +50,7 @@ class RuleTableIndexParser {
 
  private:
   Entry value_;
-  std::istream *input_;
+  boost::shared_ptr<LineReader> reader_;
 
   void ParseLine(StringPiece);
 };
@@ -21,7 +21,7 @@ BOOST_AUTO_TEST_CASE(TestConstraintMapParser) {
   {
     const ConstraintMapParser::Entry &entry = *parser;
 
-    BOOST_CHECK(entry.line + std::string("\n") == s.str());
+    BOOST_CHECK(entry.line.as_string() + "\n" == s.str());
 
     BOOST_CHECK(entry.key == key);
 
@@ -9,21 +9,20 @@
 namespace taco {
 namespace tool {
 
-VocabParser::VocabParser()
-    : input_(0) {
+VocabParser::VocabParser() {
 }
 
 VocabParser::VocabParser(std::istream &input)
-    : input_(&input) {
+    : reader_(new LineReader(input)) {
   ++(*this);
 }
 
 VocabParser &VocabParser::operator++() {
-  if (!input_) {
+  if (!reader_) {
     return *this;
   }
-  if (!std::getline(*input_, value_.line)) {
-    input_ = 0;
+  if (!reader_->Next(value_.line)) {
+    reader_.reset();
     return *this;
   }
   ParseLine(value_.line);
@@ -32,7 +31,7 @@ VocabParser &VocabParser::operator++() {
 
 void VocabParser::ParseLine(const StringPiece &line) {
   // Symbol.
-  std::size_t pos = line.find("|||");
+  std::size_t pos = FindFieldSeparator(line);
   if (pos == std::string::npos) {
     throw Exception("missing first delimiter");
   }
@@ -41,7 +40,7 @@ void VocabParser::ParseLine(const StringPiece &line) {
 
   // Count.
   std::size_t begin = pos+3;
-  pos = line.find("|||", begin);
+  pos = FindFieldSeparator(line, begin);
   if (pos == std::string::npos) {
     throw Exception("missing second delimiter");
   }
@@ -50,7 +49,7 @@ void VocabParser::ParseLine(const StringPiece &line) {
 
   // POS label set.
   begin = pos+3;
-  pos = line.find("|||", begin);
+  pos = FindFieldSeparator(line, begin);
   if (pos == std::string::npos) {
     throw Exception("missing third delimiter");
   }
@@ -65,7 +64,7 @@ void VocabParser::ParseLine(const StringPiece &line) {
 }
 
 bool operator==(const VocabParser &lhs, const VocabParser &rhs) {
-  return lhs.input_ == rhs.input_;
+  return lhs.reader_.get() == rhs.reader_.get();
 }
 
 bool operator!=(const VocabParser &lhs, const VocabParser &rhs) {
@@ -1,8 +1,11 @@
 #ifndef TACO_TOOLS_COMMON_TEXT_FORMATS_VOCAB_PARSER_H_
 #define TACO_TOOLS_COMMON_TEXT_FORMATS_VOCAB_PARSER_H_
 
+#include "taco/base/line_reader.h"
 #include "taco/base/string_piece.h"
 
+#include <boost/scoped_ptr.hpp>
+
 #include <istream>
 #include <string>
 #include <vector>
@@ -25,7 +28,7 @@ class VocabParser {
  public:
   struct Entry {
     Entry() {}
-    std::string line;
+    StringPiece line;
     StringPiece symbol;
     StringPiece count;
     std::vector<StringPiece> pos_set;
@@ -55,7 +58,7 @@ class VocabParser {
   void ParseLine(const StringPiece &);
 
   Entry value_;
-  std::istream *input_;
+  boost::scoped_ptr<LineReader> reader_;
 };
 
 }  // namespace tool
@@ -2,6 +2,8 @@
 
 #include "options.h"
 
+#include "taco/base/string_util.h"
+
 #include <boost/program_options.hpp>
 
 #include <cstdlib>
@@ -31,7 +33,7 @@ int AddConstraintIds::Main(int argc, char *argv[]) {
   int curr_rule_num = 0;
   int prev_required_rule_num = -1;
   while (std::getline(join_stream, join_line)) {
-    size_t pos = join_line.find("|||");
+    size_t pos = FindFieldSeparator(join_line);
     // TODO Proper error handling.
     assert(pos != std::string::npos);
     int required_rule_num = std::atoi(join_line.c_str());
@@ -0,0 +1,132 @@
+#include "compile_constraint_table.h"
+
+#include "options.h"
+
+#include "taco/base/exception.h"
+#include "taco/base/vocabulary.h"
+#include "tools-common/binary_constraint_table.h"
+#include "tools-common/constraint_table.h"
+
+#include <boost/program_options.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace taco {
+namespace tool {
+
+int CompileConstraintTable::Main(int argc, char *argv[]) {
+  // Process command-line options.
+  Options options;
+  ProcessOptions(argc, argv, options);
+
+  // Open the input streams.
+  std::ifstream map_stream;
+  OpenNamedInputOrDie(options.constraint_map_file, map_stream);
+  std::ifstream table_stream;
+  OpenNamedInputOrDie(options.constraint_table_file, table_stream);
+
+  // Open the output file.
+  std::ofstream output;
+  OpenNamedOutputOrDie(options.output_file, output);
+
+  Vocabulary vocab;
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  try {
+    ConstraintTable table;
+    BasicConstraintTableLoader loader(vocab, feature_set, value_set);
+    loader.Load(map_stream, table_stream, table);
+
+    BinaryConstraintTableWriter writer(feature_set, value_set);
+    writer.Write(table, output);
+  } catch (const Exception &e) {
+    Error(e.msg());
+  }
+
+  if (!output) {
+    Error("failed to write output file");
+  }
+
+  return 0;
+}
+
+void CompileConstraintTable::ProcessOptions(int argc, char *argv[],
+                                            Options &options) const {
+  namespace po = boost::program_options;
+
+  // Construct the 'top' of the usage message: the bit that comes before the
+  // options list.
+  std::ostringstream usage_top;
+  usage_top << "Usage: " << name() << " [OPTION]... -o OUTPUT MAP TABLE\n\n"
+            << "Compile a constraint map and constraint table into the binary format that\ncan be memory-mapped by taco::tool::BinaryConstraintTable.\n\n"
+            << "Options";
+
+  // Construct the 'bottom' of the usage message.
+  std::ostringstream usage_bottom;  // Empty for now.
+
+  // Declare the command line options that are visible to the user.
+  po::options_description visible(usage_top.str());
+  visible.add_options()
+    ("help",
+        "print this help message and exit")
+    ("output,o",
+        po::value(&options.output_file),
+        "write the binary constraint table to arg")
+  ;
+
+  // Declare the command line options that are hidden from the user
+  // (these are used as positional options).
+  po::options_description hidden("Hidden options");
+  hidden.add_options()
+    ("cm-file",
+        po::value(&options.constraint_map_file),
+        "constraint map file")
+    ("ct-file",
+        po::value(&options.constraint_table_file),
+        "constraint table file")
+  ;
+
+  // Compose the full set of command-line options.
+  po::options_description cmd_line_options;
+  cmd_line_options.add(visible).add(hidden);
+
+  // Register the positional options.
+  po::positional_options_description p;
+  p.add("cm-file", 1);
+  p.add("ct-file", 1);
+
+  // Process the command-line.
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv).style(CommonOptionStyle()).
+              options(cmd_line_options).positional(p).run(), vm);
+    po::notify(vm);
+  } catch (const std::exception &e) {
+    std::ostringstream msg;
+    msg << e.what() << "\n\n" << visible << usage_bottom.str();
+    Error(msg.str());
+  }
+
+  if (vm.count("help")) {
+    std::cout << visible << usage_bottom.str() << std::endl;
+    std::exit(0);
+  }
+
+  if (!vm.count("cm-file") || !vm.count("ct-file")) {
+    std::ostringstream msg;
+    msg << "missing required argument\n\n" << visible
+        << usage_bottom.str();
+    Error(msg.str());
+  }
+
+  if (options.output_file.empty() || options.output_file == "-") {
+    Error("an output file must be given with -o");
+  }
+}
+
+}  // namespace tool
+}  // namespace taco
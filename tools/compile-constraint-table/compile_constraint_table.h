@@ -0,0 +1,22 @@
+#ifndef TACO_TOOLS_COMPILE_CONSTRAINT_TABLE_COMPILE_CONSTRAINT_TABLE_H_
+#define TACO_TOOLS_COMPILE_CONSTRAINT_TABLE_COMPILE_CONSTRAINT_TABLE_H_
+
+#include "tools-common/cli/tool.h"
+
+namespace taco {
+namespace tool {
+
+struct Options;
+
+class CompileConstraintTable : public Tool {
+ public:
+  CompileConstraintTable() : Tool("compile-constraint-table") {}
+  virtual int Main(int, char *[]);
+ private:
+  void ProcessOptions(int, char *[], Options &) const;
+};
+
+}  // namespace tool
+}  // namespace taco
+
+#endif
@@ -0,0 +1,6 @@
+#include "compile_constraint_table.h"
+
+int main(int argc, char *argv[]) {
+  taco::tool::CompileConstraintTable tool;
+  return tool.Main(argc, argv);
+}
@@ -0,0 +1,20 @@
+#ifndef TACO_TOOLS_COMPILE_CONSTRAINT_TABLE_OPTIONS_H_
+#define TACO_TOOLS_COMPILE_CONSTRAINT_TABLE_OPTIONS_H_
+
+#include <string>
+
+namespace taco {
+namespace tool {
+
+struct Options {
+ public:
+  Options() {}
+  std::string constraint_map_file;
+  std::string constraint_table_file;
+  std::string output_file;
+};
+
+}  // namespace tool
+}  // namespace taco
+
+#endif
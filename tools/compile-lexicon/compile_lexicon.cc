@@ -0,0 +1,121 @@
+#include "compile_lexicon.h"
+
+#include "options.h"
+
+#include "taco/base/exception.h"
+#include "taco/binary_lexicon.h"
+#include "taco/lexicon.h"
+#include "taco/text-formats/feature_structure_parser.h"
+#include "taco/base/vocabulary.h"
+
+#include <boost/program_options.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace taco {
+namespace tool {
+
+int CompileLexicon::Main(int argc, char *argv[]) {
+  // Process command-line options.
+  Options options;
+  ProcessOptions(argc, argv, options);
+
+  // Open the input stream.
+  std::istream &input = OpenInputOrDie(options.input_file);
+
+  // Open the output file.
+  std::ofstream output;
+  OpenNamedOutputOrDie(options.output_file, output);
+
+  Vocabulary words;
+  Vocabulary feature_set;
+  Vocabulary value_set;
+
+  FeatureStructureParser fs_parser(feature_set, value_set);
+
+  try {
+    Lexicon<std::size_t> lexicon;
+    BasicLexiconLoader loader(fs_parser, words);
+    loader.Load(input, lexicon);
+
+    BinaryLexiconWriter writer(words, feature_set, value_set);
+    writer.Write(lexicon, output);
+  } catch (const Exception &e) {
+    Error(e.msg());
+  }
+
+  if (!output) {
+    Error("failed to write output file");
+  }
+
+  return 0;
+}
+
+void CompileLexicon::ProcessOptions(int argc, char *argv[],
+                                    Options &options) const {
+  namespace po = boost::program_options;
+
+  // Construct the 'top' of the usage message: the bit that comes before the
+  // options list.
+  std::ostringstream usage_top;
+  usage_top << "Usage: " << name() << " [OPTION]... -o OUTPUT [FILE]\n\n"
+            << "Compile a text lexicon into the binary format that can be memory-mapped\nby taco::BinaryLexicon.  With no FILE argument, or when FILE is -, read\nstandard input.\n\n"
+            << "Options";
+
+  // Construct the 'bottom' of the usage message.
+  std::ostringstream usage_bottom;  // Empty for now.
+
+  // Declare the command line options that are visible to the user.
+  po::options_description visible(usage_top.str());
+  visible.add_options()
+    ("help",
+        "print this help message and exit")
+    ("output,o",
+        po::value(&options.output_file),
+        "write the binary lexicon to arg")
+  ;
+
+  // Declare the command line options that are hidden from the user
+  // (these are used as positional options).
+  po::options_description hidden("Hidden options");
+  hidden.add_options()
+    ("input",
+        po::value(&options.input_file),
+        "input file")
+  ;
+
+  // Compose the full set of command-line options.
+  po::options_description cmd_line_options;
+  cmd_line_options.add(visible).add(hidden);
+
+  // Register the positional options.
+  po::positional_options_description p;
+  p.add("input", 1);
+
+  // Process the command-line.
+  po::variables_map vm;
+  try {
+    po::store(po::command_line_parser(argc, argv).style(CommonOptionStyle()).
+              options(cmd_line_options).positional(p).run(), vm);
+    po::notify(vm);
+  } catch (const std::exception &e) {
+    std::ostringstream msg;
+    msg << e.what() << "\n\n" << visible << usage_bottom.str();
+    Error(msg.str());
+  }
+
+  if (vm.count("help")) {
+    std::cout << visible << usage_bottom.str() << std::endl;
+    std::exit(0);
+  }
+
+  if (options.output_file.empty() || options.output_file == "-") {
+    Error("an output file must be given with -o");
+  }
+}
+
+}  // namespace tool
+}  // namespace taco
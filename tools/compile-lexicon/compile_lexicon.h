@@ -0,0 +1,22 @@
+#ifndef TACO_TOOLS_COMPILE_LEXICON_COMPILE_LEXICON_H_
+#define TACO_TOOLS_COMPILE_LEXICON_COMPILE_LEXICON_H_
+
+#include "tools-common/cli/tool.h"
+
+namespace taco {
+namespace tool {
+
+struct Options;
+
+class CompileLexicon : public Tool {
+ public:
+  CompileLexicon() : Tool("compile-lexicon") {}
+  virtual int Main(int, char *[]);
+ private:
+  void ProcessOptions(int, char *[], Options &) const;
+};
+
+}  // namespace tool
+}  // namespace taco
+
+#endif
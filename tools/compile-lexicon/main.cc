@@ -0,0 +1,6 @@
+#include "compile_lexicon.h"
+
+int main(int argc, char *argv[]) {
+  taco::tool::CompileLexicon tool;
+  return tool.Main(argc, argv);
+}
@@ -0,0 +1,19 @@
+#ifndef TACO_TOOLS_COMPILE_LEXICON_OPTIONS_H_
+#define TACO_TOOLS_COMPILE_LEXICON_OPTIONS_H_
+
+#include <string>
+
+namespace taco {
+namespace tool {
+
+struct Options {
+ public:
+  Options() {}
+  std::string input_file;
+  std::string output_file;
+};
+
+}  // namespace tool
+}  // namespace taco
+
+#endif
@@ -15,6 +15,7 @@
 
 #include "taco/constraint_set_set.h"
 #include "taco/text-formats/constraint_writer.h"
+#include "taco/base/string_util.h"
 #include "taco/base/vocabulary.h"
 
 #include <boost/algorithm/string.hpp>
@@ -280,7 +281,7 @@ void ExtractConstraints::ParseLine(
   // Extract tree_number.
   tree_number = std::atoi(c_line);
 
-  std::size_t pos = line.find("|||");
+  std::size_t pos = FindFieldSeparator(line);
   if (pos == std::string::npos) {
     throw Exception("Missing column delimiter");
   }
@@ -100,7 +100,7 @@ int PruneRedundantConstraints::Main(int argc, char *argv[]) {
 }
 
 void PruneRedundantConstraints::WriteAdjustedRule(
-    const std::string &line,
+    const StringPiece &line,
     const std::vector<std::pair<int,int> > &new_constraint_ids,
     int feature_selection_id,
     std::ostream &output) {
@@ -37,7 +37,7 @@ class PruneRedundantConstraints : public Tool {
 
   void ProcessOptions(int, char *[], Options &) const;
 
-  void WriteAdjustedRule(const std::string &,
+  void WriteAdjustedRule(const StringPiece &,
                          const std::vector<std::pair<int, int> > &,
                          int, std::ostream &);
 